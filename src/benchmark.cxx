@@ -0,0 +1,472 @@
+// Benchmarks the hot paths of the correlation analysis
+// on synthetic AuAu-like events, so no pico files are needed.
+// Each stage is timed separately over the same set of events,
+// and the results are written as CSV or JSON ( by extension )
+// so they can be compared between commits.
+// Nick Elsey
+
+// All reader and histogram settings
+// Are located in corrParameters.hh
+#include "corrParameters.hh"
+
+// The majority of the jetfinding
+// And correlation code is located in
+// corrFunctions.hh
+#include "corrFunctions.hh"
+
+// The histograms class
+#include "histograms.hh"
+
+// ROOT Headers
+#include "TRandom3.h"
+#include "TVector2.h"
+#include "TMath.h"
+
+// Data is read in by TStarJetPico
+// Library, we convert to FastJet::PseudoJet
+#include "TStarJetVectorContainer.h"
+#include "TStarJetVector.h"
+
+// Track efficiency
+#include "ktTrackEff.hh"
+
+// STL Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <sstream>
+
+// the grid does not have std::to_string() for some ungodly reason
+// replacing it here. Simply ostringstream
+namespace patch {
+  template < typename T > std::string to_string( const T& n )
+  {
+    std::ostringstream stm ;
+    stm << n ;
+    return stm.str() ;
+  }
+}
+
+// -------------------------
+// Command line arguments:
+// [0]: output file: .csv or .json
+// [1]: number of synthetic events
+// [2]: mean gRefMult of the events ( 0-20% AuAu is ~ 300-700 ),
+//      has to be in the centralities the efficiency covers ( >= 269 )
+// [3]: random seed
+// [4]: tag written with every result ( ie the commit hash )
+// optional: --strategy-profile=file recalibrates the clustering strategies,
+//           writes the profile and clusters with the tuned strategies
+
+namespace {
+
+  // One synthetic event: the particles as they come out of the
+  // reader, plus what the drivers would know about the event
+  struct syntheticEvent {
+    TStarJetVectorContainer<TStarJetVector>* container;
+    int gRefMult;
+    int refCent;
+    int vzBin;
+  };
+
+  // One benchmark result
+  struct benchResult {
+    std::string name;
+    Long64_t events;
+    Long64_t objects;
+    double seconds;
+    double checksum;
+  };
+
+  void AddParticle( TStarJetVectorContainer<TStarJetVector>* container, double pt, double eta, double phi, int charge ) {
+    TStarJetVector sv;
+    sv.SetPtEtaPhiM( pt, eta, phi, ( charge == 0 ? 0.0 : 0.13957 ) );
+    sv.SetCharge( charge );
+    container->Add( &sv );
+  }
+
+  // Underlying event: charged tracks and neutral towers with an
+  // exponential pt spectrum, flat in eta and phi. Tracks in
+  // |eta| < 1 are ~ 2 x gRefMult ( which counts |eta| < 0.5 )
+  // Hard scattering: a back to back dijet with a leading jet
+  // of 20-40 GeV, fragmented into a handful of constituents
+  // gRefMult is clamped to the centralities the efficiency covers,
+  // as the drivers skip the other events, so refCentAlt is 0-2
+  syntheticEvent GenerateEvent( TRandom3& random, double meanRefMult ) {
+    syntheticEvent event;
+    event.container = new TStarJetVectorContainer<TStarJetVector>;
+    event.gRefMult  = std::max( (int) random.Poisson( meanRefMult ), jetHadron::y7RefMultCent[jetHadron::y7EfficiencyRefCentLower] );
+    event.refCent   = jetHadron::GetReferenceCentrality( event.gRefMult );
+    event.vzBin     = jetHadron::GetVzBin( random.Uniform( jetHadron::vzLowEdge, jetHadron::vzHighEdge ) );
+
+    int nTracks = random.Poisson( 2.0 * event.gRefMult );
+    int nTowers = random.Poisson( 1.0 * event.gRefMult );
+    for ( int i = 0; i < nTracks + nTowers; ++i ) {
+      double pt = jetHadron::trackMinPt + random.Exp( 0.5 );
+      int charge = ( i < nTracks ? ( random.Rndm() < 0.5 ? -1 : 1 ) : 0 );
+      AddParticle( event.container, pt, random.Uniform( -jetHadron::maxTrackRap, jetHadron::maxTrackRap ), random.Uniform( -TMath::Pi(), TMath::Pi() ), charge );
+    }
+
+    double leadPt  = random.Uniform( 20.0, 40.0 );
+    double subPt   = leadPt * random.Uniform( 0.5, 0.95 );
+    double leadEta = random.Uniform( -0.6, 0.6 );
+    double leadPhi = random.Uniform( -TMath::Pi(), TMath::Pi() );
+    double subEta  = random.Uniform( -0.6, 0.6 );
+    double subPhi  = TVector2::Phi_mpi_pi( leadPhi + TMath::Pi() + random.Gaus( 0, 0.1 ) );
+    double jetPt[2]  = { leadPt, subPt };
+    double jetEta[2] = { leadEta, subEta };
+    double jetPhi[2] = { leadPhi, subPhi };
+    for ( int j = 0; j < 2; ++j ) {
+      // leading fragment carries ~ half, the rest share the remainder
+      int nFragments = 4 + random.Integer( 6 );
+      double remaining = jetPt[j];
+      for ( int k = 0; k < nFragments && remaining > 2.0 * jetHadron::trackMinPt; ++k ) {
+        double pt = ( k == nFragments - 1 ? remaining : remaining * random.Uniform( 0.3, 0.6 ) );
+        remaining -= pt;
+        AddParticle( event.container, pt, jetEta[j] + random.Gaus( 0, 0.08 ), jetPhi[j] + random.Gaus( 0, 0.08 ), ( random.Rndm() < 0.65 ? 1 : 0 ) );
+      }
+    }
+    return event;
+  }
+
+  double Elapsed( std::chrono::steady_clock::time_point start ) {
+    return std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+  }
+
+  bool WriteResults( std::string outputFile, std::string tag, double meanRefMult, const std::vector<benchResult>& results ) {
+    std::ofstream out( outputFile.c_str() );
+    if ( !out.is_open() )
+      return false;
+
+    if ( jetHadron::HasEnding( outputFile, ".json" ) ) {
+      out << "{\n  \"tag\": \"" << tag << "\",\n  \"grefmult\": " << meanRefMult << ",\n  \"results\": [\n";
+      for ( unsigned i = 0; i < results.size(); ++i ) {
+        out << "    { \"name\": \"" << results[i].name << "\", \"events\": " << results[i].events << ", \"objects\": " << results[i].objects;
+        out << ", \"seconds\": " << results[i].seconds << ", \"us_per_event\": " << 1.0e6 * results[i].seconds / std::max( (Long64_t) 1, results[i].events );
+        out << ", \"ns_per_object\": " << 1.0e9 * results[i].seconds / std::max( (Long64_t) 1, results[i].objects );
+        out << ", \"checksum\": " << results[i].checksum << " }" << ( i + 1 < results.size() ? "," : "" ) << "\n";
+      }
+      out << "  ]\n}\n";
+    }
+    else {
+      out << "tag,grefmult,name,events,objects,seconds,us_per_event,ns_per_object,checksum\n";
+      for ( unsigned i = 0; i < results.size(); ++i ) {
+        out << tag << "," << meanRefMult << "," << results[i].name << "," << results[i].events << "," << results[i].objects << ",";
+        out << results[i].seconds << "," << 1.0e6 * results[i].seconds / std::max( (Long64_t) 1, results[i].events ) << ",";
+        out << 1.0e9 * results[i].seconds / std::max( (Long64_t) 1, results[i].objects ) << "," << results[i].checksum << "\n";
+      }
+    }
+    return true;
+  }
+
+}
+
+// DEF MAIN()
+int main ( int argc, const char** argv ) {
+
+  std::string outputFile  = "bench.csv";
+  int         nEvents     = 200;
+  double      meanRefMult = 500;
+  unsigned    seed        = 12345;
+  std::string tag         = "local";
+
+  std::string strategyProfile;
+  bool tuneStrategies = jetHadron::PopOption( argc, argv, "--strategy-profile", strategyProfile );
+
+  switch ( argc ) {
+    case 1: // Default case
+      __OUT( "Using Default Settings" )
+      break;
+    case 6: { // Custom case
+      __OUT( "Using Custom Settings" )
+      std::vector<std::string> arguments( argv+1, argv+argc );
+
+      outputFile  = arguments[0];
+      nEvents     = atoi( arguments[1].c_str() );
+      meanRefMult = atof( arguments[2].c_str() );
+      seed        = atoi( arguments[3].c_str() );
+      tag         = arguments[4];
+      break;
+    }
+    default: { // Error: invalid custom settings
+      __ERR( "Invalid number of command line arguments" )
+      return -1;
+      break;
+    }
+  }
+
+  if ( nEvents <= 0 || meanRefMult <= 0 ) {
+    __ERR( "Need a positive number of events and multiplicity" )
+    return -1;
+  }
+  
+  // the efficiency is only defined for refCent 6-8 - a lower mean
+  // would clamp most events to the same gRefMult
+  int meanRefCent = jetHadron::GetReferenceCentrality( (int) meanRefMult );
+  if ( meanRefCent < jetHadron::y7EfficiencyRefCentLower || meanRefCent > jetHadron::y7EfficiencyRefCentUpper ) {
+    __ERR( "Mean gRefMult " << meanRefMult << " is outside of refCent " << jetHadron::y7EfficiencyRefCentLower << "-" << jetHadron::y7EfficiencyRefCentUpper )
+    return -1;
+  }
+
+  // Same definitions as the AuAu dijet analysis defaults
+  double jetRadius = 0.4;
+  double hardPtCut = 2.0;
+  std::string analysisType = "dijet";
+  fastjet::JetDefinition  analysisDefinition   = jetHadron::AnalysisJetDefinition( jetRadius );
+  fastjet::JetDefinition  backgroundDefinition = jetHadron::BackgroundJetDefinition( jetRadius );
+  fastjet::Selector selectorLowPtCons  = jetHadron::SelectLowPtConstituents( jetHadron::maxTrackRap, jetHadron::trackMinPt );
+  fastjet::Selector selectorHighPtCons = jetHadron::SelectHighPtConstituents( jetHadron::maxTrackRap, hardPtCut );
+  fastjet::GhostedAreaSpec  areaSpec = jetHadron::GhostedArea( jetHadron::maxTrackRap, jetRadius );
+  fastjet::AreaDefinition   areaDef  = jetHadron::AreaDefinition( areaSpec );
+  fastjet::Selector selectorBkgEstimator = jetHadron::SelectBkgEstimator( jetHadron::maxTrackRap, jetRadius );
+  unsigned nGhosts = jetHadron::GhostCount( areaDef );
+
+  jetHadron::histograms* histograms = new jetHadron::histograms( analysisType );
+  histograms->Init();
+  
+  // the analysis type as a mode, for the correlation loops
+  jetHadron::analysisMode mode = histograms->GetMode();
+
+  // the efficiency constructor is part of every job's startup
+  std::chrono::steady_clock::time_point initStart = std::chrono::steady_clock::now();
+  ktTrackEff efficiencyCorrection;
+  double initSeconds = Elapsed( initStart );
+
+  // generate everything up front, so the generator is not timed
+  TRandom3 random( seed );
+  std::vector<syntheticEvent> events;
+  for ( int i = 0; i < nEvents; ++i )
+    events.push_back( GenerateEvent( random, meanRefMult ) );
+
+  std::vector<benchResult> results;
+  std::vector<std::vector<fastjet::PseudoJet> > particles( nEvents );
+  std::vector<std::vector<fastjet::PseudoJet> > leadingJets( nEvents );
+
+  // startup: the efficiency constructor, and for comparison the four TF2
+  // formulas it used to build ( JIT compiled when they are created )
+  {
+    benchResult result = { "efficiency_init", 1, 1, initSeconds, 0 };
+    results.push_back( result );
+  }
+  std::vector<TF2*> effFormulas;
+  {
+    benchResult result = { "efficiency_formula_init", 1, 4, 0, 0 };
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for ( int i = 0; i < 3; ++i )
+      effFormulas.push_back( efficiencyCorrection.GetEffY04( i ) );
+    effFormulas.push_back( efficiencyCorrection.GetEffY06() );
+    for ( unsigned i = 0; i < effFormulas.size(); ++i )
+      result.checksum += effFormulas[i]->Eval( 0.5, 0.5 );
+    result.seconds = Elapsed( start );
+    results.push_back( result );
+  }
+
+  // strategy calibration: one result per strategy and multiplicity,
+  // the clustering stages below then use the tuned strategies
+  if ( tuneStrategies ) {
+    std::vector<fastjet::JetDefinition> tunedDefinitions;
+    tunedDefinitions.push_back( analysisDefinition );
+    tunedDefinitions.push_back( backgroundDefinition );
+    if ( !jetHadron::InitStrategyTuning( strategyProfile, tunedDefinitions, true ) )
+      return -1;
+    const std::vector<jetHadron::strategyTuner*>& tuners = jetHadron::GetStrategyTuners();
+    for ( unsigned t = 0; t < tuners.size(); ++t ) {
+      std::string algorithm = ( tuners[t]->Definition().jet_algorithm() == fastjet::antikt_algorithm ? "antikt" : "kt" );
+      for ( unsigned point = 0; point < tuners[t]->Multiplicities().size(); ++point ) {
+        unsigned multiplicity = tuners[t]->Multiplicities()[point];
+        for ( unsigned strategy = 0; strategy < jetHadron::strategyTuner::NStrategies(); ++strategy ) {
+          double seconds = tuners[t]->Seconds( strategy, point );
+          if ( seconds < 0 )
+            continue;
+          benchResult result = { "strategy_" + algorithm + "_" + jetHadron::strategyTuner::StrategyName( strategy ) + "_" + patch::to_string( multiplicity ), 1, multiplicity, seconds, 0 };
+          results.push_back( result );
+        }
+      }
+    }
+    std::cout<<"  Strategy profile written to "<< strategyProfile <<std::endl;
+  }
+
+  // convert
+  {
+    benchResult result = { "convert", nEvents, 0, 0, 0 };
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for ( int i = 0; i < nEvents; ++i ) {
+      jetHadron::ConvertTStarJetVector( events[i].container, particles[i] );
+      result.objects += particles[i].size();
+    }
+    result.seconds = Elapsed( start );
+    for ( int i = 0; i < nEvents; ++i )
+      result.checksum += particles[i].size();
+    results.push_back( result );
+  }
+
+  // hard clustering: keep the hard jets for the correlation benchmarks
+  {
+    benchResult result = { "hard_cluster", nEvents, 0, 0, 0 };
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for ( int i = 0; i < nEvents; ++i ) {
+      std::vector<fastjet::PseudoJet> highPtCons = selectorHighPtCons( particles[i] );
+      fastjet::ClusterSequence clusterSequenceHigh ( highPtCons, jetHadron::TunedDefinition( analysisDefinition, highPtCons.size() ) );
+      leadingJets[i] = fastjet::sorted_by_pt( clusterSequenceHigh.inclusive_jets() );
+      result.objects += highPtCons.size();
+    }
+    result.seconds = Elapsed( start );
+    for ( int i = 0; i < nEvents; ++i )
+      result.checksum += ( leadingJets[i].size() ? leadingJets[i][0].pt() : 0 );
+    results.push_back( result );
+  }
+
+  // soft clustering with areas, and the background subtraction on top of it
+  {
+    benchResult soft = { "soft_cluster", nEvents, 0, 0, 0 };
+    benchResult bkg  = { "background", nEvents, 0, 0, 0 };
+    for ( int i = 0; i < nEvents; ++i ) {
+      std::vector<fastjet::PseudoJet> lowPtCons = selectorLowPtCons( particles[i] );
+
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      fastjet::ClusterSequenceArea ClusterSequenceLow ( lowPtCons, jetHadron::TunedDefinition( analysisDefinition, lowPtCons.size() + nGhosts ), areaDef );
+      std::vector<fastjet::PseudoJet> lowJets = ClusterSequenceLow.inclusive_jets();
+      soft.seconds += Elapsed( start );
+      soft.objects += lowPtCons.size();
+      soft.checksum += lowJets.size();
+
+      start = std::chrono::steady_clock::now();
+      fastjet::JetMedianBackgroundEstimator bkgdEstimator ( selectorBkgEstimator, jetHadron::TunedDefinition( backgroundDefinition, lowPtCons.size() + nGhosts ), areaDef );
+      bkgdEstimator.set_particles( lowPtCons );
+      fastjet::Subtractor bkgdSubtractor ( &bkgdEstimator );
+      std::vector<fastjet::PseudoJet> subtracted = fastjet::sorted_by_pt( bkgdSubtractor( lowJets ) );
+      bkg.seconds += Elapsed( start );
+      bkg.objects += lowJets.size();
+      bkg.checksum += bkgdEstimator.rho();
+    }
+    results.push_back( soft );
+    results.push_back( bkg );
+  }
+
+  // efficiency lookup
+  std::vector<std::vector<double> > efficiencies( nEvents );
+  {
+    benchResult result = { "efficiency", nEvents, 0, 0, 0 };
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for ( int i = 0; i < nEvents; ++i ) {
+      int refCentAlt = jetHadron::GetReferenceCentralityAlt( events[i].refCent );
+      efficiencies[i].resize( particles[i].size() );
+      for ( unsigned j = 0; j < particles[i].size(); ++j )
+        efficiencies[i][j] = efficiencyCorrection.EffAAY07( particles[i][j].eta(), particles[i][j].pt(), refCentAlt );
+      result.objects += particles[i].size();
+    }
+    result.seconds = Elapsed( start );
+    for ( int i = 0; i < nEvents; ++i )
+      for ( unsigned j = 0; j < efficiencies[i].size(); ++j )
+        result.checksum += efficiencies[i][j];
+    results.push_back( result );
+  }
+
+  // the compiled parameterizations have to match the formulas: the
+  // checksum is the largest difference over the synthetic particles
+  {
+    benchResult result = { "efficiency_formula_check", nEvents, 0, 0, 0 };
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for ( int i = 0; i < nEvents; ++i ) {
+      int refCentAlt = jetHadron::GetReferenceCentralityAlt( events[i].refCent );
+      if ( refCentAlt < 0 || refCentAlt > 2 )
+        continue;
+      for ( unsigned j = 0; j < particles[i].size(); ++j ) {
+        double eta = particles[i][j].eta();
+        double pt = std::min( particles[i][j].pt(), 5.0 );
+        result.checksum = std::max( result.checksum, fabs( effFormulas[refCentAlt]->Eval( eta, pt ) - ktTrackEff::EffY04( eta, pt, refCentAlt ) ) );
+        result.checksum = std::max( result.checksum, fabs( effFormulas[3]->Eval( pt, eta ) - ktTrackEff::EffY06( pt, eta ) ) );
+      }
+      result.objects += particles[i].size();
+    }
+    result.seconds = Elapsed( start );
+    results.push_back( result );
+    if ( result.checksum > 1e-9 )
+      __ERR( "compiled efficiency differs from the TF2 formulas by " << result.checksum )
+  }
+  for ( unsigned i = 0; i < effFormulas.size(); ++i )
+    delete effFormulas[i];
+
+  // correlation: the full correlateLeading path, and
+  // the histogram fill on its own for comparison
+  {
+    benchResult result = { "correlate_leading", nEvents, 0, 0, 0 };
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for ( int i = 0; i < nEvents; ++i ) {
+      if ( leadingJets[i].size() == 0 )
+        continue;
+      for ( unsigned j = 0; j < particles[i].size(); ++j )
+        if ( jetHadron::correlateLeading( mode, events[i].vzBin, events[i].refCent, histograms, leadingJets[i][0], particles[i][j], efficiencies[i][j], 0.1 ) )
+          result.checksum += 1;
+      result.objects += particles[i].size();
+    }
+    result.seconds = Elapsed( start );
+    results.push_back( result );
+  }
+  {
+    benchResult result = { "fill_correlation_lead", nEvents, 0, 0, 0 };
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for ( int i = 0; i < nEvents; ++i ) {
+      if ( leadingJets[i].size() == 0 )
+        continue;
+      for ( unsigned j = 0; j < particles[i].size(); ++j ) {
+        double deltaPhi = leadingJets[i][0].delta_phi_to( particles[i][j] );
+        double deltaEta = leadingJets[i][0].eta() - particles[i][j].eta();
+        if ( histograms->FillCorrelationLead( deltaEta, deltaPhi, particles[i][j].pt(), 1.0, 0.1, events[i].vzBin, events[i].refCent ) )
+          result.checksum += 1;
+      }
+      result.objects += particles[i].size();
+    }
+    result.seconds = Elapsed( start );
+    results.push_back( result );
+  }
+
+  // the event mixing inner loop: every jet is correlated with
+  // the particles of nMix other events, as event_mixing does
+  {
+    const int nMix = std::min( nEvents - 1, 20 );
+    benchResult result = { "mixing", nEvents, 0, 0, 0 };
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for ( int i = 0; i < nEvents; ++i ) {
+      if ( leadingJets[i].size() < 2 )
+        continue;
+      for ( int m = 1; m <= nMix; ++m ) {
+        int mixEvent = ( i + m ) % nEvents;
+        int refCentAlt = jetHadron::GetReferenceCentralityAlt( events[mixEvent].refCent );
+        for ( unsigned k = 0; k < particles[mixEvent].size(); ++k ) {
+          double assocEfficiency = efficiencyCorrection.EffAAY07( particles[mixEvent][k].eta(), particles[mixEvent][k].pt(), refCentAlt );
+          if ( jetHadron::correlateLeading( mode, events[i].vzBin, events[mixEvent].refCent, histograms, leadingJets[i][0], particles[mixEvent][k], assocEfficiency, 0.1 ) )
+            result.checksum += 1;
+          jetHadron::correlateSubleading( mode, events[i].vzBin, events[mixEvent].refCent, histograms, leadingJets[i][1], particles[mixEvent][k], assocEfficiency, 0.1 );
+        }
+        result.objects += particles[mixEvent].size();
+      }
+    }
+    result.seconds = Elapsed( start );
+    results.push_back( result );
+  }
+
+  // print and save
+  std::cout<<"  ---------------- BENCHMARK ---------------- "<<std::endl;
+  std::cout<<"  "<< nEvents <<" events, mean gRefMult "<< meanRefMult <<", seed "<< seed <<std::endl;
+  for ( unsigned i = 0; i < results.size(); ++i )
+    std::cout<<"  "<< results[i].name <<": "<< results[i].seconds <<" s, "<< 1.0e6 * results[i].seconds / results[i].events <<" us per event, "<< 1.0e9 * results[i].seconds / std::max( (Long64_t) 1, results[i].objects ) <<" ns per object"<<std::endl;
+
+  if ( !WriteResults( outputFile, tag, meanRefMult, results ) ) {
+    __ERR( "Could not write " << outputFile )
+    return -1;
+  }
+  std::cout<<"  Results written to "<< outputFile <<std::endl;
+
+  for ( int i = 0; i < nEvents; ++i )
+    delete events[i].container;
+  delete histograms;
+
+  return 0;
+}
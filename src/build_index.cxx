@@ -0,0 +1,126 @@
+// Scans a data set once and writes an event index: one entry
+// per chain entry passing the reader's event cuts, with the
+// variables the drivers select on ( see eventIndexEntry ).
+// The drivers take the index with --index= and a selection
+// with --cut=, and then only read the entries that pass.
+// Nick Elsey
+
+// All reader and histogram settings
+// Are located in corrParameters.hh
+#include "corrParameters.hh"
+
+// The majority of the jetfinding
+// And correlation code is located in
+// corrFunctions.hh
+#include "corrFunctions.hh"
+
+// ROOT Headers
+#include "TFile.h"
+#include "TTree.h"
+#include "TChain.h"
+#include "TStopwatch.h"
+
+// STL Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <vector>
+#include <string>
+
+#include "TStarJetPicoUtils.h"
+
+// -------------------------
+// Command line arguments:
+// [0]: input file: can be a single .root or a .txt or .list of root files
+// [1]: collision type: auau || pp
+// [2]: output index file
+
+namespace patch {
+  template < typename T > std::string to_string( const T& n )
+  {
+    std::ostringstream stm ;
+    stm << n ;
+    return stm.str() ;
+  }
+}
+
+// DEF MAIN()
+int main ( int argc, const char** argv ) {
+
+  //Start a timer
+  TStopwatch TimeKeeper;
+  TimeKeeper.Start( );
+
+  std::string inputFile     = "/nfs/rhi/STAR/Data/CleanAuAuY7/Clean809.root";
+  std::string collisionType = "auau";
+  std::string indexFile     = "index.root";
+  std::string chainName     = "JetTree";
+
+  switch ( argc ) {
+    case 1: // Default case
+      __OUT( "Using Default Settings" )
+      break;
+    case 4: { // Custom case
+      __OUT( "Using Custom Settings" )
+      std::vector<std::string> arguments( argv+1, argv+argc );
+
+      inputFile     = arguments[0];
+      collisionType = arguments[1];
+      indexFile     = arguments[2];
+      break;
+    }
+    default: { // Error: invalid custom settings
+      __ERR( "Invalid number of command line arguments" )
+      return -1;
+      break;
+    }
+  }
+
+  if ( collisionType != "auau" && collisionType != "pp" ) {
+    __ERR( "Unknown collision type: Either auau or pp" )
+    return -1;
+  }
+
+  // Build the chain the same way the drivers do, so the
+  // entry numbers match
+  TChain* chain = new TChain( chainName.c_str() );
+  if ( jetHadron::HasEnding( inputFile, ".root" ) )      { chain->Add( inputFile.c_str() ); }
+  else if ( jetHadron::HasEnding( inputFile, ".txt" ) )  { chain = jetHadron::BuildChainFromList( inputFile, chainName ); }
+  else if ( jetHadron::HasEnding( inputFile, ".list" ) ) { chain = jetHadron::BuildChainFromList( inputFile, chainName ); }
+  else { __ERR("data file is not recognized type: .root, .list or .txt only.") return -1; }
+
+  // no software trigger: the max tower Et is recorded instead,
+  // so any threshold can be applied from the index
+  TStarJetPicoReader reader;
+  jetHadron::InitReader( reader, chain, collisionType, jetHadron::triggerAll, 0, jetHadron::allEvents );
+  Long64_t chainEntries = chain->GetEntries();
+
+  TFile out( indexFile.c_str(), "RECREATE" );
+  if ( out.IsZombie() ) {
+    __ERR( "Could not create " << indexFile )
+    return -1;
+  }
+  // the title records the chain size, checked when the index is used
+  TTree* index = new TTree( "eventIndex", patch::to_string( chainEntries ).c_str() );
+  jetHadron::eventIndexEntry entry;
+  jetHadron::BranchEventIndex( index, entry );
+
+  while ( reader.NextEvent() ) {
+    reader.PrintStatus(10);
+    jetHadron::FillEventIndex( reader, entry );
+    index->Fill();
+  }
+
+  out.cd();
+  index->Write();
+
+  std::cout<<"  ----------------- SUMMARY ----------------- "<<std::endl;
+  std::cout<<"  "<< chainEntries <<" chain entries, "<< index->GetEntries() <<" pass the event cuts"<<std::endl;
+  std::cout<<"  Index written to "<< indexFile <<" in "<< TimeKeeper.RealTime() <<" seconds"<<std::endl;
+
+  out.Close();
+
+  return 0;
+}
@@ -7,8 +7,25 @@
 #include "corrParameters.hh"
 #include "histograms.hh"
 
+#include "TClass.h"
+#include "TSystem.h"
+#include "TMD5.h"
+#include "TROOT.h"
+#include "RVersion.h"
+#include "ROOT/TBufferMerger.hxx"
+
 #include <time.h>
+#include <fstream>
 #include <random>
+#include <thread>
+#include <sys/resource.h>
+
+// TBufferMerger left the Experimental namespace in ROOT 6.22
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,22,0)
+typedef ROOT::TBufferMerger TBufferMergerType;
+#else
+typedef ROOT::Experimental::TBufferMerger TBufferMergerType;
+#endif
 
 namespace jetHadron {
 	
@@ -38,6 +55,19 @@ namespace jetHadron {
     }
   }
   
+  // Parses the analysis type string into its mode
+  analysisMode GetAnalysisMode( std::string analysisType ) {
+    if ( analysisType == "jet" )        return modeJet;
+    if ( analysisType == "dijet" )      return modeDijet;
+    if ( analysisType == "ppjet" )      return modePPJet;
+    if ( analysisType == "ppdijet" )    return modePPDijet;
+    if ( analysisType == "jetmix" )     return modeJetMix;
+    if ( analysisType == "dijetmix" )   return modeDijetMix;
+    if ( analysisType == "ppjetmix" )   return modePPJetMix;
+    if ( analysisType == "ppdijetmix" ) return modePPDijetMix;
+    return modeUnknown;
+  }
+  
   // Used to pull the current directory from its absolute path
   // Used in mixing to get mixing parameters
   std::string GetDirFromPath( std::string path ) {
@@ -91,10 +121,13 @@ namespace jetHadron {
   // Uses definitions in corrParameters.hh
   // ----------------------------------------------
   int GetReferenceCentrality( int gRefMult ) {
-    for ( int i = 8; i >= 0;  --i )
-      if ( gRefMult >= y7RefMultCent[i] ) {
-        return i;
-      }
+    // the edges are ascending, so the centrality is the number
+    // of edges at or below gRefMult, minus one - no early exit
+    int nEdgesBelow = 0;
+    for ( int i = 0; i < 9; ++i )
+      nEdgesBelow += ( gRefMult >= y7RefMultCent[i] );
+    if ( nEdgesBelow )
+      return nEdgesBelow - 1;
     // in case there is strange input
     __ERR("Reference Centrality not found")
     return -1;
@@ -116,14 +149,13 @@ namespace jetHadron {
     if ( Vz > vzHighEdge || Vz <= vzLowEdge )
       return -1;
     
-    // Loop and check each bin
-    for ( int i = binsVz-1; i >= 0; --i ) {
-      if ( Vz > ( vzLowEdge + dVz*i ) ) {
-        return i;
-      }
+    // NaN passes the boundary check
+    if ( Vz != Vz ) {
+      __ERR("There is a problem with VzBin finding")
+      return VzBin;
     }
-    __ERR("There is a problem with VzBin finding")
-    return VzBin;
+    
+    return UniformBinUpperClosed( Vz, vzLowEdge, dVz, binsVz );
   }
   
   // Fills our working container after converting TStarJetVectors into PseudoJets
@@ -131,6 +163,9 @@ namespace jetHadron {
   //
   // ------------------------------------------------------------------------------
   void ConvertTStarJetVector( TStarJetVectorContainer<TStarJetVector>* container, std::vector<fastjet::PseudoJet> & particles, bool ClearVector, double towerScale ) {
+    stageTimer timer( stageConvert );
+    CountStage( stageConvert, container->GetEntries() );
+    
     // Empty the container
     // if called for
     if ( ClearVector )
@@ -154,6 +189,9 @@ namespace jetHadron {
   
   // applies an effective 90% relative efficiency compared to auau
   void ConvertTStarJetVectorPP( TStarJetVectorContainer<TStarJetVector>* container, std::vector<fastjet::PseudoJet> & particles, ktTrackEff& eff, int64_t seed, bool ClearVector, double towerScale ) {
+    stageTimer timer( stageConvert );
+    CountStage( stageConvert, container->GetEntries() );
+    
     // Empty the container
     // if called for
     if ( ClearVector )
@@ -189,6 +227,9 @@ namespace jetHadron {
   
   // For AuAu being embedded into PP
   void ConvertTStarJetVectorPPEmbedded( TStarJetVectorContainer<TStarJetVector>* container, std::vector<fastjet::PseudoJet> & particles, bool allTracks, double towerScale ) {
+    stageTimer timer( stageConvert );
+    CountStage( stageConvert, container->GetEntries() );
+    
     
     // Transform TStarJetVectors into (FastJet) PseudoJets
     // ---------------------------------------------------
@@ -230,20 +271,133 @@ namespace jetHadron {
   }
   
   // for the pp data where the trigger objects dont seem to be working
-  void GetTriggersPP( bool requireTrigger, std::vector<fastjet::PseudoJet> ppParticles, std::vector<fastjet::PseudoJet>& triggers ) {
+  void GetTriggersPP( bool requireTrigger, const std::vector<fastjet::PseudoJet>& ppParticles, std::vector<fastjet::PseudoJet>& triggers ) {
     // empty the container
     triggers.clear();
     
     // if we're using triggers, run over all towers and get any with E > triggerThreshold
     if ( requireTrigger ) {
-      for ( int i = 0; i < ppParticles.size(); ++i ) {
-        fastjet::PseudoJet tmpParticle = ppParticles[i];
-        if ( tmpParticle.pt() > triggerThreshold )
-          triggers.push_back( tmpParticle );
-      
+      for ( unsigned i = 0; i < ppParticles.size(); ++i ) {
+        if ( ppParticles[i].pt() > triggerThreshold )
+          triggers.push_back( ppParticles[i] );
       }
     }
   }
+  
+  // Trigger grid
+  // rapidity is clamped to the grid, so anything outside
+  // maxRap lands in the edge cells and is still found
+  // ---------------------------------------------------------------------
+  triggerIndex::triggerIndex( double cellSize, double maxRap ) {
+    fNRap = std::max( 1, (int) floor( 2.0 * maxRap / cellSize ) );
+    fNPhi = std::max( 1, (int) floor( 2.0 * TMath::Pi() / cellSize ) );
+    fRapLow = -maxRap;
+    fRapWidth = 2.0 * maxRap / fNRap;
+    fPhiWidth = 2.0 * TMath::Pi() / fNPhi;
+    fCells.resize( fNRap * fNPhi );
+  }
+  
+  int triggerIndex::RapCell( double rap ) const {
+    int cell = (int) floor( ( rap - fRapLow ) / fRapWidth );
+    return std::min( std::max( cell, 0 ), fNRap - 1 );
+  }
+  
+  int triggerIndex::PhiCell( double phi ) const {
+    int cell = (int) floor( phi / fPhiWidth );
+    return std::min( std::max( cell, 0 ), fNPhi - 1 );
+  }
+  
+  void triggerIndex::Fill( const std::vector<fastjet::PseudoJet>& triggers ) {
+    for ( unsigned i = 0; i < fCells.size(); ++i )
+      fCells[i].clear();
+    fTriggers = triggers;
+    for ( unsigned i = 0; i < fTriggers.size(); ++i )
+      fCells[ RapCell( fTriggers[i].rap() ) * fNPhi + PhiCell( fTriggers[i].phi() ) ].push_back( i );
+  }
+  
+  int triggerIndex::FirstWithin( const fastjet::PseudoJet& jet, double radius, bool inclusive ) const {
+    if ( fTriggers.empty() )
+      return -1;
+    
+    // how many cells to either side cover the radius
+    int rapReach = (int) ceil( radius / fRapWidth );
+    int phiReach = (int) ceil( radius / fPhiWidth );
+    int rapCell = RapCell( jet.rap() );
+    int phiCell = PhiCell( jet.phi() );
+    int phiFirst = phiCell - phiReach;
+    int phiLast  = phiCell + phiReach;
+    // dont visit a phi cell twice when the reach wraps all the way around
+    if ( phiLast - phiFirst + 1 >= fNPhi ) {
+      phiFirst = 0;
+      phiLast = fNPhi - 1;
+    }
+    
+    int first = -1;
+    double radius2 = radius * radius;
+    for ( int i = std::max( 0, rapCell - rapReach ); i <= std::min( fNRap - 1, rapCell + rapReach ); ++i ) {
+      for ( int j = phiFirst; j <= phiLast; ++j ) {
+        const std::vector<int>& cell = fCells[ i * fNPhi + ( ( j % fNPhi ) + fNPhi ) % fNPhi ];
+        // indices in a cell are ascending
+        for ( unsigned k = 0; k < cell.size(); ++k ) {
+          if ( first >= 0 && cell[k] >= first )
+            break;
+          const fastjet::PseudoJet& trigger = fTriggers[ cell[k] ];
+          bool within = ( inclusive ? jet.squared_distance( trigger ) <= radius2 : jet.delta_R( trigger ) < radius );
+          if ( within ) {
+            first = cell[k];
+            break;
+          }
+        }
+      }
+    }
+    return first;
+  }
+  
+  // Region of interest hard clustering
+  // ---------------------------------------------------------------------
+  double RegionOfInterestRadius( double matchDistance, double jetRadius ) {
+    return matchDistance + roiGuardRadii * jetRadius;
+  }
+  
+  std::vector<fastjet::PseudoJet> SelectRegionOfInterest( std::string analysisType, const std::vector<fastjet::PseudoJet>& constituents, const triggerIndex& triggers, double roiRadius, double jetRadius, double& outsidePt, double& edgePt ) {
+    // a dijet partner is back to back with the trigger matched jet, so
+    // it is at least pi - jetDPhiCut - roiRadius away from the trigger
+    bool awaySide = ( analysisType == "dijet" || analysisType == "ppdijet" );
+    double awayEdge = std::min( TMath::Pi() / 2.0, TMath::Pi() - jetDPhiCut - roiRadius );
+    const std::vector<fastjet::PseudoJet>& triggerList = triggers.GetTriggers();
+    
+    std::vector<fastjet::PseudoJet> selected;
+    outsidePt = 0;
+    edgePt = 0;
+    for ( unsigned i = 0; i < constituents.size(); ++i ) {
+      bool inside = triggers.AnyWithin( constituents[i], roiRadius );
+      for ( unsigned j = 0; awaySide && !inside && j < triggerList.size(); ++j )
+        inside = fabs( constituents[i].delta_phi_to( triggerList[j] ) ) > awayEdge;
+      if ( inside ) {
+        selected.push_back( constituents[i] );
+        continue;
+      }
+      outsidePt += constituents[i].pt();
+      // within jetRadius of the region: of a trigger's circle,
+      // or of an away side half plane
+      bool edge = triggers.AnyWithin( constituents[i], roiRadius + jetRadius );
+      for ( unsigned j = 0; awaySide && !edge && j < triggerList.size(); ++j )
+        edge = fabs( constituents[i].delta_phi_to( triggerList[j] ) ) > awayEdge - jetRadius;
+      if ( edge )
+        edgePt += constituents[i].pt();
+    }
+    return selected;
+  }
+  
+  bool RegionOfInterestExact( std::string analysisType, double outsidePt, double edgePt, double subJetPtMin ) {
+    // a jet could be cut by the edge of the region
+    if ( edgePt > 0 )
+      return false;
+    if ( analysisType != "dijet" && analysisType != "ppdijet" )
+      return true;
+    // a jet of what was left out could pass the subleading cut
+    return outsidePt < subJetPtMin;
+  }
 
 	// ----------------------
 	// Verbose output scripts
@@ -293,6 +447,7 @@ namespace jetHadron {
 		std::cout<<"  Of these "<< nviable <<" hard dijets, "<< nused <<" produced full dijets that were used"<<std::endl;
 		std::cout<<"  for correlation."<<std::endl;
 		std::cout<<"  Overall Efficiency: "<< time/ (double) nused <<" seconds per dijet"<<std::endl;
+    PrintStageSummary();
 	}
 
 	// Called after jet correlation event loop is complete
@@ -305,6 +460,7 @@ namespace jetHadron {
 		std::cout<<"  Chance per event to find a leading jet"<<std::endl;
 		std::cout<<"  for correlation."<<std::endl;
 		std::cout<<"  Overall Efficiency: "<< time/ (double) nused <<" seconds per jet"<<std::endl;
+    PrintStageSummary();
 	}
 	
   // Used to initialized the reader - will set the event cuts,
@@ -326,24 +482,7 @@ namespace jetHadron {
     // Event and track selection
     // -------------------------
     
-    TStarJetPicoEventCuts* evCuts = reader.GetEventCuts();
-    evCuts->SetTriggerSelection( triggerString.c_str() );
-    evCuts->SetVertexZCut ( vertexZCut );
-    evCuts->SetMaxEventPtCut( eventPtCut );
-    evCuts->SetMaxEventEtCut( eventEtCut );
-    
-    if( softwareTrigger )
-      evCuts->SetMinEventEtCut( softwareTrigger );
-    
-    evCuts->SetVertexZDiffCut( vertexZDiffCut );
-    if ( collisionType == "auau" ) {
-    	evCuts->SetRefMultCut ( y7RefMultCut );
-    }
-    else if ( collisionType == "pp" ) {
-      evCuts->SetRefMultCut( 0 );
-    }
-    else
-      __ERR("unknown collision system")
+    InitEventCuts( reader.GetEventCuts(), collisionType, triggerString, softwareTrigger );
     
     // Tracks cuts
     TStarJetPicoTrackCuts* trackCuts = reader.GetTrackCuts();
@@ -380,6 +519,208 @@ namespace jetHadron {
 
   }
   
+  void InitEventCuts( TStarJetPicoEventCuts* evCuts, std::string collisionType, std::string triggerString, double softwareTrigger ) {
+    
+    std::transform(collisionType.begin(), collisionType.end(), collisionType.begin(), ::tolower);
+    
+    evCuts->SetTriggerSelection( triggerString.c_str() );
+    evCuts->SetVertexZCut ( vertexZCut );
+    evCuts->SetMaxEventPtCut( eventPtCut );
+    evCuts->SetMaxEventEtCut( eventEtCut );
+    
+    if( softwareTrigger )
+      evCuts->SetMinEventEtCut( softwareTrigger );
+    
+    evCuts->SetVertexZDiffCut( vertexZDiffCut );
+    if ( collisionType == "auau" ) {
+    	evCuts->SetRefMultCut ( y7RefMultCut );
+    }
+    else if ( collisionType == "pp" ) {
+      evCuts->SetRefMultCut( 0 );
+    }
+    else
+      __ERR("unknown collision system")
+  }
+  
+  // Manifests for the input lists, used to build chains
+  // without opening every file
+  // ---------------------------------------------------------------------
+  std::string ManifestPath( std::string listFile ) {
+    return listFile + ".manifest";
+  }
+  
+  std::vector<std::string> ReadFileList( std::string listFile ) {
+    std::vector<std::string> files;
+    std::ifstream list( listFile.c_str() );
+    std::string line;
+    while ( std::getline( list, line ) ) {
+      std::istringstream tokens( line );
+      std::string path;
+      if ( tokens >> path && path[0] != '#' )
+        files.push_back( path );
+    }
+    return files;
+  }
+  
+  bool ReadManifest( std::string manifestFile, std::vector<manifestEntry>& manifest ) {
+    manifest.clear();
+    std::ifstream in( manifestFile.c_str() );
+    if ( !in.is_open() )
+      return false;
+    std::string line;
+    while ( std::getline( in, line ) ) {
+      if ( line.size() == 0 || line[0] == '#' )
+        continue;
+      std::istringstream tokens( line );
+      std::vector<std::string> fields;
+      std::string field;
+      while ( tokens >> field )
+        fields.push_back( field );
+      if ( fields.size() != 4 && fields.size() != 5 ) {
+        __ERR( "malformed line in " << manifestFile << ": " << line )
+        return false;
+      }
+      manifestEntry entry;
+      entry.path = fields[0];
+      entry.entries = atoll( fields[1].c_str() );
+      entry.bytes = atoll( fields[2].c_str() );
+      entry.modtime = ( fields.size() == 5 ? atol( fields[3].c_str() ) : -1 );
+      entry.checksum = fields.back();
+      manifest.push_back( entry );
+    }
+    return true;
+  }
+  
+  bool WriteManifest( std::string manifestFile, std::string listFile, const std::vector<manifestEntry>& manifest ) {
+    std::ofstream out( manifestFile.c_str() );
+    if ( !out.is_open() ) {
+      __ERR( "Could not open " << manifestFile )
+      return false;
+    }
+    out << "# manifest for " << listFile << ": path entries bytes modtime md5" << std::endl;
+    for ( unsigned i = 0; i < manifest.size(); ++i )
+      out << manifest[i].path << " " << manifest[i].entries << " " << manifest[i].bytes << " " << manifest[i].modtime << " " << manifest[i].checksum << std::endl;
+    return true;
+  }
+  
+  bool ManifestEntryCurrent( const manifestEntry& entry ) {
+    Long_t id, flags, modtime;
+    Long64_t size;
+    if ( gSystem->GetPathInfo( entry.path.c_str(), &id, &size, &flags, &modtime ) != 0 )
+      return false;
+    return size == entry.bytes && modtime == entry.modtime;
+  }
+  
+  std::string ManifestDigest( std::string listFile ) {
+    std::vector<manifestEntry> manifest;
+    if ( !ReadManifest( ManifestPath( listFile ), manifest ) )
+      return "";
+    std::unordered_map<std::string, unsigned> manifestIndex;
+    for ( unsigned i = 0; i < manifest.size(); ++i )
+      manifestIndex[manifest[i].path] = i;
+    
+    std::string checksums;
+    std::vector<std::string> files = ReadFileList( listFile );
+    for ( unsigned i = 0; i < files.size(); ++i ) {
+      std::unordered_map<std::string, unsigned>::iterator found = manifestIndex.find( files[i] );
+      if ( found == manifestIndex.end() || !ManifestEntryCurrent( manifest[found->second] ) )
+        return "";
+      checksums += files[i] + " " + manifest[found->second].checksum + "\n";
+    }
+    TMD5 md5;
+    md5.Update( (const UChar_t*) checksums.c_str(), checksums.size() );
+    md5.Final();
+    return md5.AsString();
+  }
+  
+  TChain* BuildChainFromList( std::string listFile, std::string chainName ) {
+    std::vector<manifestEntry> manifest;
+    if ( !ReadManifest( ManifestPath( listFile ), manifest ) )
+      return TStarJetPicoUtils::BuildChainFromFileList( listFile.c_str() );
+    
+    std::unordered_map<std::string, unsigned> manifestIndex;
+    for ( unsigned i = 0; i < manifest.size(); ++i )
+      manifestIndex[manifest[i].path] = i;
+    
+    // a stat per file is still much cheaper than an open on NFS
+    TChain* chain = new TChain( chainName.c_str() );
+    std::vector<std::string> files = ReadFileList( listFile );
+    unsigned nStale = 0;
+    for ( unsigned i = 0; i < files.size(); ++i ) {
+      std::unordered_map<std::string, unsigned>::iterator found = manifestIndex.find( files[i] );
+      if ( found != manifestIndex.end() && ManifestEntryCurrent( manifest[found->second] ) ) {
+        chain->Add( files[i].c_str(), manifest[found->second].entries );
+      }
+      else {
+        chain->Add( files[i].c_str() );
+        nStale++;
+      }
+    }
+    if ( nStale )
+      __WARN( nStale << " of " << files.size() << " files are missing from " << ManifestPath( listFile ) << " or have changed - refresh it with make_manifest" )
+    return chain;
+  }
+  
+  // Used to split a chain into pieces for job submission
+  // either an explicit first:n range or shard/nShards
+  // ---------------------------------------------------------------------
+  bool GetEntryRange( std::string rangeString, Long64_t chainEntries, Long64_t& firstEntry, Long64_t& lastEntry ) {
+    // default is the full chain
+    firstEntry = 0;
+    lastEntry = chainEntries;
+    if ( rangeString == "all" || rangeString == "" )
+      return true;
+    
+    std::size_t colon = rangeString.find(":");
+    std::size_t slash = rangeString.find("/");
+    
+    if ( colon != std::string::npos ) {
+      Long64_t first = atoll( rangeString.substr( 0, colon ).c_str() );
+      Long64_t nEntries = atoll( rangeString.substr( colon+1 ).c_str() );
+      if ( first < 0 ) {
+        __ERR("first entry must be positive")
+        return false;
+      }
+      firstEntry = std::min( first, chainEntries );
+      if ( nEntries >= 0 )
+        lastEntry = std::min( firstEntry + nEntries, chainEntries );
+    }
+    else if ( slash != std::string::npos ) {
+      Long64_t shard = atoll( rangeString.substr( 0, slash ).c_str() );
+      Long64_t nShards = atoll( rangeString.substr( slash+1 ).c_str() );
+      if ( nShards <= 0 || shard < 0 || shard >= nShards ) {
+        __ERR("shard index must be in [0, nShards)")
+        return false;
+      }
+      // spread the remainder over the first shards
+      // so shard sizes differ by at most one entry
+      Long64_t shardSize = chainEntries / nShards;
+      Long64_t remainder = chainEntries % nShards;
+      firstEntry = shard * shardSize + std::min( shard, remainder );
+      lastEntry = firstEntry + shardSize + ( shard < remainder ? 1 : 0 );
+    }
+    else {
+      __ERR("unrecognized entry range: use all, first:n or shard/nShards")
+      return false;
+    }
+    
+    return true;
+  }
+  
+  // Steps the reader through [entry, lastEntry), returning
+  // once an event passes the reader's event cuts
+  // ---------------------------------------------------------------------
+  bool NextEventInRange( TStarJetPicoReader & reader, Long64_t& entry, Long64_t lastEntry ) {
+    stageTimer timer( stageRead );
+    while ( entry < lastEntry ) {
+      Long64_t current = entry++;
+      CountStage( stageRead );
+      if ( reader.ReadEvent( current ) )
+        return true;
+    }
+    return false;
+  }
+  
   // Use this to decide if there are 2 dijets for dijet analysis
   // in the proper pt ranges, and if they're back to back
   // Or for jet analysis if there is a single jet
@@ -431,6 +772,16 @@ namespace jetHadron {
   
   //
   std::vector<fastjet::PseudoJet> BuildMatchedJets( std::string analysisType, std::vector<fastjet::PseudoJet> & hardJets, std::vector<fastjet::PseudoJet> & LoResult, bool requireTrigger, std::vector<fastjet::PseudoJet> & triggers, double jetRadius ) {
+    triggerIndex triggerGrid( jetRadius, maxTrackRap );
+    if ( requireTrigger )
+      triggerGrid.Fill( triggers );
+    return BuildMatchedJets( analysisType, hardJets, LoResult, requireTrigger, triggerGrid, jetRadius );
+  }
+  
+  std::vector<fastjet::PseudoJet> BuildMatchedJets( std::string analysisType, std::vector<fastjet::PseudoJet> & hardJets, std::vector<fastjet::PseudoJet> & LoResult, bool requireTrigger, const triggerIndex & triggers, double jetRadius ) {
+    stageTimer timer( stageMatch );
+    CountStage( stageMatch, hardJets.size() );
+    
     if ( analysisType == "dijet" || analysisType == "ppdijet" ) {
       
       // make sure the input makes sense
@@ -451,7 +802,7 @@ namespace jetHadron {
       std::vector<fastjet::PseudoJet> matchedToSub = sorted_by_pt( selectMatchedSub( LoResult ));
       
       if ( matchedToLead.size() == 0 || matchedToSub.size() == 0 ) {
-        __OUT("Couldn't match hard and soft jets")
+        __DBG("Couldn't match hard and soft jets")
         return std::vector<fastjet::PseudoJet>();
       }
       
@@ -468,14 +819,8 @@ namespace jetHadron {
       // make sub jet the leading jet
       // otherwise, return the dijets without matching
       if ( requireTrigger ) {
-        bool matchedLeadTrigger = false;
-        bool matchedSubTrigger = false;
-        for ( int i = 0; i < triggers.size(); ++i ) {
-          if ( matchedToDijet.at(0).delta_R( triggers.at(i) ) < jetRadius )
-            matchedLeadTrigger = true;
-          else if ( matchedToDijet.at(1).delta_R( triggers.at(i) ) < jetRadius )
-            matchedSubTrigger = true;
-        }
+        bool matchedLeadTrigger = triggers.AnyWithin( matchedToDijet.at(0), jetRadius );
+        bool matchedSubTrigger = !matchedLeadTrigger && triggers.AnyWithin( matchedToDijet.at(1), jetRadius );
         
         // check to make sure the matched jets are within the
         // accepted eta range
@@ -510,21 +855,25 @@ namespace jetHadron {
       // Jet analysis uses hard jet so no need to match
       // Check if it has to be matched to HT trigger
       if ( requireTrigger ) {
-        // build selector to match triggers to the jet
-        fastjet::Selector selectMatchedTrigger = fastjet::SelectorCircle( jetRadius );
-        
-        for ( int j = 0; j < triggers.size(); ++ j ) {
-	        selectMatchedTrigger.set_reference( triggers.at(j) );
-					
-          std::vector<fastjet::PseudoJet> matchedToJet = sorted_by_pt(selectMatchedTrigger( hardJets ) );
-          if ( matchedToJet.size() > 0 ) {
-            matchedToJet.resize(1);
-            return matchedToJet;
-          }
-        	
+        // the first trigger ( in trigger order ) with any hard jet
+        // in its circle decides - same as a SelectorCircle per trigger
+        int firstTrigger = -1;
+        for ( unsigned i = 0; i < hardJets.size(); ++i ) {
+          int trigger = triggers.FirstWithin( hardJets[i], jetRadius, true );
+          if ( trigger >= 0 && ( firstTrigger < 0 || trigger < firstTrigger ) )
+            firstTrigger = trigger;
         }
         // if we didnt find a matched trigger, return empty
-        return std::vector<fastjet::PseudoJet>();
+        if ( firstTrigger < 0 )
+          return std::vector<fastjet::PseudoJet>();
+        
+        // then the highest pt jet matched to that trigger
+        const fastjet::PseudoJet& trigger = triggers.GetTriggers()[firstTrigger];
+        std::vector<fastjet::PseudoJet> matchedToJet;
+        for ( unsigned i = 0; i < hardJets.size(); ++i )
+          if ( hardJets[i].squared_distance( trigger ) <= jetRadius * jetRadius && ( matchedToJet.empty() || hardJets[i].pt2() > matchedToJet[0].pt2() ) )
+            matchedToJet.assign( 1, hardJets[i] );
+        return matchedToJet;
       }
       else {
         // if we dont match to triggers, simply return
@@ -559,7 +908,9 @@ namespace jetHadron {
     return true;
   }
   
-  bool correlateLeading( std::string analysisType, int vzBin, int centBin, histograms* histogram, fastjet::PseudoJet& leadJet, fastjet::PseudoJet& assocTrack, double efficiency, double aj ) {
+  bool correlateLeading( analysisMode mode, int vzBin, int centBin, histograms* histogram, fastjet::PseudoJet& leadJet, fastjet::PseudoJet& assocTrack, double efficiency, double aj ) {
+    
+    stageTimer timer( stageCorrelate );
     
     // check if track is ok
     if ( !useTrack( assocTrack, efficiency ) )
@@ -577,11 +928,14 @@ namespace jetHadron {
     
     // now fill the histograms
     histogram->FillCorrelationLead( deltaEta, deltaPhi, assocPt, weight, aj, vzBin, centBin );
+    CountStage( stageCorrelate );
     
     return true;
   }
   
-  bool correlateSubleading( std::string analysisType, int vzBin, int centBin, histograms* histogram, fastjet::PseudoJet& subJet, fastjet::PseudoJet& assocTrack, double efficiency, double aj ) {
+  bool correlateSubleading( analysisMode mode, int vzBin, int centBin, histograms* histogram, fastjet::PseudoJet& subJet, fastjet::PseudoJet& assocTrack, double efficiency, double aj ) {
+    
+    stageTimer timer( stageCorrelate );
     
     // check if track is ok
     if ( !useTrack( assocTrack, efficiency ) )
@@ -598,11 +952,14 @@ namespace jetHadron {
     
     // now fill the histograms
     histogram->FillCorrelationSub( deltaEta, deltaPhi, assocPt, weight, aj, vzBin, centBin );
+    CountStage( stageCorrelate );
     
     return true;
   }
   
-  bool correlateTrigger( std::string analysisType, int vzBin, int centBin, histograms* histogram, fastjet::PseudoJet& triggerJet, fastjet::PseudoJet& assocTrack, double efficiency ) {
+  bool correlateTrigger( analysisMode mode, int vzBin, int centBin, histograms* histogram, fastjet::PseudoJet& triggerJet, fastjet::PseudoJet& assocTrack, double efficiency ) {
+    
+    stageTimer timer( stageCorrelate );
     
     // check if track is ok
     if ( !useTrack( assocTrack, efficiency ) )
@@ -619,6 +976,7 @@ namespace jetHadron {
     
     // now fill the histograms
     histogram->FillCorrelation( deltaEta, deltaPhi, assocPt, weight, vzBin, centBin );
+    CountStage( stageCorrelate );
     
     return true;
   }
@@ -680,6 +1038,438 @@ namespace jetHadron {
     return fastjet::SelectorAbsRapMax( maxTrackRap - jetRadius ) * (!fastjet::SelectorNHardest(2));
   }
   
+  // --------------------------
+  // ---- Strategy Tuning -----
+  // --------------------------
+  
+  namespace {
+    const fastjet::Strategy tunedStrategies[] = { fastjet::N2Plain, fastjet::N2Tiled, fastjet::N2MinHeapTiled, fastjet::NlnN };
+    const char* tunedStrategyNames[] = { "N2Plain", "N2Tiled", "N2MinHeapTiled", "NlnN" };
+    const unsigned nTunedStrategies = 4;
+    
+    // from the hard constituent pass up to a central event with ghosts
+    const unsigned tunedMultiplicities[] = { 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192 };
+    const unsigned nTunedMultiplicities = 11;
+    
+    // a strategy is not timed at larger multiplicities
+    // once a single clustering takes longer than this
+    const double maxClusterSeconds = 1.0;
+    
+    std::vector<strategyTuner*> strategyTuners;
+  }
+  
+  strategyTuner::strategyTuner( const fastjet::JetDefinition& jetDef ) : fJetDef( jetDef ), fMultiplicities( tunedMultiplicities, tunedMultiplicities + nTunedMultiplicities ), fSeconds( nTunedMultiplicities, std::vector<double>( nTunedStrategies, -1.0 ) ), fBest( nTunedMultiplicities, 0 ), fCalibrated( false ) { }
+  
+  unsigned strategyTuner::NStrategies()                         { return nTunedStrategies; }
+  fastjet::Strategy strategyTuner::GetStrategy( unsigned strategy ) { return tunedStrategies[strategy]; }
+  std::string strategyTuner::StrategyName( unsigned strategy )  { return tunedStrategyNames[strategy]; }
+  
+  bool strategyTuner::Matches( const fastjet::JetDefinition& jetDef ) const {
+    return jetDef.jet_algorithm() == fJetDef.jet_algorithm() && fabs( jetDef.R() - fJetDef.R() ) < 1e-6;
+  }
+  
+  void strategyTuner::Calibrate( double minSeconds ) {
+    // soft, uniform events over the ghosted rapidity range, so the
+    // largest points look like an area clustering of a central event
+    std::mt19937 generator( 12345 );
+    std::uniform_real_distribution<> rapidity( -maxTrackRap - fJetDef.R(), maxTrackRap + fJetDef.R() );
+    std::uniform_real_distribution<> phi( 0, 2.0 * TMath::Pi() );
+    std::exponential_distribution<> pt( 2.0 );
+    
+    // NlnN throws if fastjet was built without CGAL
+    fastjet::Error::set_print_errors( false );
+    std::vector<bool> tooSlow( nTunedStrategies, false );
+    for ( unsigned point = 0; point < fMultiplicities.size(); ++point ) {
+      std::vector<fastjet::PseudoJet> particles;
+      for ( unsigned i = 0; i < fMultiplicities[point]; ++i ) {
+        fastjet::PseudoJet particle;
+        particle.reset_PtYPhiM( trackMinPt + pt( generator ), rapidity( generator ), phi( generator ) );
+        particles.push_back( particle );
+      }
+      
+      for ( unsigned strategy = 0; strategy < nTunedStrategies; ++strategy ) {
+        fSeconds[point][strategy] = -1.0;
+        if ( tooSlow[strategy] )
+          continue;
+        fastjet::JetDefinition jetDef( fJetDef.jet_algorithm(), fJetDef.R(), fJetDef.recombination_scheme(), tunedStrategies[strategy] );
+        try {
+          unsigned repeats = 0;
+          std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+          double elapsed = 0;
+          while ( repeats < 3 || elapsed < minSeconds ) {
+            fastjet::ClusterSequence clusterSequence( particles, jetDef );
+            repeats++;
+            elapsed = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+            if ( elapsed > maxClusterSeconds )
+              break;
+          }
+          fSeconds[point][strategy] = elapsed / repeats;
+          if ( fSeconds[point][strategy] > maxClusterSeconds )
+            tooSlow[strategy] = true;
+        }
+        catch ( fastjet::Error& error ) {
+          tooSlow[strategy] = true;
+        }
+      }
+    }
+    fastjet::Error::set_print_errors( true );
+    
+    for ( unsigned point = 0; point < fMultiplicities.size(); ++point ) {
+      fBest[point] = 0;
+      for ( unsigned strategy = 0; strategy < nTunedStrategies; ++strategy ) {
+        double seconds = fSeconds[point][strategy];
+        double best = fSeconds[point][fBest[point]];
+        if ( seconds >= 0 && ( best < 0 || seconds < best ) )
+          fBest[point] = strategy;
+      }
+    }
+    fCalibrated = true;
+  }
+  
+  // one line per multiplicity: algorithm R multiplicity best seconds...
+  void strategyTuner::Save( std::ostream& out ) const {
+    for ( unsigned point = 0; point < fMultiplicities.size(); ++point ) {
+      out << (int) fJetDef.jet_algorithm() << " " << fJetDef.R() << " " << fMultiplicities[point] << " " << tunedStrategyNames[fBest[point]];
+      for ( unsigned strategy = 0; strategy < nTunedStrategies; ++strategy )
+        out << " " << fSeconds[point][strategy];
+      out << std::endl;
+    }
+  }
+  
+  bool strategyTuner::Load( std::string profileFile ) {
+    std::ifstream in( profileFile.c_str() );
+    if ( !in.is_open() )
+      return false;
+    unsigned nLoaded = 0;
+    std::string line;
+    while ( std::getline( in, line ) ) {
+      if ( line.size() == 0 || line[0] == '#' )
+        continue;
+      std::istringstream tokens( line );
+      int algorithm;
+      double R;
+      unsigned multiplicity;
+      std::string best;
+      if ( !( tokens >> algorithm >> R >> multiplicity >> best ) )
+        continue;
+      if ( algorithm != (int) fJetDef.jet_algorithm() || fabs( R - fJetDef.R() ) > 1e-6 )
+        continue;
+      std::vector<unsigned>::iterator point = std::find( fMultiplicities.begin(), fMultiplicities.end(), multiplicity );
+      if ( point == fMultiplicities.end() )
+        continue;
+      unsigned index = point - fMultiplicities.begin();
+      for ( unsigned strategy = 0; strategy < nTunedStrategies; ++strategy ) {
+        tokens >> fSeconds[index][strategy];
+        if ( best == tunedStrategyNames[strategy] )
+          fBest[index] = strategy;
+      }
+      nLoaded++;
+    }
+    fCalibrated = ( nLoaded == fMultiplicities.size() );
+    return fCalibrated;
+  }
+  
+  // nearest ladder point in log( multiplicity )
+  fastjet::Strategy strategyTuner::Best( unsigned nInputs ) const {
+    unsigned point = 0;
+    while ( point + 1 < fMultiplicities.size() && (double) nInputs * nInputs > (double) fMultiplicities[point] * fMultiplicities[point+1] )
+      point++;
+    return tunedStrategies[fBest[point]];
+  }
+  
+  bool InitStrategyTuning( std::string profileFile, const std::vector<fastjet::JetDefinition>& definitions, bool recalibrate ) {
+    bool calibrated = false;
+    for ( unsigned i = 0; i < definitions.size(); ++i ) {
+      strategyTuner* tuner = new strategyTuner( definitions[i] );
+      if ( recalibrate || profileFile.size() == 0 || !tuner->Load( profileFile ) ) {
+        __OUT( "Calibrating clustering strategies for " << definitions[i].description() )
+        tuner->Calibrate();
+        calibrated = true;
+      }
+      strategyTuners.push_back( tuner );
+    }
+    
+    // rewrite the profile with every tuner, so other definitions
+    // already in the file are only dropped if they are recalibrated
+    if ( calibrated && profileFile.size() ) {
+      std::ofstream out( profileFile.c_str() );
+      if ( !out.is_open() ) {
+        __ERR( "Could not write strategy profile " << profileFile )
+        return false;
+      }
+      out << "# clustering strategy profile: algorithm R multiplicity best";
+      for ( unsigned strategy = 0; strategy < nTunedStrategies; ++strategy )
+        out << " " << tunedStrategyNames[strategy];
+      out << " ( seconds per clustering )" << std::endl;
+      for ( unsigned i = 0; i < strategyTuners.size(); ++i )
+        strategyTuners[i]->Save( out );
+    }
+    return true;
+  }
+  
+  const std::vector<strategyTuner*>& GetStrategyTuners() {
+    return strategyTuners;
+  }
+  
+  fastjet::JetDefinition TunedDefinition( const fastjet::JetDefinition& jetDef, unsigned nInputs ) {
+    for ( unsigned i = 0; i < strategyTuners.size(); ++i )
+      if ( strategyTuners[i]->Matches( jetDef ) )
+        return fastjet::JetDefinition( jetDef.jet_algorithm(), jetDef.R(), jetDef.recombination_scheme(), strategyTuners[i]->Best( nInputs ) );
+    return jetDef;
+  }
+  
+  unsigned GhostCount( const fastjet::AreaDefinition& areaDef ) {
+    return areaDef.ghost_spec().n_ghosts();
+  }
+  
+  // --------------------------
+  // -------- Jet Trees -------
+  // --------------------------
+  
+  void BranchJetTree( TTree* tree, jetTreeEntry& entry, bool dijet ) {
+    tree->Branch( "leadPt", &entry.lead.pt, "leadPt/F" );
+    tree->Branch( "leadEta", &entry.lead.eta, "leadEta/F" );
+    tree->Branch( "leadPhi", &entry.lead.phi, "leadPhi/F" );
+    tree->Branch( "leadE", &entry.lead.E, "leadE/F" );
+    if ( dijet ) {
+      tree->Branch( "subPt", &entry.sub.pt, "subPt/F" );
+      tree->Branch( "subEta", &entry.sub.eta, "subEta/F" );
+      tree->Branch( "subPhi", &entry.sub.phi, "subPhi/F" );
+      tree->Branch( "subE", &entry.sub.E, "subE/F" );
+    }
+    tree->Branch( "vz", &entry.vz, "vz/F" );
+    tree->Branch( "vertexZBin", &entry.vertexZBin, "vertexZBin/I" );
+    tree->Branch( "centralityBin", &entry.centralityBin, "centralityBin/I" );
+    tree->Branch( "aj", &entry.aj, "aj/F" );
+    tree->Branch( "runId", &entry.runId, "runId/I" );
+    tree->Branch( "eventId", &entry.eventId, "eventId/I" );
+  }
+  
+  void SetTreeJet( jetTreeJet& treeJet, const fastjet::PseudoJet& jet ) {
+    treeJet.pt = jet.pt();
+    treeJet.eta = jet.eta();
+    treeJet.phi = jet.phi_std();
+    treeJet.E = jet.E();
+  }
+  
+  // same construction as TLorentzVector::SetPtEtaPhiE
+  fastjet::PseudoJet TreeJetToPseudoJet( const jetTreeJet& treeJet ) {
+    double pt = treeJet.pt;
+    return fastjet::PseudoJet( pt * cos( treeJet.phi ), pt * sin( treeJet.phi ), pt * sinh( treeJet.eta ), treeJet.E );
+  }
+  
+  jetTreeReader::jetTreeReader() : fTree(0), fDijet(false), fLegacy(false), fLeadVector(0), fSubVector(0), fLegacyAj(0) {
+    memset( &fEntry, 0, sizeof(fEntry) );
+  }
+  
+  jetTreeReader::~jetTreeReader() {
+    delete fLeadVector;
+    delete fSubVector;
+  }
+  
+  bool jetTreeReader::Init( TTree* tree, bool dijet ) {
+    fTree = tree;
+    fDijet = dijet;
+    memset( &fEntry, 0, sizeof(fEntry) );
+    if ( !fTree )
+      return false;
+    
+    fLegacy = ( fTree->GetBranch( "leadPt" ) == 0 );
+    
+    if ( !fLegacy ) {
+      // vz, run and event ids are for bookkeeping, mixing does not read them
+      fTree->SetBranchStatus( "*", 0 );
+      const char* jetNames[] = { "Pt", "Eta", "Phi", "E" };
+      Float_t* leadValues[] = { &fEntry.lead.pt, &fEntry.lead.eta, &fEntry.lead.phi, &fEntry.lead.E };
+      Float_t* subValues[] = { &fEntry.sub.pt, &fEntry.sub.eta, &fEntry.sub.phi, &fEntry.sub.E };
+      for ( int i = 0; i < 4; ++i ) {
+        std::string leadName = std::string( "lead" ) + jetNames[i];
+        fTree->SetBranchStatus( leadName.c_str(), 1 );
+        fTree->SetBranchAddress( leadName.c_str(), leadValues[i] );
+        if ( fDijet ) {
+          std::string subName = std::string( "sub" ) + jetNames[i];
+          if ( !fTree->GetBranch( subName.c_str() ) ) {
+            __ERR( "jet tree has no " << subName << " branch" )
+            return false;
+          }
+          fTree->SetBranchStatus( subName.c_str(), 1 );
+          fTree->SetBranchAddress( subName.c_str(), subValues[i] );
+        }
+      }
+      fTree->SetBranchStatus( "vertexZBin", 1 );
+      fTree->SetBranchAddress( "vertexZBin", &fEntry.vertexZBin );
+      fTree->SetBranchStatus( "centralityBin", 1 );
+      fTree->SetBranchAddress( "centralityBin", &fEntry.centralityBin );
+      fTree->SetBranchStatus( "aj", 1 );
+      fTree->SetBranchAddress( "aj", &fEntry.aj );
+      return true;
+    }
+    
+    // compatibility: TLorentzVector branches
+    __OUT( "reading jet tree with TLorentzVector branches" )
+    if ( !fLeadVector ) fLeadVector = new TLorentzVector();
+    if ( !fSubVector ) fSubVector = new TLorentzVector();
+    if ( fDijet ) {
+      if ( !fTree->GetBranch( "leadJet" ) || !fTree->GetBranch( "subLeadJet" ) ) {
+        __ERR( "jet tree has neither flat nor TLorentzVector dijet branches" )
+        return false;
+      }
+      fTree->SetBranchAddress( "leadJet", &fLeadVector );
+      fTree->SetBranchAddress( "subLeadJet", &fSubVector );
+      fTree->SetBranchAddress( "aj", &fLegacyAj );
+    }
+    else {
+      if ( !fTree->GetBranch( "triggerJet" ) ) {
+        __ERR( "jet tree has neither flat nor TLorentzVector jet branches" )
+        return false;
+      }
+      fTree->SetBranchAddress( "triggerJet", &fLeadVector );
+    }
+    fTree->SetBranchAddress( "vertexZBin", &fEntry.vertexZBin );
+    // pp trees were written without centrality
+    if ( fTree->GetBranch( "centralityBin" ) )
+      fTree->SetBranchAddress( "centralityBin", &fEntry.centralityBin );
+    return true;
+  }
+  
+  bool jetTreeReader::GetEntry( Long64_t i ) {
+    if ( !fTree || fTree->GetEntry( i ) <= 0 )
+      return false;
+    if ( fLegacy ) {
+      fEntry.lead.pt = fLeadVector->Pt();
+      fEntry.lead.eta = fLeadVector->Eta();
+      fEntry.lead.phi = fLeadVector->Phi();
+      fEntry.lead.E = fLeadVector->E();
+      if ( fDijet ) {
+        fEntry.sub.pt = fSubVector->Pt();
+        fEntry.sub.eta = fSubVector->Eta();
+        fEntry.sub.phi = fSubVector->Phi();
+        fEntry.sub.E = fSubVector->E();
+        fEntry.aj = fLegacyAj;
+      }
+    }
+    return true;
+  }
+  
+  // --------------------------
+  // ------- Event Index ------
+  // --------------------------
+  
+  void BranchEventIndex( TTree* tree, eventIndexEntry& entry ) {
+    tree->Branch( "entry", &entry.entry, "entry/L" );
+    tree->Branch( "runId", &entry.runId, "runId/I" );
+    tree->Branch( "eventId", &entry.eventId, "eventId/I" );
+    tree->Branch( "vz", &entry.vz, "vz/F" );
+    tree->Branch( "vzBin", &entry.vzBin, "vzBin/I" );
+    tree->Branch( "gRefMult", &entry.gRefMult, "gRefMult/I" );
+    tree->Branch( "refCent", &entry.refCent, "refCent/I" );
+    tree->Branch( "maxTowerEt", &entry.maxTowerEt, "maxTowerEt/F" );
+    tree->Branch( "triggers", &entry.triggers, "triggers/I" );
+    tree->Branch( "hardPtSum", &entry.hardPtSum, "hardPtSum/F" );
+    tree->Branch( "maxCorrTowerEt", &entry.maxCorrTowerEt, "maxCorrTowerEt/F" );
+  }
+  
+  void FillEventIndex( TStarJetPicoReader & reader, eventIndexEntry& entry ) {
+    TStarJetPicoEvent* event = reader.GetEvent();
+    TStarJetPicoEventHeader* header = event->GetHeader();
+    
+    entry.entry = reader.GetNOfCurrentEvent();
+    entry.runId = header->GetRunId();
+    entry.eventId = header->GetEventId();
+    entry.vz = header->GetPrimaryVertexZ();
+    entry.vzBin = GetVzBin( entry.vz );
+    // same centrality definition as the drivers
+    if ( header->GetCorrectedGReferenceMultiplicity() ) {
+      entry.gRefMult = header->GetCorrectedGReferenceMultiplicity();
+      entry.refCent = header->GetGReferenceCentrality();
+    }
+    else {
+      entry.gRefMult = header->GetGReferenceMultiplicity();
+      entry.refCent = GetReferenceCentrality( entry.gRefMult );
+    }
+    
+    entry.triggers = 0;
+    std::vector<fastjet::PseudoJet> triggers;
+    GetTriggers( true, event->GetTrigObjs(), triggers );
+    if ( triggers.size() )
+      entry.triggers |= indexTriggerHT;
+    
+    // the software trigger looks at every tower of the event, so
+    // a cut on maxTowerEt selects the same events it would
+    entry.maxTowerEt = 0;
+    TClonesArray* towers = event->GetTowers();
+    for ( int i = 0; i < towers->GetEntriesFast(); ++i )
+      entry.maxTowerEt = std::max( entry.maxTowerEt, (Float_t) ( (TStarJetPicoTower*) towers->At(i) )->GetEt() );
+    
+    entry.maxCorrTowerEt = 0;
+    entry.hardPtSum = 0;
+    TStarJetVectorContainer<TStarJetVector>* container = reader.GetOutputContainer();
+    for ( int i = 0; i < container->GetEntries(); ++i ) {
+      TStarJetVector* sv = container->Get(i);
+      if ( sv->GetCharge() == 0 )
+        entry.maxCorrTowerEt = std::max( entry.maxCorrTowerEt, (Float_t) sv->Et() );
+      if ( sv->Pt() > hardTrackMinPt && fabs( sv->Eta() ) < maxTrackRap )
+        entry.hardPtSum += sv->Pt();
+    }
+    if ( entry.maxCorrTowerEt > triggerThreshold )
+      entry.triggers |= indexTriggerTower;
+  }
+  
+  bool SelectIndexedEntries( std::string indexFile, std::string cut, Long64_t chainEntries, Long64_t firstEntry, Long64_t lastEntry, std::vector<Long64_t>& entries ) {
+    entries.clear();
+    TFile file( indexFile.c_str(), "READ" );
+    TTree* tree = ( file.IsZombie() ? 0 : (TTree*) file.Get( "eventIndex" ) );
+    if ( !tree ) {
+      __ERR( "no eventIndex tree in " << indexFile )
+      return false;
+    }
+    // the title records the size of the chain the index was built from
+    Long64_t indexedEntries = atoll( tree->GetTitle() );
+    if ( indexedEntries != chainEntries ) {
+      __ERR( "index was built from " << indexedEntries << " entries, the chain has " << chainEntries )
+      return false;
+    }
+    
+    Long64_t entry = 0;
+    tree->SetBranchAddress( "entry", &entry );
+    TTreeFormula* formula = 0;
+    if ( cut.size() ) {
+      formula = new TTreeFormula( "indexCut", cut.c_str(), tree );
+      if ( formula->GetNdim() == 0 ) {
+        __ERR( "could not parse the index cut " << cut )
+        delete formula;
+        return false;
+      }
+    }
+    
+    for ( Long64_t i = 0; i < tree->GetEntries(); ++i ) {
+      tree->GetEntry( i );
+      if ( entry < firstEntry || entry >= lastEntry )
+        continue;
+      if ( formula ) {
+        formula->GetNdata();
+        if ( formula->EvalInstance() == 0 )
+          continue;
+      }
+      entries.push_back( entry );
+    }
+    delete formula;
+    
+    std::cout<<"Index selected "<< entries.size() <<" of "<< lastEntry - firstEntry <<" entries"<<std::endl;
+    return true;
+  }
+  
+  bool NextIndexedEvent( TStarJetPicoReader & reader, const std::vector<Long64_t>& entries, unsigned& position ) {
+    stageTimer timer( stageRead );
+    while ( position < entries.size() ) {
+      Long64_t current = entries[position++];
+      CountStage( stageRead );
+      if ( reader.ReadEvent( current ) )
+        return true;
+    }
+    return false;
+  }
+  
   // --------------------------
   // ------ Event Mixing ------
   // --------------------------
@@ -795,6 +1585,335 @@ namespace jetHadron {
     return true;
   }
   
+  // Pool-by-bin mixing distribution
+  // ---------------------------------------------------------------------
+  assocDistribution::assocDistribution( double cellSize ) : fCellSize( cellSize ), fNEvents( 0 ) {
+    fNEta = (int) ceil( 2.0 * maxTrackRap / fCellSize ) + 1;
+    fNPhi = (int) ceil( 2.0 * TMath::Pi() / fCellSize ) + 1;
+  }
+  
+  void assocDistribution::Clear() {
+    fNEvents = 0;
+    fCellIndex.clear();
+    fEta.clear();
+    fPhi.clear();
+    fPt.clear();
+    fWeight.clear();
+    fWeight2.clear();
+  }
+  
+  bool assocDistribution::Fill( fastjet::PseudoJet& assocTrack, double efficiency ) {
+    if ( !useTrack( assocTrack, efficiency ) )
+      return false;
+    
+    double eta = assocTrack.eta();
+    double phi = assocTrack.phi();
+    double pt = assocTrack.pt();
+    double weight = 1.0/efficiency;
+    
+    long etaCell = std::min( std::max( (int) floor( ( eta + maxTrackRap ) / fCellSize ), 0 ), fNEta - 1 );
+    long phiCell = std::min( std::max( (int) floor( phi / fCellSize ), 0 ), fNPhi - 1 );
+    long ptCell  = (long) floor( ( pt - ptLowEdge ) / ( ( ptHighEdge - ptLowEdge ) / binsPt ) );
+    long key = ( ptCell * fNPhi + phiCell ) * fNEta + etaCell;
+    
+    std::unordered_map<long, unsigned>::iterator found = fCellIndex.find( key );
+    if ( found == fCellIndex.end() ) {
+      fCellIndex[key] = fWeight.size();
+      fEta.push_back( eta );
+      fPhi.push_back( phi );
+      fPt.push_back( pt );
+      fWeight.push_back( weight );
+      fWeight2.push_back( weight*weight );
+      return true;
+    }
+    
+    // running weighted mean of the cell
+    unsigned i = found->second;
+    fWeight[i] += weight;
+    fWeight2[i] += weight*weight;
+    double fraction = weight / fWeight[i];
+    fEta[i] += fraction * ( eta - fEta[i] );
+    fPhi[i] += fraction * ( phi - fPhi[i] );
+    fPt[i]  += fraction * ( pt - fPt[i] );
+    return true;
+  }
+  
+  void assocDistribution::CorrelateLeading( int vzBin, int centBin, histograms* histogram, const fastjet::PseudoJet& leadJet, double aj, double nEventsToMix ) const {
+    Correlate( fillLead, vzBin, centBin, histogram, leadJet, aj, nEventsToMix );
+  }
+  
+  void assocDistribution::CorrelateSubleading( int vzBin, int centBin, histograms* histogram, const fastjet::PseudoJet& subJet, double aj, double nEventsToMix ) const {
+    Correlate( fillSub, vzBin, centBin, histogram, subJet, aj, nEventsToMix );
+  }
+  
+  void assocDistribution::CorrelateTrigger( int vzBin, int centBin, histograms* histogram, const fastjet::PseudoJet& triggerJet, double nEventsToMix ) const {
+    Correlate( fillTrigger, vzBin, centBin, histogram, triggerJet, 0.0, nEventsToMix );
+  }
+  
+  void assocDistribution::Correlate( fillType type, int vzBin, int centBin, histograms* histogram, const fastjet::PseudoJet& jet, double aj, double nEventsToMix ) const {
+    if ( fNEvents == 0 )
+      return;
+    
+    stageTimer timer( stageCorrelate );
+    
+    double jetEta = jet.eta();
+    double jetPhi = jet.phi();
+    double scale = nEventsToMix / fNEvents;
+    // a cell is filled once with the summed weight, but its
+    // error has to be that of the tracks filled one by one
+    double scale2 = scale * scale;
+    for ( unsigned i = 0; i < fWeight.size(); ++i ) {
+      // same convention as PseudoJet::delta_phi_to
+      double deltaEta = jetEta - fEta[i];
+      double deltaPhi = fPhi[i] - jetPhi;
+      if ( deltaPhi > TMath::Pi() )        deltaPhi -= TMath::TwoPi();
+      else if ( deltaPhi < -TMath::Pi() )  deltaPhi += TMath::TwoPi();
+      
+      switch ( type ) {
+        case fillLead:
+          histogram->FillCorrelationLead( deltaEta, deltaPhi, fPt[i], scale * fWeight[i], aj, vzBin, centBin, scale2 * fWeight2[i] );
+          break;
+        case fillSub:
+          histogram->FillCorrelationSub( deltaEta, deltaPhi, fPt[i], scale * fWeight[i], aj, vzBin, centBin, scale2 * fWeight2[i] );
+          break;
+        default:
+          histogram->FillCorrelation( deltaEta, deltaPhi, fPt[i], scale * fWeight[i], vzBin, centBin, scale2 * fWeight2[i] );
+          break;
+      }
+    }
+    CountStage( stageCorrelate, fWeight.size() );
+  }
+  
+  
+  // Stage profiling
+  // ---------------------------------------------------------------------
+  bool stageProfiling = false;
+  
+  namespace {
+    const char* stageNames[nAnalysisStages] = { "read", "convert", "hard cluster", "soft cluster", "background", "matching", "efficiency", "correlation" };
+    double   stageSeconds[nAnalysisStages] = { 0 };
+    Long64_t stageCalls[nAnalysisStages]   = { 0 };
+    Long64_t stageCounts[nAnalysisStages]  = { 0 };
+  }
+  
+  void EnableStageProfiling( bool enable ) {
+    stageProfiling = enable;
+  }
+  
+  void AddStageTime( analysisStage stage, double seconds ) {
+    stageSeconds[stage] += seconds;
+    stageCalls[stage]++;
+  }
+  
+  void AddStageCount( analysisStage stage, Long64_t n ) {
+    stageCounts[stage] += n;
+  }
+  
+  void PrintStageSummary() {
+    if ( !stageProfiling )
+      return;
+    
+    double total = 0;
+    for ( int i = 0; i < nAnalysisStages; ++i )
+      total += stageSeconds[i];
+    
+    std::cout<<"  -------------- STAGE PROFILE -------------- "<<std::endl;
+    for ( int i = 0; i < nAnalysisStages; ++i ) {
+      std::cout<<"  "<< stageNames[i] <<": "<< stageSeconds[i] <<" s ( "<< ( total > 0 ? 100.0 * stageSeconds[i] / total : 0 ) <<"% ), ";
+      std::cout<< stageCalls[i] <<" calls, "<< stageCounts[i] <<" objects";
+      if ( stageCounts[i] )
+        std::cout<<", "<< 1.0e6 * stageSeconds[i] / (double) stageCounts[i] <<" us per object";
+      std::cout<<std::endl;
+    }
+  }
+  
+  TH2D* StageProfileHistogram( std::string name ) {
+    TH2D* profile = new TH2D( name.c_str(), "stage profile;stage;", nAnalysisStages, -0.5, nAnalysisStages - 0.5, 3, -0.5, 2.5 );
+    profile->GetYaxis()->SetBinLabel( 1, "seconds" );
+    profile->GetYaxis()->SetBinLabel( 2, "calls" );
+    profile->GetYaxis()->SetBinLabel( 3, "objects" );
+    for ( int i = 0; i < nAnalysisStages; ++i ) {
+      profile->GetXaxis()->SetBinLabel( i+1, stageNames[i] );
+      profile->SetBinContent( i+1, 1, stageSeconds[i] );
+      profile->SetBinContent( i+1, 2, stageCalls[i] );
+      profile->SetBinContent( i+1, 3, stageCounts[i] );
+    }
+    return profile;
+  }
+  
+  // Used to pull optional flags out before
+  // the positional arguments are parsed
+  // ---------------------------------------------------------------------
+  bool PopFlag( int& argc, const char** argv, std::string flag ) {
+    bool found = false;
+    for ( int i = 1; i < argc; ) {
+      if ( flag == argv[i] ) {
+        for ( int j = i; j < argc - 1; ++j )
+          argv[j] = argv[j+1];
+        argc--;
+        found = true;
+      }
+      else
+        ++i;
+    }
+    return found;
+  }
+  
+  bool PopOption( int& argc, const char** argv, std::string name, std::string& value ) {
+    std::string prefix = name + "=";
+    bool found = false;
+    for ( int i = 1; i < argc; ) {
+      std::string argument = argv[i];
+      if ( argument.compare( 0, prefix.size(), prefix ) == 0 ) {
+        value = argument.substr( prefix.size() );
+        for ( int j = i; j < argc - 1; ++j )
+          argv[j] = argv[j+1];
+        argc--;
+        found = true;
+      }
+      else
+        ++i;
+    }
+    return found;
+  }
+  
+  // Memory reporting
+  // ---------------------------------------------------------------------
+  double PeakRSSBytes() {
+    struct rusage usage;
+    if ( getrusage( RUSAGE_SELF, &usage ) != 0 )
+      return 0;
+#ifdef __APPLE__
+    return (double) usage.ru_maxrss;            // bytes on OS X
+#else
+    return (double) usage.ru_maxrss * 1024.0;   // kilobytes on linux
+#endif
+  }
+  
+  void ReportMemory( std::string label, double bytes ) {
+    std::cout<<"  "<< label <<": "<< bytes / ( 1024.0 * 1024.0 ) <<" MB"<<std::endl;
+  }
+  
+  double HistogramBytes( TH1* hist ) {
+    if ( !hist )
+      return 0;
+    double contentSize = ( hist->InheritsFrom( "TArrayD" ) ? sizeof(double) : sizeof(float) );
+    return hist->IsA()->Size() + hist->GetNcells() * contentSize + hist->GetSumw2N() * sizeof(double);
+  }
+  
+  double ClusterSequenceBytes( double nParticles, double trackMaxEta, double jetRadius, bool withArea ) {
+    double nInputs = nParticles;
+    if ( withArea ) {
+      double ghostMaxRap = ( trackMaxEta - jetRadius ) + 2.0*jetRadius;
+      nInputs += ghostRepeat * 2.0 * ghostMaxRap * 2.0 * pi / ghostArea;
+    }
+    // clustering keeps ~2n pseudojets and ~2n history entries,
+    // and the output jets are copied once more
+    return nInputs * ( 3.0 * sizeof(fastjet::PseudoJet) + 2.0 * sizeof(fastjet::ClusterSequence::history_element) );
+  }
+  
+  double MixingPoolBytes( std::vector<std::vector<std::vector<unsigned> > >& pool ) {
+    double bytes = 0;
+    for ( unsigned i = 0; i < pool.size(); ++i )
+      for ( unsigned j = 0; j < pool[i].size(); ++j )
+        bytes += sizeof( pool[i][j] ) + pool[i][j].capacity() * sizeof(unsigned);
+    return bytes;
+  }
+  
+  double ReportProjectedMemory( std::string analysisType, unsigned binsEta, unsigned binsPhi, double jetRadius, bool withArea, double extraBytes ) {
+    double baseBytes    = PeakRSSBytes();
+    double histBytes    = histograms::ProjectedBytes( analysisType, binsEta, binsPhi );
+    double clusterBytes = ClusterSequenceBytes( maxEventParticles, maxTrackRap, jetRadius, withArea );
+    double total = baseBytes + histBytes + clusterBytes + extraBytes;
+    
+    std::cout<<"  -------------- MEMORY PROJECTION -------------- "<<std::endl;
+    ReportMemory( "libraries and setup", baseBytes );
+    ReportMemory( "correlation histograms ( " + analysisType + " )", histBytes );
+    ReportMemory( "clustering ( central event )", clusterBytes );
+    if ( extraBytes > 0 )
+      ReportMemory( "other", extraBytes );
+    ReportMemory( "total", total );
+    std::cout<<"projected_memory_mb "<< (long) ceil( total / ( 1024.0 * 1024.0 ) ) <<std::endl;
+    return total;
+  }
+  
+  // Output
+  // ---------------------------------------------------------------------
+  int ParseCompression( std::string setting ) {
+    std::string algorithm = setting;
+    int level = -1;
+    std::size_t split = setting.find( ':' );
+    if ( split != std::string::npos ) {
+      algorithm = setting.substr( 0, split );
+      level = atoi( setting.substr( split + 1 ).c_str() );
+    }
+    
+    int algorithmCode = -1;
+    int defaultLevel = 1;
+    if ( algorithm == "zlib" )      { algorithmCode = 1; defaultLevel = 1; }
+    else if ( algorithm == "lzma" ) { algorithmCode = 2; defaultLevel = 4; }
+    else if ( algorithm == "lz4" )  { algorithmCode = 4; defaultLevel = 4; }
+    else if ( algorithm == "zstd" ) { algorithmCode = 5; defaultLevel = 5; }
+    else if ( algorithm == "none" ) { return 0; }
+    else { __ERR( "Unknown compression algorithm: " << algorithm << " ( zlib, lzma, lz4, zstd or none )" ) return -1; }
+    
+    if ( split == std::string::npos )
+      level = defaultLevel;
+    if ( level < 1 || level > 9 ) {
+      __ERR( "Compression level must be 1-9: " << setting )
+      return -1;
+    }
+    return 100 * algorithmCode + level;
+  }
+  
+  // Each worker writes every nThreads'th object into its own in-memory
+  // file, and hands the buffer to the merger every flushEvery objects
+  static void WriteObjectStride( TBufferMergerType* merger, std::vector<TObject*>* objects, unsigned first, unsigned stride ) {
+    const unsigned flushEvery = 100;
+    auto file = merger->GetFile();
+    unsigned nWritten = 0;
+    for ( unsigned i = first; i < objects->size(); i += stride ) {
+      file->WriteTObject( objects->at(i) );
+      if ( ++nWritten % flushEvery == 0 )
+        file->Write();
+    }
+    file->Write();
+  }
+  
+  int WriteObjects( std::string fileName, std::vector<TObject*>& objects, int compression, unsigned nThreads ) {
+    if ( nThreads <= 1 ) {
+      TFile out( fileName.c_str(), "RECREATE", "", compression );
+      if ( out.IsZombie() ) {
+        __ERR( "Could not create " << fileName )
+        return -1;
+      }
+      for ( unsigned i = 0; i < objects.size(); ++i )
+        out.WriteTObject( objects[i] );
+      out.Close();
+      return objects.size();
+    }
+    
+    ROOT::EnableThreadSafety();
+    nThreads = std::min( nThreads, (unsigned) std::max( (std::size_t) 1, objects.size() ) );
+    {
+      // the merger closes the output file when it goes out of scope,
+      // after the last buffer has been merged
+      TBufferMergerType merger( fileName.c_str(), "RECREATE", compression );
+      std::vector<std::thread> workers;
+      for ( unsigned i = 0; i < nThreads; ++i )
+        workers.push_back( std::thread( WriteObjectStride, &merger, &objects, i, nThreads ) );
+      for ( unsigned i = 0; i < workers.size(); ++i )
+        workers[i].join();
+    }
+    
+    // the merger does not report failures, so check the file
+    TFile check( fileName.c_str(), "READ" );
+    if ( check.IsZombie() ) {
+      __ERR( "Could not create " << fileName )
+      return -1;
+    }
+    return objects.size();
+  }
   
 } // end namespace
 
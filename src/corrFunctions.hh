@@ -14,6 +14,8 @@
 #include <string>
 #include <limits.h>
 #include <unistd.h>
+#include <chrono>
+#include <unordered_map>
 
 // fastjet 3
 #include "fastjet/PseudoJet.hh"
@@ -42,7 +44,9 @@
 #include "TLorentzVector.h"
 #include "TClonesArray.h"
 #include "TChain.h"
+#include "TTree.h"
 #include "TBranch.h"
+#include "TTreeFormula.h"
 #include "TMath.h"
 #include "TRandom.h"
 #include "TCanvas.h"
@@ -74,6 +78,28 @@ namespace jetHadron {
   // For correlation functions
   class histograms;
   
+  // Analysis modes: parsed once from the analysisType string
+  // ( dijet, ppjet, dijetmix... ) so the event loops test bits,
+  // not strings
+  enum analysisFlag { flagDijet = 1, flagPP = 2, flagMix = 4, flagUnknown = 8 };
+  enum analysisMode {
+    modeJet       = 0,
+    modeDijet     = flagDijet,
+    modePPJet     = flagPP,
+    modePPDijet   = flagPP | flagDijet,
+    modeJetMix    = flagMix,
+    modeDijetMix  = flagMix | flagDijet,
+    modePPJetMix  = flagMix | flagPP,
+    modePPDijetMix= flagMix | flagPP | flagDijet,
+    modeUnknown   = flagUnknown
+  };
+  
+  // Returns modeUnknown for anything that is not a valid analysis type
+  analysisMode GetAnalysisMode( std::string analysisType );
+  inline bool IsDijetMode( analysisMode mode )  { return mode & flagDijet; }
+  inline bool IsPPMode( analysisMode mode )     { return mode & flagPP; }
+  inline bool IsMixMode( analysisMode mode )    { return mode & flagMix; }
+  
 	// IO/OS MANIP Functions
   
 	// Helper to build the TChain, used to decide which input format
@@ -109,6 +135,33 @@ namespace jetHadron {
   // Returns -1 if Vz outside of accepted range
   int GetVzBin( double Vz );
   
+  // Uniform binning helpers: the index is computed arithmetically, then
+  // moved by at most one bin so values on an edge land exactly where a
+  // scan over the edges puts them. The result is clamped to [ 0, nBins ),
+  // and NaN also lands where the scan puts it. Checked by test_binning
+  // Bins ( low + w*i, low + w*(i+1) ] - as used for Vz. NaN is bin 0
+  inline int UniformBinUpperClosed( double value, double lowEdge, double width, int nBins ) {
+    double position = ( value - lowEdge ) / width;
+    int bin = ( position > 0 ? ( position < nBins ? (int) position : nBins - 1 ) : 0 );
+    if ( bin > 0 && !( value > lowEdge + width*bin ) )
+      --bin;
+    else if ( bin < nBins - 1 && value > lowEdge + width*(bin+1) )
+      ++bin;
+    return bin;
+  }
+  // Bins [ low + w*i, low + w*(i+1) ) - as used for Aj. NaN is the last bin
+  inline int UniformBinLowerClosed( double value, double lowEdge, double width, int nBins ) {
+    if ( value != value )
+      return nBins - 1;
+    double position = ( value - lowEdge ) / width;
+    int bin = ( position > 0 ? ( position < nBins ? (int) position : nBins - 1 ) : 0 );
+    if ( bin > 0 && value < lowEdge + width*bin )
+      --bin;
+    else if ( bin < nBins - 1 && !( value < lowEdge + width*(bin+1) ) )
+      ++bin;
+    return bin;
+  }
+  
   // Converts TStarJetPicoVectors into PseudoJets
   void ConvertTStarJetVector( TStarJetVectorContainer<TStarJetVector>* container, std::vector<fastjet::PseudoJet> & particles, bool ClearVector = true, double towerScale = 1.0 );
   // applies an effective 90% relative efficiency compared to auau
@@ -122,7 +175,59 @@ namespace jetHadron {
   void GetTriggers( bool requireTrigger, TClonesArray* triggerObjs, std::vector<fastjet::PseudoJet> & triggers );
   
   // For the pp data where the trigger objects dont seem to be working
-  void GetTriggersPP( bool requireTrigger, std::vector<fastjet::PseudoJet> ppParticles, std::vector<fastjet::PseudoJet>& triggers );
+  void GetTriggersPP( bool requireTrigger, const std::vector<fastjet::PseudoJet>& ppParticles, std::vector<fastjet::PseudoJet>& triggers );
+  
+  // Rapidity-phi grid of the event's triggers, filled once per event.
+  // Cells are at least cellSize wide, so a query only looks at
+  // the neighbouring cells instead of every trigger
+  class triggerIndex {
+  public:
+    triggerIndex( double cellSize = 0.4, double maxRap = 1.0 );
+    
+    // replaces the triggers in the grid - keeps the cell storage
+    void Fill( const std::vector<fastjet::PseudoJet>& triggers );
+    
+    // Lowest index of a trigger within radius of the jet, or -1:
+    // delta_R < radius, or squared_distance <= radius^2 if inclusive
+    // ( the SelectorCircle definition )
+    int FirstWithin( const fastjet::PseudoJet& jet, double radius, bool inclusive = false ) const;
+    bool AnyWithin( const fastjet::PseudoJet& jet, double radius ) const { return FirstWithin( jet, radius ) >= 0; }
+    
+    const std::vector<fastjet::PseudoJet>& GetTriggers() const { return fTriggers; }
+    
+  private:
+    int RapCell( double rap ) const;
+    int PhiCell( double phi ) const;
+    
+    double fRapLow, fRapWidth, fPhiWidth;
+    int fNRap, fNPhi;
+    std::vector<fastjet::PseudoJet> fTriggers;
+    std::vector<std::vector<int> > fCells;     // trigger indices, [ rap * fNPhi + phi ]
+  };
+  
+  // Region of interest hard clustering: only the hard constituents within
+  // roiRadius of a trigger are kept, and for dijets also the away side
+  // half plane of every trigger. roiRadius is the trigger match distance
+  // plus roiGuardRadii * R, so a trigger matched anti-kt jet and everything
+  // it competes with in the clustering are inside the region.
+  // outsidePt is the scalar pt sum of the constituents left out, edgePt
+  // that of the ones left out within jetRadius of the region
+  double RegionOfInterestRadius( double matchDistance, double jetRadius );
+  std::vector<fastjet::PseudoJet> SelectRegionOfInterest( std::string analysisType, const std::vector<fastjet::PseudoJet>& constituents, const triggerIndex& triggers, double roiRadius, double jetRadius, double& outsidePt, double& edgePt );
+  
+  // Decided before clustering, so the drivers cluster either the region
+  // or the whole event, once. The region gives the hard jets the analysis
+  // would get from the whole event when
+  // - nothing left out is within R of the region ( edgePt == 0 ): anti-kt
+  //   only merges pairs closer than R, so no jet takes constituents from
+  //   both sides, and the jets of the region are those of the whole event.
+  //   The guard band keeps this true unless hard constituents sit near its edge
+  // - for dijets, outsidePt < subJetPtMin: a jet of left out constituents has
+  //   at most outsidePt, so it is below the subleading cut, and can only be
+  //   among the two leading jets when the region's dijet fails the cuts too.
+  //   A single jet analysis only keeps trigger matched jets, and a jet of
+  //   left out constituents is too far from every trigger to be matched
+  bool RegionOfInterestExact( std::string analysisType, double outsidePt, double edgePt, double subJetPtMin );
 	
 	// Summary of initial settings for dijet-hadron correlation
 	void BeginSummaryDijet ( double jetRadius, double leadJetPtMin, double subLeadJetPtMin, double jetMaxPt, double hardJetConstPt, double softJetConstPt, int nVzBins, double VzRange, std::string dijetFile, std::string corrFile );
@@ -141,6 +246,49 @@ namespace jetHadron {
   // Collision Type is 'AuAu' or 'pp'
   void InitReader( TStarJetPicoReader & reader, TChain* chain, std::string collisionType, std::string triggerString, double softwareTrigger, int nEvents );
   
+  // The event cuts part of InitReader, shared with the picoDecoder
+  void InitEventCuts( TStarJetPicoEventCuts* evCuts, std::string collisionType, std::string triggerString, double softwareTrigger );
+  
+  // Input manifests: a .list can have a .list.manifest next to it, written
+  // by make_manifest, with one "path entries bytes modtime checksum" line
+  // per file. Chains built with it pass the entry counts to TChain::Add,
+  // so the files are not all opened just to count their entries
+  struct manifestEntry {
+    std::string path;
+    Long64_t    entries;
+    Long64_t    bytes;
+    Long_t      modtime;      // as given by gSystem->GetPathInfo, -1 if unknown
+    std::string checksum;     // md5 of the file
+  };
+  
+  std::string ManifestPath( std::string listFile );
+  // the files of a list, skipping empty and # lines
+  std::vector<std::string> ReadFileList( std::string listFile );
+  // manifests written before the modtime column are read with modtime -1,
+  // so none of their entries is current until make_manifest refreshes them
+  bool ReadManifest( std::string manifestFile, std::vector<manifestEntry>& manifest );
+  bool WriteManifest( std::string manifestFile, std::string listFile, const std::vector<manifestEntry>& manifest );
+  // True if the file still has the size and modification time of the entry
+  bool ManifestEntryCurrent( const manifestEntry& entry );
+  // md5 of the checksums of every file of the list, in order, from its
+  // manifest - empty if there is none, or any of its entries is not current
+  std::string ManifestDigest( std::string listFile );
+  
+  // Replaces TStarJetPicoUtils::BuildChainFromFileList: files in the
+  // manifest whose size and modification time are unchanged are added
+  // with their entry count, anything else is added normally ( and opened by ROOT )
+  TChain* BuildChainFromList( std::string listFile, std::string chainName = "JetTree" );
+  
+  // Used to split a chain between several jobs - the range string can be
+  // 'all', 'first:n' ( n = -1 runs to the end of the chain ) or
+  // 'shard/nShards', which splits the chain into nShards equal pieces
+  // Returns false if the string could not be parsed
+  bool GetEntryRange( std::string rangeString, Long64_t chainEntries, Long64_t& firstEntry, Long64_t& lastEntry );
+  
+  // Replaces reader.NextEvent() when running over an entry range:
+  // reads entries until one passes the event cuts, or lastEntry is reached
+  bool NextEventInRange( TStarJetPicoReader & reader, Long64_t& entry, Long64_t lastEntry );
+  
   // Use this to decide if there are 2 dijets for dijet analysis in the proper pt ranges
   // Or for jet analysis if there is a single jet
   bool CheckHardCandidateJets( std::string analysisType, std::vector<fastjet::PseudoJet> & HiResult, double leadJetPtMin, double subJetPtMin );
@@ -153,9 +301,10 @@ namespace jetHadron {
   // hardJets: jet(s) corresponding to analysisType
   // LoResult: the jets from clustering with the whole event
   // requireTrigger: whether or not the jets need to be matched to a trigger
-  // triggers: the list of triggers
+  // triggers: the list of triggers, or the event's filled triggerIndex
   // jetRadius: radius used for clustering
   std::vector<fastjet::PseudoJet> BuildMatchedJets( std::string analysisType, std::vector<fastjet::PseudoJet> & hardJets, std::vector<fastjet::PseudoJet> & LoResult, bool requireTrigger, std::vector<fastjet::PseudoJet> & triggers, double jetRadius = 0.4 );
+  std::vector<fastjet::PseudoJet> BuildMatchedJets( std::string analysisType, std::vector<fastjet::PseudoJet> & hardJets, std::vector<fastjet::PseudoJet> & LoResult, bool requireTrigger, const triggerIndex & triggers, double jetRadius = 0.4 );
   
   // Finally, correlation function -
   // It correlates leading and subleading jets
@@ -167,13 +316,13 @@ namespace jetHadron {
   bool useTrack( fastjet::PseudoJet& assocTrack, double efficiency );
   
   // Correlate Leading
-  bool correlateLeading( std::string analysisType, int vzBin, int centBin, histograms* histogram, fastjet::PseudoJet& leadJet, fastjet::PseudoJet& assocTrack, double efficiency, double aj );
+  bool correlateLeading( analysisMode mode, int vzBin, int centBin, histograms* histogram, fastjet::PseudoJet& leadJet, fastjet::PseudoJet& assocTrack, double efficiency, double aj );
   
   // Correlate Subleading
-  bool correlateSubleading( std::string analysisType, int vzBin, int centBin, histograms* histogram, fastjet::PseudoJet& subJet, fastjet::PseudoJet& assocTrack, double efficiency, double aj );
+  bool correlateSubleading( analysisMode mode, int vzBin, int centBin, histograms* histogram, fastjet::PseudoJet& subJet, fastjet::PseudoJet& assocTrack, double efficiency, double aj );
   
   // Correlate for jet-hadron
-  bool correlateTrigger( std::string analysisType, int vzBin, int centBin, histograms* histogram, fastjet::PseudoJet& triggerJet, fastjet::PseudoJet& assocTrack, double efficiency );
+  bool correlateTrigger( analysisMode mode, int vzBin, int centBin, histograms* histogram, fastjet::PseudoJet& triggerJet, fastjet::PseudoJet& assocTrack, double efficiency );
 	
 	// FastJet functionality
 	
@@ -198,6 +347,163 @@ namespace jetHadron {
   // Definition for the area estimation
   fastjet::AreaDefinition  AreaDefinition( fastjet::GhostedAreaSpec ghostAreaSpec );
   
+  // --------------------------
+  // ---- Strategy Tuning -----
+  // --------------------------
+  
+  // FastJet picks its clustering strategy from the multiplicity with a
+  // generic rule. The tuner times N2Plain, N2Tiled, N2MinHeapTiled and
+  // NlnN for one jet definition on synthetic events over a ladder of
+  // multiplicities, on this machine, and each clustering call then uses
+  // the fastest strategy for its input size ( see TunedDefinition )
+  class strategyTuner {
+    
+  public:
+    strategyTuner( const fastjet::JetDefinition& jetDef );
+    
+    // times every strategy at every multiplicity, for at least
+    // minSeconds per point. Strategies that fastjet can not run
+    // ( NlnN without CGAL ) are skipped
+    void Calibrate( double minSeconds = 0.05 );
+    
+    // reads the lines of a profile written for the same algorithm and R
+    bool Load( std::string profileFile );
+    void Save( std::ostream& out ) const;
+    
+    bool Matches( const fastjet::JetDefinition& jetDef ) const;
+    fastjet::Strategy Best( unsigned nInputs ) const;
+    
+    const fastjet::JetDefinition& Definition() const    { return fJetDef; }
+    const std::vector<unsigned>& Multiplicities() const { return fMultiplicities; }
+    // seconds per clustering, negative if the strategy was not run
+    double Seconds( unsigned strategy, unsigned point ) const { return fSeconds[point][strategy]; }
+    
+    static unsigned NStrategies();
+    static fastjet::Strategy GetStrategy( unsigned strategy );
+    static std::string StrategyName( unsigned strategy );
+    
+  private:
+    fastjet::JetDefinition fJetDef;
+    std::vector<unsigned> fMultiplicities;
+    std::vector<std::vector<double> > fSeconds;
+    std::vector<unsigned> fBest;
+    bool fCalibrated;
+  };
+  
+  // Sets up a tuner for each definition: loaded from the profile if it has
+  // one, otherwise calibrated now and the profile ( re )written. An empty
+  // file name calibrates without saving, recalibrate ignores the profile
+  bool InitStrategyTuning( std::string profileFile, const std::vector<fastjet::JetDefinition>& definitions, bool recalibrate = false );
+  const std::vector<strategyTuner*>& GetStrategyTuners();
+  
+  // The definition with the tuned strategy for nInputs, or jetDef
+  // unchanged when no tuner was set up for it
+  fastjet::JetDefinition TunedDefinition( const fastjet::JetDefinition& jetDef, unsigned nInputs );
+  
+  // the number of ghosts an area clustering adds to the particles
+  unsigned GhostCount( const fastjet::AreaDefinition& areaDef );
+  
+  // --------------------------
+  // -------- Jet Trees -------
+  // --------------------------
+  
+  // The jet/dijet trees written by the correlation drivers and read by
+  // event mixing are flat: four floats per jet, plus the event variables,
+  // so reading an entry is a copy, not a TLorentzVector deserialization
+  struct jetTreeJet {
+    Float_t pt, eta, phi, E;
+  };
+  
+  struct jetTreeEntry {
+    jetTreeJet lead;        // leading jet ( or trigger jet )
+    jetTreeJet sub;         // subleading jet, dijet trees only
+    Float_t vz;
+    Int_t   vertexZBin;
+    Int_t   centralityBin;
+    Float_t aj;
+    Int_t   runId;
+    Int_t   eventId;
+  };
+  
+  // Creates the flat branches on a new tree. Dijet trees get
+  // subPt/subEta/subPhi/subE as well as leadPt/leadEta/leadPhi/leadE
+  void BranchJetTree( TTree* tree, jetTreeEntry& entry, bool dijet );
+  
+  // Copies a jet into the tree entry, and back
+  void SetTreeJet( jetTreeJet& treeJet, const fastjet::PseudoJet& jet );
+  fastjet::PseudoJet TreeJetToPseudoJet( const jetTreeJet& treeJet );
+  
+  // Reads either layout: the flat branches, or the older trees that
+  // stored TLorentzVector objects ( leadJet, subLeadJet, triggerJet ),
+  // which have no vz, run or event ids - those are left at zero
+  class jetTreeReader {
+    
+  public:
+    jetTreeReader();
+    ~jetTreeReader();
+    
+    // Sets the branch addresses, and turns off the branches event
+    // mixing does not use. Returns false if the jet branches are missing
+    bool Init( TTree* tree, bool dijet );
+    
+    // Reads entry i into Entry()
+    bool GetEntry( Long64_t i );
+    
+    const jetTreeEntry& Entry() const { return fEntry; }
+    bool IsLegacy() const             { return fLegacy; }
+    
+  private:
+    TTree* fTree;
+    bool fDijet;
+    bool fLegacy;
+    jetTreeEntry fEntry;
+    
+    // only used for the compatibility layout
+    TLorentzVector* fLeadVector;
+    TLorentzVector* fSubVector;
+    Double_t fLegacyAj;
+  };
+  
+  // --------------------------
+  // ------- Event Index ------
+  // --------------------------
+  
+  // build_index scans a data set once and records, for every chain entry
+  // that passes the reader's event cuts, the variables the drivers select
+  // on. The drivers then read only the entries passing a cut expression
+  // on the index ( ie "refCent>=6 && vzBin>=0 && maxTowerEt>6", which
+  // is the default software trigger of the drivers )
+  enum indexTriggerFlag { indexTriggerHT = 1, indexTriggerTower = 2 };
+  
+  struct eventIndexEntry {
+    Long64_t entry;         // chain entry
+    Int_t    runId;
+    Int_t    eventId;
+    Float_t  vz;
+    Int_t    vzBin;         // -1 outside the accepted range
+    Int_t    gRefMult;
+    Int_t    refCent;
+    Float_t  maxTowerEt;    // raw tower Et, before tower cuts and the hadronic correction -
+                            // what the software trigger ( SetMinEventEtCut ) cuts on
+    Int_t    triggers;      // indexTriggerFlag bits: HT trigger object, corrected tower above triggerThreshold
+    Float_t  hardPtSum;     // sum of pt > hardTrackMinPt constituents in |eta| < maxTrackRap
+    Float_t  maxCorrTowerEt; // after the hadronic correction, as the analysis ( GetTriggersPP ) sees it
+  };
+  
+  void BranchEventIndex( TTree* tree, eventIndexEntry& entry );
+  
+  // Fills the entry from the reader's current event
+  void FillEventIndex( TStarJetPicoReader & reader, eventIndexEntry& entry );
+  
+  // The chain entries in [firstEntry, lastEntry) passing cut, in order.
+  // Returns false if the index can not be read, or was built from a
+  // chain with a different number of entries
+  bool SelectIndexedEntries( std::string indexFile, std::string cut, Long64_t chainEntries, Long64_t firstEntry, Long64_t lastEntry, std::vector<Long64_t>& entries );
+  
+  // Replaces NextEventInRange when running from an index: seeks
+  // directly to each selected entry, and re-applies the reader's cuts
+  bool NextIndexedEvent( TStarJetPicoReader & reader, const std::vector<Long64_t>& entries, unsigned& position );
+  
   // --------------------------
   // ------ Event Mixing ------
   // --------------------------
@@ -214,6 +520,146 @@ namespace jetHadron {
   // In mixing or not - logic depends on analysis type
   bool UseEventInMixing( std::string analysisType, bool isMB, std::vector<fastjet::PseudoJet>& highPtConsJets, int refMult, int vzBin );
   
+  // Inclusive associated track distribution of the mixing events in one
+  // vz/centrality bin, for pool-by-bin mixing: the bin's events are read
+  // once, and every trigger in the bin is correlated with the distribution
+  // instead of with nEventsToMix re-read events. Tracks are merged into
+  // eta/phi cells ( much smaller than the correlation bins ) and correlation
+  // pt bins, and each cell keeps the weighted mean position of its tracks
+  class assocDistribution {
+    
+  public:
+    assocDistribution( double cellSize = 0.05 );
+    
+    void Clear();
+    
+    // Adds a track of the current event with weight 1/efficiency,
+    // using the same track cuts as the correlate functions
+    bool Fill( fastjet::PseudoJet& assocTrack, double efficiency );
+    
+    // Call once for every event added to the distribution
+    void CountEvent()         { fNEvents++; }
+    unsigned GetNEvents() const { return fNEvents; }
+    unsigned GetNCells() const  { return fWeight.size(); }
+    
+    // Fill the correlations of one trigger, normalized as if
+    // nEventsToMix events of the bin had been mixed with it
+    void CorrelateLeading( int vzBin, int centBin, histograms* histogram, const fastjet::PseudoJet& leadJet, double aj, double nEventsToMix ) const;
+    void CorrelateSubleading( int vzBin, int centBin, histograms* histogram, const fastjet::PseudoJet& subJet, double aj, double nEventsToMix ) const;
+    void CorrelateTrigger( int vzBin, int centBin, histograms* histogram, const fastjet::PseudoJet& triggerJet, double nEventsToMix ) const;
+    
+  private:
+    enum fillType { fillTrigger, fillLead, fillSub };
+    void Correlate( fillType type, int vzBin, int centBin, histograms* histogram, const fastjet::PseudoJet& jet, double aj, double nEventsToMix ) const;
+    
+    double fCellSize;
+    int fNEta, fNPhi;
+    unsigned fNEvents;
+    std::unordered_map<long, unsigned> fCellIndex;
+    std::vector<double> fEta, fPhi, fPt, fWeight;
+    std::vector<double> fWeight2;     // sum of the squared track weights of a cell, for the bin errors
+  };
+  
+  // --------------------------
+  // ---- Stage Profiling -----
+  // --------------------------
+  
+  // Stages of the event loop that are timed
+  enum analysisStage { stageRead = 0, stageConvert, stageHardCluster, stageSoftCluster, stageBackground, stageMatch, stageEfficiency, stageCorrelate, nAnalysisStages };
+  
+  // Profiling is off by default - then a stageTimer
+  // or CountStage only costs a check of this flag
+  extern bool stageProfiling;
+  void EnableStageProfiling( bool enable = true );
+  
+  // Accumulates time and calls for a stage, and the number
+  // of objects it handled ( entries, particles, jets, pairs )
+  void AddStageTime( analysisStage stage, double seconds );
+  void AddStageCount( analysisStage stage, Long64_t n );
+  inline void CountStage( analysisStage stage, Long64_t n = 1 ) { if ( stageProfiling ) AddStageCount( stage, n ); }
+  
+  // Per job totals: printed at the end of the end summaries, and
+  // written to the output as a TH2D - stage vs seconds/calls/counts,
+  // so it adds up correctly when the job outputs are merged
+  void PrintStageSummary();
+  TH2D* StageProfileHistogram( std::string name = "stage_profile" );
+  
+  // Scoped timer: adds the time from construction to
+  // destruction ( or Stop() ) to its stage
+  class stageTimer {
+  public:
+    stageTimer( analysisStage stage ) : fStage( stage ), fRunning( stageProfiling ) {
+      if ( fRunning )
+        fStart = std::chrono::steady_clock::now();
+    }
+    ~stageTimer() { Stop(); }
+    
+    void Stop() {
+      if ( !fRunning )
+        return;
+      fRunning = false;
+      AddStageTime( fStage, std::chrono::duration<double>( std::chrono::steady_clock::now() - fStart ).count() );
+    }
+    
+  private:
+    analysisStage fStage;
+    bool fRunning;
+    std::chrono::steady_clock::time_point fStart;
+  };
+  
+  // Removes a flag ( ie --profile ) from the command line if it is
+  // present, so the positional arguments and argc are unchanged
+  bool PopFlag( int& argc, const char** argv, std::string flag );
+  
+  // Same for an option given as --name=value. Returns false and
+  // leaves value untouched if the option is not present
+  bool PopOption( int& argc, const char** argv, std::string name, std::string& value );
+  
+  // --------------------------
+  // ---- Memory Reporting ----
+  // --------------------------
+  
+  // Peak resident set size of the job so far, in bytes
+  double PeakRSSBytes();
+  
+  // Prints "label: X MB" - used for the startup and end of job
+  // reports, and the --dry-run projections read by the submit scripts
+  void ReportMemory( std::string label, double bytes );
+  
+  // Bytes held by one histogram: bin contents, plus Sumw2 if it is set
+  double HistogramBytes( TH1* hist );
+  
+  // Estimate of the memory used by one clustering of nParticles:
+  // pseudojets and history, including the explicit ghosts if withArea
+  double ClusterSequenceBytes( double nParticles, double trackMaxEta, double jetRadius, bool withArea );
+  
+  // Bytes held by the event mixing pool of event IDs ( [vz][cent] )
+  double MixingPoolBytes( std::vector<std::vector<std::vector<unsigned> > >& pool );
+  
+  // Prints the projected memory of a job with these settings, at startup
+  // and for --dry-run. extraBytes covers driver specific structures
+  // ( ie the mixing pool ). The last line, "projected_memory_mb N",
+  // is what the submit scripts read. Returns the total in bytes
+  double ReportProjectedMemory( std::string analysisType, unsigned binsEta, unsigned binsPhi, double jetRadius, bool withArea, double extraBytes = 0 );
+  
+  // --------------------------
+  // --------- Output ---------
+  // --------------------------
+  
+  // Parses a compression setting "algorithm:level", with algorithm
+  // one of zlib, lzma, lz4, zstd, into ROOT's 100*algorithm + level.
+  // lz4 is meant for intermediate files ( per job output that is merged ),
+  // zstd for the final ones. Returns -1 if it is not understood
+  int ParseCompression( std::string setting );
+  
+  // Writes each object as its own key, under its own name, into a new
+  // file - the same layout as calling Write() on each of them. With
+  // nThreads > 1 the objects are split between threads that serialize
+  // and compress them into their own TBufferMerger buffers, which are
+  // merged into the output file. Returns the number of objects written,
+  // or -1 if the file could not be created
+  int WriteObjects( std::string fileName, std::vector<TObject*>& objects, int compression, unsigned nThreads = 1 );
+  
 }
 
 #endif
@@ -8,8 +8,9 @@
 #ifndef CORRPARAMETERS_HH
 #define CORRPARAMETERS_HH
 
-#define __ERR(message) {std::cerr << "[" << __FILE__ << "::" << __func__ << "()] -- ERR: " << message << std::endl;}
-#define __OUT(message) {std::cout << "[" << __FILE__ << "::" << __func__ << "()] -- OUT: " << message << std::endl;}
+// __OUT, __ERR ( and __WARN, __DBG ) are buffered
+// and rate limited per call site, see logging.hh
+#include "logging.hh"
 
 namespace jetHadron {
 	
@@ -125,12 +126,20 @@ namespace jetHadron {
   
   // dijet analysis requires jets to be back to back
   const double jetDPhiCut 	= 0.4;				// require jets to be pi - 0.4 away in phi
+  
+  // region of interest hard clustering ( --roi ): constituents further
+  // than the trigger match distance plus this guard band are not clustered
+  const double roiGuardRadii = 2.0;     // guard band in units of the jet radius
 	
 	// Variables for the area definition
 	// Ghosts, etc
 	const int ghostRepeat = 1;
 	const double ghostArea = 0.01;
 	
+	// Upper estimate of the particles in a central AuAu event,
+	// only used to project the memory of the clustering
+	const double maxEventParticles = 2500;
+	
 	
 	// Associated efficiency information
 	// ----------------------------
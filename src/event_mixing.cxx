@@ -118,6 +118,77 @@ namespace patch {
 // [5]: Total number of events to consider in mixing data set
 // [6]: Number of events to mix with each trigger
 // [7]: the mixing data list
+// [8]: ( optional ) entry range of the jet tree to mix: all, first:n
+//      or shard/nShards - used to split large trees between jobs
+// optional: --mix-mode=explicit ( default ): each trigger is mixed with
+//           nEventsToMix randomly chosen events of its vz/centrality bin
+//           --mix-mode=pool: each bin's events are read once into an
+//           inclusive associated distribution, which every trigger in
+//           the bin is correlated with ( same normalization )
+//           --mix-mode=validate: runs both, writes the explicit output
+//           and compares the two cell by cell
+
+namespace {
+  
+  // Compares the dEta-dPhi distributions of every correlation histogram
+  // of the explicit and pool-by-bin mixing. Fills chi2/ndf of each
+  // histogram into chi2Hist and returns the chi2/ndf of all of them
+  double CompareMixing( jetHadron::histograms* explicitHist, jetHadron::histograms* poolHist, TH1D* chi2Hist ) {
+    std::vector<TObject*> explicitObjects, poolObjects;
+    explicitHist->GetObjects( explicitObjects );
+    poolHist->GetObjects( poolObjects );
+    
+    double chi2Total = 0;
+    double ndfTotal = 0;
+    double worstChi2 = 0;
+    std::string worstName = "none";
+    unsigned nCompared = 0;
+    for ( unsigned i = 0; i < explicitObjects.size() && i < poolObjects.size(); ++i ) {
+      TH3* explicitCell = dynamic_cast<TH3*>( explicitObjects[i] );
+      TH3* poolCell = dynamic_cast<TH3*>( poolObjects[i] );
+      if ( !explicitCell || !poolCell || std::string( explicitCell->GetName() ) == "nevents" )
+        continue;
+      if ( explicitCell->GetEntries() == 0 && poolCell->GetEntries() == 0 )
+        continue;
+      
+      // summed over associated pt
+      double chi2 = 0;
+      double ndf = 0;
+      for ( int x = 1; x <= explicitCell->GetNbinsX(); ++x )
+        for ( int y = 1; y <= explicitCell->GetNbinsY(); ++y ) {
+          double difference = 0;
+          double variance = 0;
+          for ( int z = 1; z <= explicitCell->GetNbinsZ(); ++z ) {
+            difference += explicitCell->GetBinContent( x, y, z ) - poolCell->GetBinContent( x, y, z );
+            variance += pow( explicitCell->GetBinError( x, y, z ), 2 ) + pow( poolCell->GetBinError( x, y, z ), 2 );
+          }
+          if ( variance <= 0 )
+            continue;
+          chi2 += difference * difference / variance;
+          ndf += 1;
+        }
+      if ( ndf == 0 )
+        continue;
+      
+      nCompared++;
+      chi2Total += chi2;
+      ndfTotal += ndf;
+      chi2Hist->Fill( chi2 / ndf );
+      if ( chi2 / ndf > worstChi2 ) {
+        worstChi2 = chi2 / ndf;
+        worstName = explicitCell->GetName();
+      }
+    }
+    
+    double result = ( ndfTotal > 0 ? chi2Total / ndfTotal : 0 );
+    std::cout<<"  ------------ MIXING VALIDATION ------------ "<<std::endl;
+    std::cout<<"  compared "<< nCompared <<" correlation histograms"<<std::endl;
+    std::cout<<"  total chi2/ndf: "<< result <<" ( ndf "<< ndfTotal <<" )"<<std::endl;
+    std::cout<<"  worst: "<< worstName <<" chi2/ndf "<< worstChi2 <<std::endl;
+    return result;
+  }
+  
+}
 
 // DEF MAIN()
 int main ( int argc, const char** argv) {
@@ -168,13 +239,41 @@ int main ( int argc, const char** argv) {
   std::string    mixEventsFile = "auau_list/grid_AuAuy7MB.list";
   // Tree name in input file
   std::string 	 chainName     = "JetTree";
+  // entries of the jet tree to mix
+  std::string    entryRange    = "all";
+  
+  // optional: time the read, conversion and correlation stages
+  bool profileStages = jetHadron::PopFlag( argc, argv, "--profile" );
+  jetHadron::EnableStageProfiling( profileStages );
+  // optional: only report the projected memory of the job
+  bool dryRun = jetHadron::PopFlag( argc, argv, "--dry-run" );
+  // optional: output compression ( lz4 by default, the files are merged
+  // later ) and the number of threads serializing the histograms
+  std::string compressionSetting = "lz4:4";
+  jetHadron::PopOption( argc, argv, "--compression", compressionSetting );
+  std::string writeThreadsSetting = "1";
+  jetHadron::PopOption( argc, argv, "--write-threads", writeThreadsSetting );
+  int compression = jetHadron::ParseCompression( compressionSetting );
+  unsigned writeThreads = std::max( 1, atoi( writeThreadsSetting.c_str() ) );
+  if ( compression < 0 )
+    return -1;
+  // optional: explicit, pool-by-bin, or validate ( both ) mixing
+  std::string mixMode = "explicit";
+  jetHadron::PopOption( argc, argv, "--mix-mode", mixMode );
+  if ( mixMode != "explicit" && mixMode != "pool" && mixMode != "validate" ) {
+    __ERR( "Unknown mixing mode: explicit, pool or validate" )
+    return -1;
+  }
+  bool explicitMixing = ( mixMode == "explicit" || mixMode == "validate" );
+  bool poolMixing = ( mixMode == "pool" || mixMode == "validate" );
   
   // now check if we'll use the defaults or not
   switch ( argc ) {
     case 1: // Default case
       __OUT( "Using Default Settings" )
       break;
-    case 8: { // Custom case
+    case 8:
+    case 9: { // Custom case
       __OUT( "Using Custom Settings" )
       std::vector<std::string> arguments( argv+1, argv+argc );
       // Set non-default values
@@ -208,6 +307,10 @@ int main ( int argc, const char** argv) {
       // the file list/ root file for mixing
       mixEventsFile = arguments[6];
       
+      // optional entry range
+      if ( argc == 9 )
+        entryRange = arguments[7];
+      
       break;
     }
     default: { // Error: invalid custom settings
@@ -261,10 +364,31 @@ int main ( int argc, const char** argv) {
       return -1;
     }
   
+  // Project the memory needed for these settings - the pool holds one
+  // event ID per usable event ( at most nMixTotal, with vector growth )
+  // for a dry run, that is all
+  double poolBytes = ( nMixTotal > 0 ? 2.0 * nMixTotal * sizeof(unsigned) : 0 );
+  jetHadron::ReportProjectedMemory( analysisType, binsEta, binsPhi, jetRadius, false, poolBytes );
+  if ( dryRun )
+    return 0;
+  
   // initialize histogram container
   jetHadron::histograms* histograms = new jetHadron::histograms( analysisType, binsEta, binsPhi );
   histograms->Init();
   
+  // the analysis type as a mode, for the correlation loops
+  jetHadron::analysisMode mode = histograms->GetMode();
+  
+  // pool-by-bin mixing fills the same histograms, unless
+  // we are validating it against the explicit mixing
+  jetHadron::histograms* poolHistograms = histograms;
+  if ( mixMode == "validate" ) {
+    TH1::AddDirectory( kFALSE );
+    poolHistograms = new jetHadron::histograms( analysisType, binsEta, binsPhi );
+    poolHistograms->Init();
+    TH1::AddDirectory( kTRUE );
+  }
+  
   // we need to pick a minimum jet pt in case
   // we use HT events
   double mixingJetPtMax = jetHadron::GetMixEventJetPtMax( isMixMB, analysisType, leadJetPtMin );
@@ -282,8 +406,8 @@ int main ( int argc, const char** argv) {
   // If its a recognized file type, build the chain
   // If its not recognized, exit
   if ( inputIsRoot )		 	{ chain->Add( mixEventsFile.c_str() ); }
-  else if ( inputIsTxt )  { chain = TStarJetPicoUtils::BuildChainFromFileList( mixEventsFile.c_str() ); }
-  else if ( inputIsList ) { chain = TStarJetPicoUtils::BuildChainFromFileList( mixEventsFile.c_str() ); }
+  else if ( inputIsTxt )  { chain = jetHadron::BuildChainFromList( mixEventsFile, chainName ); }
+  else if ( inputIsList ) { chain = jetHadron::BuildChainFromList( mixEventsFile, chainName ); }
   else 										{ __ERR("data file is not recognized type: .root, .list, .txt only.") return -1; }
   
   // Now we can initialize the reader for mixing events
@@ -384,29 +508,25 @@ int main ( int argc, const char** argv) {
   
   std::string reportEntries = "total of " + patch::to_string( treeEntries ) + " trigger events";
   __OUT( reportEntries.c_str() )
-  // Define our branches
-  TLorentzVector *leadBranch = new TLorentzVector();
-  TLorentzVector *subBranch = new TLorentzVector();
-  int centBranch, vzBranch;
-  double ajBranch;
   
-  // set the branch addresses for the tree
-  if ( requireDijets ) {
-    jetTree->SetBranchAddress( "leadJet", &leadBranch );
-    jetTree->SetBranchAddress( "subLeadJet", &subBranch );
-    jetTree->SetBranchAddress( "vertexZBin", &vzBranch );
-    jetTree->SetBranchAddress( "aj", &ajBranch );
-    if ( analysisType == "dijetmix" )
-      jetTree->SetBranchAddress( "centralityBin", &centBranch );
-    
+  // Find the part of the tree this job mixes
+  Long64_t firstEntry, lastEntry;
+  if ( !jetHadron::GetEntryRange( entryRange, treeEntries, firstEntry, lastEntry ) ) {
+    __ERR("Could not parse entry range: exit")
+    return -1;
   }
-  else {
-    jetTree->SetBranchAddress( "triggerJet", &leadBranch );
-    jetTree->SetBranchAddress( "vertexZBin", &vzBranch );
-    if ( analysisType == "jetmix" )
-      jetTree->SetBranchAddress( "centralityBin", &centBranch );
-
+  std::string reportRange = "mixing tree entries " + patch::to_string( firstEntry ) + " to " + patch::to_string( lastEntry );
+  __OUT( reportRange.c_str() )
+  // Define our branches: flat jet trees, or the older
+  // TLorentzVector trees through the compatibility reader
+  jetHadron::jetTreeReader jetReader;
+  if ( !jetReader.Init( jetTree, requireDijets ) ) {
+    __ERR("could not set the jet tree branches")
+    return -1;
   }
+  const jetHadron::jetTreeEntry& treeEntry = jetReader.Entry();
+  int centBranch, vzBranch;
+  double ajBranch;
   __OUT("loaded branches")
   
   
@@ -443,7 +563,7 @@ int main ( int argc, const char** argv) {
       // (for pp, set to zero by default )
       int gRefMult = header->GetGReferenceMultiplicity();
       int refCentrality = 0;
-      if ( jetHadron::BeginsWith( analysisType, "pp") )
+      if ( jetHadron::IsPPMode( mode ) )
         refCentrality = 8;
       else {
         refCentrality = jetHadron::GetReferenceCentrality( gRefMult );
@@ -515,6 +635,7 @@ int main ( int argc, const char** argv) {
       }
     }
   __OUT("Done removing bins")
+  jetHadron::ReportMemory( "mixing event pool", jetHadron::MixingPoolBytes( mixing_events ) );
   
   // create a RNG for shuffling events
   std::random_device rd;
@@ -522,20 +643,22 @@ int main ( int argc, const char** argv) {
   g.seed( clock() );
   
   // Now we can run over all tree entries and perform the mixing
-  __OUT("Starting to perform event mixing")
-  for ( int i = 0; i < treeEntries; ++i ) {
+  if ( explicitMixing )
+    __OUT("Starting to perform event mixing")
+  for ( Long64_t i = firstEntry; explicitMixing && i < lastEntry; ++i ) {
 
     // Pull the next jet/dijet
-    jetTree->GetEntry(i);
+    jetReader.GetEntry(i);
+    vzBranch = treeEntry.vertexZBin;
+    centBranch = treeEntry.centralityBin;
+    ajBranch = treeEntry.aj;
     
-    if ( i % 20 == 0) {
-      std::string eventOut = "Mixing tree entry: " + patch::to_string(i);
-      __OUT( eventOut.c_str() )
-    }
+    if ( i % 20 == 0)
+      __OUT( "Mixing tree entry: " << i )
     
     // get the proper cent/vz bin
     std::vector< unsigned > randomizedEventID;
-    if ( jetHadron::BeginsWith( analysisType, "pp") )
+    if ( jetHadron::IsPPMode( mode ) )
       randomizedEventID = mixing_events[vzBranch][8];
     else
       randomizedEventID = mixing_events[vzBranch][centBranch];
@@ -550,11 +673,14 @@ int main ( int argc, const char** argv) {
     // now use the first nEventsToMix
     for ( int j = 0; j < nEventsToMix; ++j ) {
       // get the event
+      jetHadron::stageTimer readTimer( jetHadron::stageRead );
       reader.ReadEvent( randomizedEventID[j] );
+      readTimer.Stop();
+      jetHadron::CountStage( jetHadron::stageRead );
       
       // count event
       // first set any dummy variables necessary
-      if ( jetHadron::BeginsWith( analysisType, "pp") )
+      if ( jetHadron::IsPPMode( mode ) )
         centBranch = 8;
       if ( !requireDijets )
         ajBranch = 0.01;
@@ -576,8 +702,8 @@ int main ( int argc, const char** argv) {
       // now do the correlation
       if ( requireDijets ) {
         // make the trigger pseudojets
-        fastjet::PseudoJet leadTrigger = fastjet::PseudoJet( *leadBranch );
-        fastjet::PseudoJet subTrigger = fastjet::PseudoJet( *subBranch );
+        fastjet::PseudoJet leadTrigger = jetHadron::TreeJetToPseudoJet( treeEntry.lead );
+        fastjet::PseudoJet subTrigger = jetHadron::TreeJetToPseudoJet( treeEntry.sub );
         
         histograms->FillLeadEtaPhi( leadTrigger.eta(), leadTrigger.phi_std() );
         histograms->FillSubEtaPhi( subTrigger.eta(), subTrigger.phi_std() );
@@ -589,19 +715,19 @@ int main ( int argc, const char** argv) {
           // if we're using particle - by - particle efficiencies, get it,
           // else, set to one
           double assocEfficiency = 1.0;
-          if ( useEfficiency && !jetHadron::BeginsWith(analysisType, "pp") ) { assocEfficiency = efficiencyCorrection.EffAAY07( assocParticle.eta(), assocParticle.pt(), refCentAlt );
+          if ( useEfficiency && !jetHadron::IsPPMode( mode ) ) { assocEfficiency = efficiencyCorrection.EffAAY07( assocParticle.eta(), assocParticle.pt(), refCentAlt );
           }
-          else if ( useEfficiency && jetHadron::BeginsWith(analysisType, "pp") ) { assocEfficiency = efficiencyCorrection.EffPPY06( assocParticle.eta(), assocParticle.pt() );
+          else if ( useEfficiency && jetHadron::IsPPMode( mode ) ) { assocEfficiency = efficiencyCorrection.EffPPY06( assocParticle.eta(), assocParticle.pt() );
           }
           
-          jetHadron::correlateLeading( analysisType, vzBranch, centBranch, histograms, leadTrigger, assocParticle, assocEfficiency, ajBranch );
-          jetHadron::correlateSubleading( analysisType, vzBranch, centBranch, histograms, subTrigger, assocParticle, assocEfficiency, ajBranch );
+          jetHadron::correlateLeading( mode, vzBranch, centBranch, histograms, leadTrigger, assocParticle, assocEfficiency, ajBranch );
+          jetHadron::correlateSubleading( mode, vzBranch, centBranch, histograms, subTrigger, assocParticle, assocEfficiency, ajBranch );
         }
         
       }
       else {
         // make the trigger pseudojets
-        fastjet::PseudoJet leadTrigger = fastjet::PseudoJet( *leadBranch );
+        fastjet::PseudoJet leadTrigger = jetHadron::TreeJetToPseudoJet( treeEntry.lead );
         
         histograms->FillJetEtaPhi( leadTrigger.eta(), leadTrigger.phi_std() );
         
@@ -612,26 +738,127 @@ int main ( int argc, const char** argv) {
           // if we're using particle - by - particle efficiencies, get it,
           // else, set to one
           double assocEfficiency = 1.0;
-          if ( useEfficiency && !jetHadron::BeginsWith(analysisType, "pp") ) { assocEfficiency = efficiencyCorrection.EffAAY07( assocParticle.eta(), assocParticle.pt(), refCentAlt );
+          if ( useEfficiency && !jetHadron::IsPPMode( mode ) ) { assocEfficiency = efficiencyCorrection.EffAAY07( assocParticle.eta(), assocParticle.pt(), refCentAlt );
           }
-          else if ( useEfficiency && jetHadron::BeginsWith(analysisType, "pp") ) { assocEfficiency = efficiencyCorrection.EffPPY06( assocParticle.eta(), assocParticle.pt() );
+          else if ( useEfficiency && jetHadron::IsPPMode( mode ) ) { assocEfficiency = efficiencyCorrection.EffPPY06( assocParticle.eta(), assocParticle.pt() );
           }
           
-          jetHadron::correlateTrigger( analysisType, vzBranch, centBranch, histograms, leadTrigger, assocParticle, assocEfficiency );
+          jetHadron::correlateTrigger( mode, vzBranch, centBranch, histograms, leadTrigger, assocParticle, assocEfficiency );
 
         }
       }
     }
   }
   
-  // create an output file
-  TFile out((inputDir+"/"+outputFile).c_str(), "RECREATE");
+  // Pool-by-bin mixing: group the triggers by vz/centrality bin, then
+  // read each bin's events once and correlate all of its triggers
+  // with their inclusive associated distribution
+  if ( poolMixing ) {
+    __OUT("Starting pool-by-bin event mixing")
+    std::vector<std::vector<Long64_t> > binTriggers( jetHadron::binsVz * jetHadron::binsCentrality );
+    for ( Long64_t i = firstEntry; i < lastEntry; ++i ) {
+      jetReader.GetEntry(i);
+      int triggerCent = ( jetHadron::IsPPMode( mode ) ? 8 : treeEntry.centralityBin );
+      binTriggers[ treeEntry.vertexZBin * jetHadron::binsCentrality + triggerCent ].push_back( i );
+    }
+    
+    jetHadron::assocDistribution distribution;
+    unsigned nEventsRead = 0;
+    for ( int vz = 0; vz < jetHadron::binsVz; ++vz ) {
+      for ( int cent = 0; cent < jetHadron::binsCentrality; ++cent ) {
+        std::vector<Long64_t>& triggers = binTriggers[ vz * jetHadron::binsCentrality + cent ];
+        if ( triggers.size() == 0 )
+          continue;
+        
+        // If the event list was set to zero earlier,
+        // Then we will not be using that bin
+        std::vector<unsigned>& poolEvents = mixing_events[vz][cent];
+        if ( poolEvents.size() == 0 )  { __ERR("No mixing data") continue; }
+        
+        // build the bin's associated distribution
+        int refCentAlt = jetHadron::GetReferenceCentralityAlt( cent );
+        distribution.Clear();
+        for ( unsigned j = 0; j < poolEvents.size(); ++j ) {
+          jetHadron::stageTimer readTimer( jetHadron::stageRead );
+          reader.ReadEvent( poolEvents[j] );
+          readTimer.Stop();
+          jetHadron::CountStage( jetHadron::stageRead );
+          nEventsRead++;
+          
+          container = reader.GetOutputContainer();
+          particles.clear();
+          jetHadron::ConvertTStarJetVector( container, particles );
+          
+          for ( int k = 0; k < particles.size(); ++k ) {
+            double assocEfficiency = 1.0;
+            if ( useEfficiency && !jetHadron::IsPPMode( mode ) ) { assocEfficiency = efficiencyCorrection.EffAAY07( particles[k].eta(), particles[k].pt(), refCentAlt );
+            }
+            else if ( useEfficiency && jetHadron::IsPPMode( mode ) ) { assocEfficiency = efficiencyCorrection.EffPPY06( particles[k].eta(), particles[k].pt() );
+            }
+            distribution.Fill( particles[k], assocEfficiency );
+          }
+          distribution.CountEvent();
+        }
+        std::string binOut = "bin " + patch::to_string( vz ) + " " + patch::to_string( cent ) + ": " + patch::to_string( triggers.size() ) + " triggers, " + patch::to_string( distribution.GetNEvents() ) + " events, " + patch::to_string( distribution.GetNCells() ) + " cells";
+        __OUT( binOut.c_str() )
+        
+        // now correlate every trigger in the bin
+        for ( unsigned t = 0; t < triggers.size(); ++t ) {
+          jetReader.GetEntry( triggers[t] );
+          vzBranch = treeEntry.vertexZBin;
+          centBranch = ( jetHadron::IsPPMode( mode ) ? 8 : treeEntry.centralityBin );
+          ajBranch = ( requireDijets ? treeEntry.aj : 0.01 );
+          
+          fastjet::PseudoJet leadTrigger = jetHadron::TreeJetToPseudoJet( treeEntry.lead );
+          fastjet::PseudoJet subTrigger = jetHadron::TreeJetToPseudoJet( treeEntry.sub );
+          
+          // the event counts match nEventsToMix explicit mixed events
+          for ( unsigned j = 0; j < nEventsToMix; ++j ) {
+            poolHistograms->CountEvent( vzBranch, centBranch, ajBranch );
+            if ( requireDijets ) {
+              poolHistograms->FillLeadEtaPhi( leadTrigger.eta(), leadTrigger.phi_std() );
+              poolHistograms->FillSubEtaPhi( subTrigger.eta(), subTrigger.phi_std() );
+            }
+            else
+              poolHistograms->FillJetEtaPhi( leadTrigger.eta(), leadTrigger.phi_std() );
+          }
+          
+          if ( requireDijets ) {
+            distribution.CorrelateLeading( vzBranch, centBranch, poolHistograms, leadTrigger, ajBranch, nEventsToMix );
+            distribution.CorrelateSubleading( vzBranch, centBranch, poolHistograms, subTrigger, ajBranch, nEventsToMix );
+          }
+          else
+            distribution.CorrelateTrigger( vzBranch, centBranch, poolHistograms, leadTrigger, nEventsToMix );
+        }
+      }
+    }
+    std::string poolOut = "pool-by-bin mixing read " + patch::to_string( nEventsRead ) + " events";
+    __OUT( poolOut.c_str() )
+  }
   
-  histograms->Write();
-
-  hCentVz->Write();
+  // compare the two mixing methods
+  TH1D* hValidation = 0;
+  if ( mixMode == "validate" ) {
+    hValidation = new TH1D( "mix_validation", "Explicit vs pool-by-bin mixing;#chi^{2}/ndf;histograms", 100, 0, 5 );
+    CompareMixing( histograms, poolHistograms, hValidation );
+  }
   
-  out.Close();
+  // memory used, for sizing the grid requests
+  jetHadron::ReportMemory( "histograms", histograms->MemoryBytes() );
+  jetHadron::ReportMemory( "peak RSS", jetHadron::PeakRSSBytes() );
+  
+  // create the output file
+  std::vector<TObject*> outputObjects;
+  histograms->GetObjects( outputObjects );
+  outputObjects.push_back( hCentVz );
+  if ( hValidation )
+    outputObjects.push_back( hValidation );
+  if ( profileStages ) {
+    jetHadron::PrintStageSummary();
+    outputObjects.push_back( jetHadron::StageProfileHistogram() );
+  }
+  if ( jetHadron::WriteObjects( inputDir + "/" + outputFile, outputObjects, compression, writeThreads ) < 0 )
+    return -1;
   
   return 0;
 }
@@ -83,6 +83,7 @@ namespace patch {
 // 6 = corr2
 // 7 = mix2
 // .......
+// optional: --threads=n reads the input files with n threads ( default 1 )
 
 int main( int argc, const char** argv) {
   
@@ -123,6 +124,10 @@ int main( int argc, const char** argv) {
   std::string outputDirBase;
   // include low pt bin or no?
   bool includeLowPt = false;
+  // threads used to read and project the input
+  std::string threadSetting = "1";
+  jetHadron::PopOption( argc, argv, "--threads", threadSetting );
+  unsigned nThreads = std::max( 1, atoi( threadSetting.c_str() ) );
   
   switch ( argc ) {
     case 1: { // Default case
@@ -198,36 +203,13 @@ int main( int argc, const char** argv) {
     graphPtBinLow = 0;
   }
   
-  // Build our initial histogram holders
+  // Build our histogram holders - the input cells are streamed:
+  // each is read, reduced into the pt binned correlations and
+  // deleted, so only the reduced histograms stay in memory
   std::vector<TH3F*> nEvents;
   std::vector<TH3F*> nEventsHard;
-  std::vector<std::vector<std::vector<std::vector<TH3F*> > > > leadingCorrelationIn;
-  std::vector<std::vector<std::vector<std::vector<TH3F*> > > > subleadingCorrelationIn;
-  std::vector<std::vector<std::vector<std::vector<TH3F*> > > > leadingCorrelationInHard;
-  std::vector<std::vector<std::vector<std::vector<TH3F*> > > > subleadingCorrelationInHard;
-  // and event mixing
   std::vector<TH3F*> nEventsMixing;
   std::vector<TH3F*> nEventsMixingHard;
-  std::vector<std::vector<std::vector<std::vector<TH3F*> > > > leadingMixIn;
-  std::vector<std::vector<std::vector<std::vector<TH3F*> > > > subleadingMixIn;
-  std::vector<std::vector<std::vector<std::vector<TH3F*> > > > leadingMixInHard;
-  std::vector<std::vector<std::vector<std::vector<TH3F*> > > > subleadingMixInHard;
-  // reading in the histograms
-  jetHadron::ReadInFiles( corrFiles, leadingCorrelationIn, subleadingCorrelationIn, nEvents, selector );
-  jetHadron::ReadInFiles( corrFilesHard, leadingCorrelationInHard, subleadingCorrelationInHard, nEventsHard, selector, "pp_hard" );
-  jetHadron::ReadInFilesMix( mixFiles, leadingMixIn, subleadingMixIn, nEventsMixing, selector );
-  jetHadron::ReadInFilesMix( mixFilesHard, leadingMixInHard, subleadingMixInHard, nEventsMixingHard, selector, "pp_hard" );
-  
-  // Find the pt bin center for future use
-  std::vector<TH1F*> ptSpectra;
-  std::vector<std::vector<double> > ptBinCenters = jetHadron::FindPtBinCenter( leadingCorrelationIn, ptSpectra, selector );
-  
-  // building a pt bin error
-  std::vector<std::vector<double> > zeros;
-  zeros.resize( ptBinCenters.size() );
-  for ( int i = 0; i < ptBinCenters.size(); ++i ) {
-    zeros[i].resize( ptBinCenters[i].size() );
-  }
   
   // Now build the correlation histograms, both the total and the aj split
   std::vector<std::vector<std::vector<std::vector<TH2F*> > > > leadingCorrelation;
@@ -237,11 +219,21 @@ int main( int argc, const char** argv) {
   std::vector<std::vector<std::vector<std::vector<TH2F*> > > > leadingCorrelationHard;
   std::vector<std::vector<std::vector<std::vector<TH2F*> > > > subleadingCorrelationHard;
   
-  jetHadron::BuildSingleCorrelation( leadingCorrelationIn, leadingCorrelation, selector, "lead_uncorr" );
-  jetHadron::BuildSingleCorrelation( subleadingCorrelationIn, subleadingCorrelation, selector, "sublead_uncorr" );
-  jetHadron::BuildSingleCorrelation( leadingCorrelationInHard, leadingCorrelationHard, selector, "lead_uncorr_pp_hard" );
-  jetHadron::BuildSingleCorrelation( subleadingCorrelationInHard, subleadingCorrelationHard, selector, "sublead_uncorr_pp_hard" );
-  jetHadron::BuildAjSplitCorrelation( leadingCorrelationIn, correlationAjUnbalanced, correlationAjBalanced, selector, ajSplitBin, "aj_split_recomb" );
+  // and find the pt bin center for future use
+  std::vector<TH1F*> ptSpectra;
+  std::vector<std::vector<double> > ptBinCenters;
+  
+  if ( jetHadron::ReduceCorrelations( corrFiles, leadingCorrelation, subleadingCorrelation, &correlationAjUnbalanced, &correlationAjBalanced, ajSplitBin, nEvents, &ptSpectra, &ptBinCenters, selector, "lead_uncorr", "sublead_uncorr", "aj_split_recomb", nThreads ) < 0 )
+    return -1;
+  if ( jetHadron::ReduceCorrelations( corrFilesHard, leadingCorrelationHard, subleadingCorrelationHard, 0, 0, ajSplitBin, nEventsHard, 0, 0, selector, "lead_uncorr_pp_hard", "sublead_uncorr_pp_hard", "", nThreads ) < 0 )
+    return -1;
+  
+  // building a pt bin error
+  std::vector<std::vector<double> > zeros;
+  zeros.resize( ptBinCenters.size() );
+  for ( int i = 0; i < ptBinCenters.size(); ++i ) {
+    zeros[i].resize( ptBinCenters[i].size() );
+  }
   
   // get averaged correlations
   std::vector<std::vector<TH2F*> > averagedSignal = jetHadron::AverageCorrelations( leadingCorrelation, selector, "uncorr_avg" );
@@ -252,10 +244,14 @@ int main( int argc, const char** argv) {
   // Now build and scale the event mixing histograms.
   // we will use the averaged event mixing for now
   // First average over all centrality/vz/aj, project into pt
-  std::vector<std::vector<TH2F*> > leadingMix =  jetHadron::RecombineMixedEvents( leadingMixIn, selector, "avg_mix_" );
-  std::vector<std::vector<TH2F*> > subleadingMix = jetHadron::RecombineMixedEvents( subleadingMixIn, selector, "avg_mix_sub" );
-  std::vector<std::vector<TH2F*> > leadingMixHard =  jetHadron::RecombineMixedEvents( leadingMixInHard, selector, "avg_mix_hard" );
-  std::vector<std::vector<TH2F*> > subleadingMixHard = jetHadron::RecombineMixedEvents( subleadingMixInHard, selector, "avg_mix_sub_hard" );
+  std::vector<std::vector<TH2F*> > leadingMix;
+  std::vector<std::vector<TH2F*> > subleadingMix;
+  std::vector<std::vector<TH2F*> > leadingMixHard;
+  std::vector<std::vector<TH2F*> > subleadingMixHard;
+  if ( jetHadron::ReduceMixedEvents( mixFiles, leadingMix, subleadingMix, nEventsMixing, selector, "avg_mix_", "avg_mix_sub", nThreads ) < 0 )
+    return -1;
+  if ( jetHadron::ReduceMixedEvents( mixFilesHard, leadingMixHard, subleadingMixHard, nEventsMixingHard, selector, "avg_mix_hard", "avg_mix_sub_hard", nThreads ) < 0 )
+    return -1;
   
   // Build mixed events that are still not averaged as well
   //std::vector<std::vector<std::vector<std::vector<TH2F*> > > > leadingMixNotAveraged = jetHadron::BuildMixedEvents( leadingMixIn, selector, "not_avg_mix" );
@@ -298,16 +294,14 @@ int main( int argc, const char** argv) {
   gStyle->SetOptTitle(0);
   
   __OUT("Clearing input histograms")
-  // clear up the 1D histograms for the sake of my sanity
-//  ClearHistograms( leadingCorrelationIn );
-//  ClearHistograms( subleadingCorrelationIn );
-//  ClearHistograms( leadingCorrelation );
-//  ClearHistograms( subleadingCorrelation );
-//  ClearHistograms( leadingCorrelationInHard );
-//  ClearHistograms( subleadingCorrelationInHard );
-//  ClearHistograms( leadingCorrelationHard );
-//  ClearHistograms( subleadingCorrelationHard );
-//  
+  // the per vz/centrality correlations have all been reduced
+  // into the averaged and corrected histograms by now
+  ClearHistograms( leadingCorrelation );
+  ClearHistograms( subleadingCorrelation );
+  ClearHistograms( correlationAjBalanced );
+  ClearHistograms( correlationAjUnbalanced );
+  ClearHistograms( leadingCorrelationHard );
+  ClearHistograms( subleadingCorrelationHard );
   __OUT("Finished clearing input histograms")
   
   
@@ -9,48 +9,18 @@
 
 namespace jetHadron {
   
-  // These are used by fill functions
-  // to check for consistency
-  bool histograms::IsPP() {
-    
-    if ( analysisType.find("pp") != std::string::npos )
-    return true;
-    
-    return false;
-  }
-  
-  bool histograms::IsAuAu() {
-    
-    if ( analysisType.find("pp") == std::string::npos )
-    return true;
-    
-    return false;
-  }
-  
-  bool histograms::IsDijet() {
-    
-    if ( analysisType.find("dijet") != std::string::npos )
-    return true;
-    
-    return false;
-  }
-  
-  bool histograms::IsJet() {
-    
-    if ( analysisType.find("dijet") == std::string::npos && analysisType.find("jet") != std::string::npos )
-    return true;
-    
-    return false;
-  }
-  
-  bool histograms::IsMix() {
-    
-    if ( analysisType.find("mix") != std::string::npos )
-    return true;
-    
-    return false;
+  namespace {
+    // TH3::Fill adds weight^2 to the errors of the bin it filled -
+    // swap that for the sum of the squared weights it stands for
+    void CorrectSumw2( TH3F* hist, int bin, double weight, double sumw2 ) {
+      if ( sumw2 < 0 || bin < 0 || hist->GetSumw2N() == 0 )
+        return;
+      hist->GetSumw2()->AddAt( hist->GetSumw2()->At( bin ) + sumw2 - weight*weight, bin );
+    }
   }
   
+  // These are used by fill functions
+  // to check for consistency
   // Used to check if the histograms have been initialized
   // before allowing any filling to stop seg faults
   bool histograms::IsInitialized() {
@@ -69,7 +39,11 @@ namespace jetHadron {
     
     // split by analysis type
     
-    if ( analysisType == "dijet" || analysisType == "ppdijet" || analysisType == "dijetmix" || analysisType == "ppdijetmix" ) {
+    leadingCells.assign( binsAj * binsCentrality * binsVz, (TH3F*) 0 );
+    if ( IsDijet() )
+      subleadingCells.assign( binsAj * binsCentrality * binsVz, (TH3F*) 0 );
+    
+    if ( IsDijet() ) {
       
       //now build the full 3D vz/centrality binned histograms
       TH3F* tmpHistLead, * tmpHistSub;
@@ -95,7 +69,7 @@ namespace jetHadron {
             
             TString leadName = "lead_aj_";
             TString subName = "sub_aj_";
-            if ( analysisType == "dijetmix" || analysisType == "ppdijetmix" ) {
+            if ( IsMix() ) {
               leadName = "mix_lead_aj_";
               subName = "mix_sub_aj_";
             }
@@ -110,12 +84,14 @@ namespace jetHadron {
             // add to the correct bin
             leadingArrays[i][j]->AddLast( tmpHistLead );
             subleadingArrays[i][j]->AddLast( tmpHistSub );
+            leadingCells[ CellIndex( i, j, k ) ] = tmpHistLead;
+            subleadingCells[ CellIndex( i, j, k ) ] = tmpHistSub;
           }
         }
       }
     }
     
-    if ( analysisType == "jet" || analysisType == "ppjet" || analysisType == "jetmix" || analysisType == "ppjetmix" ) {
+    else if ( mode != modeUnknown ) {
       
       
       TH3F* tmpHistTrig;
@@ -134,7 +110,7 @@ namespace jetHadron {
             s2 << j;
             s3 << k;
             TString leadName = "lead_aj_";
-            if ( analysisType == "jetmix" || analysisType == "ppjetmix" ) {
+            if ( IsMix() ) {
               leadName = "mix_lead_aj_";
             }
             
@@ -144,6 +120,7 @@ namespace jetHadron {
             
             // add to the correct bin
             leadingArrays[i][j]->AddLast( tmpHistTrig );
+            leadingCells[ CellIndex( i, j, k ) ] = tmpHistTrig;
           }
         }
       }
@@ -193,16 +170,17 @@ namespace jetHadron {
   int histograms::FindAjBin(double aj) {
     double ajBinWidth = ( ajHighEdge - ajLowEdge ) / binsAj;
 
-    for ( int i = 0; i < binsAj; ++i ) {
-      if ( aj < ajBinWidth*( i + 1 ) )
-        return i; 
-    }
-    return -1;
+    // anything below the first edge goes in bin 0,
+    // anything at or above the last ( or NaN ) is -1
+    if ( !( aj < ajBinWidth*binsAj ) )
+      return -1;
+    return UniformBinLowerClosed( aj, 0.0, ajBinWidth, binsAj );
   }
   
 
   histograms::histograms() {
     analysisType = "none";
+    mode = modeUnknown;
     initialized = false;
     binsEta = 0;
     binsPhi = 0;
@@ -232,6 +210,7 @@ namespace jetHadron {
   
   histograms::histograms( std::string anaType, unsigned tmpBinsEta, unsigned tmpBinsPhi ) {
     analysisType = anaType;
+    mode = GetAnalysisMode( anaType );
     initialized = false;
     
     binsEta = tmpBinsEta;
@@ -312,6 +291,8 @@ namespace jetHadron {
         }
       }
     }
+    leadingCells.clear();
+    subleadingCells.clear();
   }
   
   
@@ -323,6 +304,7 @@ namespace jetHadron {
       initialized = false;
       Clear();
       analysisType = type;
+      mode = GetAnalysisMode( type );
       return true;
     }
     
@@ -350,7 +332,7 @@ namespace jetHadron {
     hAssocPt 		= new TH1D("assocpt", "Associated Track Pt;p_{T}", 80, 0, 12 );
     hAssocEtaPhi= new TH2D("assocetaphi", "Associated Track Eta Phi;#eta;#phi", 40, -1, 1, 40, -pi, pi );
     
-    if ( analysisType == "dijet" || analysisType == "ppdijet" ) {
+    if ( IsDijet() && !IsMix() ) {
       hAjHigh 		= new TH1D( "ajhigh", "A_{J} High P_{T} Constituents;A_{J};fraction", 30, 0, 0.9 );
       hAjLow 			= new TH1D( "ajlow", "A_{J} Low P_{T} Constituents;A_{J};fraction", 30, 0, 0.9 );
       hAjDif      = new TH3F( "ajdif", "A_{J} difference by A_{J} hard and soft", 30, 0, 1, 30, 0, 1, 30, 0, 1 );
@@ -367,53 +349,61 @@ namespace jetHadron {
   }
   
   void histograms::Write() {
+    std::vector<TObject*> objects;
+    GetObjects( objects );
+    for ( unsigned i = 0; i < objects.size(); ++i )
+      objects[i]->Write();
+  }
+  
+  void histograms::GetObjects( std::vector<TObject*>& objects ) {
+    TH1* single[] = { hCentVz, hBinVz, hGRefMult, hVz, hLeadJetPt, hLeadEtaPhi, hSubJetPt, hSubEtaPhi, hAssocEtaPhi, hAssocPt, hAjHigh, hAjLow, hAjDif, h3DimCorrLead, h3DimCorrSub, hAjStruct };
+    for ( unsigned i = 0; i < sizeof(single) / sizeof(single[0]); ++i )
+      if ( single[i] )
+        objects.push_back( single[i] );
     
-    if ( hCentVz )
-    hCentVz->Write();
-    if ( hBinVz )
-    hBinVz->Write();
-    if ( hGRefMult )
-    hGRefMult->Write();
-    if ( hVz )
-    hVz->Write();
-    
-    if ( hLeadJetPt )
-    hLeadJetPt->Write();
-    if ( hLeadEtaPhi )
-    hLeadEtaPhi->Write();
-    if ( hSubJetPt )
-    hSubJetPt->Write();
-    if ( hSubEtaPhi )
-    hSubEtaPhi->Write();
-    
-    if ( hAssocEtaPhi )
-    hAssocEtaPhi->Write();
-    if ( hAssocPt )
-    hAssocPt->Write();
-    
-    if ( hAjHigh )
-    hAjHigh->Write();
-    if ( hAjLow )
-    hAjLow->Write();
-    if ( hAjDif )
-    hAjDif->Write();
-    
-    if ( h3DimCorrLead )
-    h3DimCorrLead->Write();
-    if ( h3DimCorrSub )
-    h3DimCorrSub->Write();
-    if ( hAjStruct )
-    hAjStruct->Write();
+    // the arrays are written element by element, under the cell names
+    for ( int i = 0; i < binsAj; ++i ) {
+      for ( int j = 0; j < binsCentrality; ++j ) {
+        if ( leadingArrays && leadingArrays[i] && leadingArrays[i][j] )
+          for ( int k = 0; k <= leadingArrays[i][j]->GetLast(); ++k )
+            if ( leadingArrays[i][j]->At(k) )
+              objects.push_back( leadingArrays[i][j]->At(k) );
+        if ( subleadingArrays && subleadingArrays[i] && subleadingArrays[i][j] )
+          for ( int k = 0; k <= subleadingArrays[i][j]->GetLast(); ++k )
+            if ( subleadingArrays[i][j]->At(k) )
+              objects.push_back( subleadingArrays[i][j]->At(k) );
+      }
+    }
+  }
+  
+  
+  double histograms::MemoryBytes() {
+    TH1* single[] = { hCentVz, hBinVz, hGRefMult, hVz, hLeadJetPt, hLeadEtaPhi, hSubJetPt, hSubEtaPhi, hAssocPt, hAssocEtaPhi, hAjHigh, hAjLow, hAjDif, h3DimCorrLead, h3DimCorrSub, hAjStruct };
+    double bytes = 0;
+    for ( unsigned i = 0; i < sizeof(single) / sizeof(single[0]); ++i )
+      bytes += HistogramBytes( single[i] );
     
     for ( int i = 0; i < binsAj; ++i ) {
       for ( int j = 0; j < binsCentrality; ++j ) {
-        if ( leadingArrays && leadingArrays[i] && leadingArrays[i][j] ) {
-          leadingArrays[i][j]->Write();
-        }
+        if ( leadingArrays && leadingArrays[i] && leadingArrays[i][j] )
+          for ( int k = 0; k <= leadingArrays[i][j]->GetLast(); ++k )
+            bytes += HistogramBytes( (TH1*) leadingArrays[i][j]->At(k) );
         if ( subleadingArrays && subleadingArrays[i] && subleadingArrays[i][j] )
-          subleadingArrays[i][j]->Write();
+          for ( int k = 0; k <= subleadingArrays[i][j]->GetLast(); ++k )
+            bytes += HistogramBytes( (TH1*) subleadingArrays[i][j]->At(k) );
       }
     }
+    return bytes;
+  }
+  
+  // one TH3F per aj/centrality/vz bin, two of them for dijets
+  double histograms::ProjectedBytes( std::string type, unsigned binsEta, unsigned binsPhi ) {
+    double nCells = ( binsEta + 2.0 ) * ( binsPhi + 2.0 ) * ( binsPt + 2.0 );
+    double cellSize = sizeof(float) + ( TH1::GetDefaultSumw2() ? sizeof(double) : 0 );
+    double nHistograms = (double) binsAj * binsCentrality * binsVz;
+    if ( type == "dijet" || type == "ppdijet" || type == "dijetmix" || type == "ppdijetmix" )
+      nHistograms *= 2.0;
+    return nHistograms * ( nCells * cellSize + TH3F::Class()->Size() );
   }
   
   
@@ -474,17 +464,15 @@ namespace jetHadron {
     return true;
   }
   
-  bool histograms::FillCorrelation( double dEta,  double dPhi, double assocPt, double weight, int vzBin, int centBin ) {
-    if ( !IsInitialized() ) { return false; }
-    
+  bool histograms::FillCorrelation( double dEta,  double dPhi, double assocPt, double weight, int vzBin, int centBin, double sumw2 ) {
     if ( dPhi < phiLowEdge+phiBinShift)
     dPhi += 2.0*pi;
     
-    h3DimCorrLead->Fill( dEta, dPhi, assocPt, weight );
+    CorrectSumw2( h3DimCorrLead, h3DimCorrLead->Fill( dEta, dPhi, assocPt, weight ), weight, sumw2 );
       
     // now do the bin-divided fill
-    TH3F* tmpHist = (TH3F*) leadingArrays[0][centBin]->At(vzBin);
-    tmpHist->Fill( dEta, dPhi, assocPt, weight );
+    TH3F* cell = leadingCells[ CellIndex( 0, centBin, vzBin ) ];
+    CorrectSumw2( cell, cell->Fill( dEta, dPhi, assocPt, weight ), weight, sumw2 );
     return true;
   }
   
@@ -517,38 +505,34 @@ namespace jetHadron {
     return true;
   }
   
-  bool histograms::FillCorrelationLead( double dEta, double dPhi, double assocPt, double weight, double aj, int vzBin, int centBin ) {
-    if ( !IsInitialized() ) { return false; }
-    
+  bool histograms::FillCorrelationLead( double dEta, double dPhi, double assocPt, double weight, double aj, int vzBin, int centBin, double sumw2 ) {
     if ( dPhi < phiLowEdge+phiBinShift )
     dPhi += 2.0*pi;
     
     // find aj bin, if applicable
     int binAj = FindAjBin( aj );
     
-    h3DimCorrLead->Fill( dEta, dPhi, assocPt, weight );
+    CorrectSumw2( h3DimCorrLead, h3DimCorrLead->Fill( dEta, dPhi, assocPt, weight ), weight, sumw2 );
     
     // now do the bin-divided fill
-    TH3F* tmpHist = (TH3F*) leadingArrays[binAj][centBin]->At(vzBin);
-    tmpHist->Fill( dEta, dPhi, assocPt, weight );
+    TH3F* cell = leadingCells[ CellIndex( binAj, centBin, vzBin ) ];
+    CorrectSumw2( cell, cell->Fill( dEta, dPhi, assocPt, weight ), weight, sumw2 );
       
     return true;
   }
   
-  bool histograms::FillCorrelationSub( double dEta, double dPhi, double assocPt, double weight, double aj, int vzBin, int centBin ) {
-    if ( !IsInitialized() ) { return false; }
-    
+  bool histograms::FillCorrelationSub( double dEta, double dPhi, double assocPt, double weight, double aj, int vzBin, int centBin, double sumw2 ) {
     if ( dPhi < phiLowEdge+phiBinShift )
     dPhi += 2.0*pi;
     
     // find aj bin, if applicable
     int binAj = FindAjBin( aj );
     
-    h3DimCorrSub->Fill( dEta, dPhi, assocPt, weight );
+    CorrectSumw2( h3DimCorrSub, h3DimCorrSub->Fill( dEta, dPhi, assocPt, weight ), weight, sumw2 );
       
     // now do the bin-divided fill
-    TH3F* tmpHist = (TH3F*) subleadingArrays[binAj][centBin]->At(vzBin);
-    tmpHist->Fill( dEta, dPhi, assocPt, weight );
+    TH3F* cell = subleadingCells[ CellIndex( binAj, centBin, vzBin ) ];
+    CorrectSumw2( cell, cell->Fill( dEta, dPhi, assocPt, weight ), weight, sumw2 );
       
     return true;
   }
@@ -17,6 +17,7 @@ namespace jetHadron {
   private:
     
     std::string analysisType;			// Used by Init() to create proper histograms
+    analysisMode mode;            // analysisType parsed once, used when filling
     bool initialized;							// Used for control flow - must be true before filling
     
     unsigned binsEta;             // Binning for histograms
@@ -54,16 +55,22 @@ namespace jetHadron {
     TObjArray*** leadingArrays;
     TObjArray*** subleadingArrays;
     
+    // The same histograms, flat in [aj][cent][vz] - used when
+    // filling so a fill is an index computation, not a lookup
+    std::vector<TH3F*> leadingCells;
+    std::vector<TH3F*> subleadingCells;
+    int CellIndex( int ajBin, int centBin, int vzBin ) { return ( ajBin * binsCentrality + centBin ) * binsVz + vzBin; }
+    
     // a histogram to see if there is some event or jet structure
     // relating to Aj
     TH3F* hAjStruct;
     
     // Used internally when filling histograms
-    bool IsPP();
-    bool IsAuAu();
-    bool IsDijet();
-    bool IsJet();
-    bool IsMix();
+    bool IsPP()     { return IsPPMode( mode ); }
+    bool IsAuAu()   { return !IsPPMode( mode ); }
+    bool IsDijet()  { return IsDijetMode( mode ); }
+    bool IsJet()    { return !IsDijetMode( mode ); }
+    bool IsMix()    { return IsMixMode( mode ); }
     
     // Checked to make sure the histogram class
     // has been initialized before filling
@@ -77,11 +84,12 @@ namespace jetHadron {
     // Used internally to pick histogram edges
     // that give a bin centered at zero in correlation plots
     void FindBinShift();
-
-    // Used to find the respective Aj bin
-    int FindAjBin(double aj);
     
   public:
+    // Used to find the respective Aj bin, -1 if aj is at or
+    // above the last edge. Static so test_binning can check it
+    static int FindAjBin(double aj);
+    
     histograms( );
     histograms( std::string type, unsigned binsEta = 24, unsigned binsPhi = 24 ); // In general, this should be used, passing "dijet" or "jet" for analysis
     ~histograms();
@@ -91,6 +99,7 @@ namespace jetHadron {
     
     // Get the analysis type
     std::string GetAnalysisType()  { return analysisType; }
+    analysisMode GetMode()         { return mode; }
     
     // Can set analysisType or Aj splitting - careful, if it changes after Init() is called
     // Reinitialization will be needed
@@ -103,6 +112,16 @@ namespace jetHadron {
     // Writes histograms to current root directory
     void Write();
     
+    // Appends every histogram Write() would write, in the same order -
+    // used by the parallel output ( WriteObjects )
+    void GetObjects( std::vector<TObject*>& objects );
+    
+    // Bytes held by all histograms, and the projected bytes of
+    // the vz/centrality/aj correlation arrays before they are built -
+    // the drivers report these, Init() prints nothing
+    double MemoryBytes();
+    static double ProjectedBytes( std::string type, unsigned binsEta = 24, unsigned binsPhi = 24 );
+    
     // Get Histograms
     TH3F* GetCentVz()				{ return hCentVz; }
     TH2D* GetBinVz()				{ return hBinVz; }
@@ -132,7 +151,9 @@ namespace jetHadron {
     bool FillJetPt( double pt );										// For Jet-hadron: records accepted trigger jet pt
     bool FillJetEtaPhi( double eta, double phi );		// Records accepted trigger jet eta-phi
     // records trigger-associated correlations
-    bool FillCorrelation( double dEta, double dPhi, double assocPt, double weight, int vzBin, int centBin = 0 );
+    // sumw2 >= 0 replaces weight^2 in the bin errors - used when one
+    // fill stands for several tracks, whose weights were summed
+    bool FillCorrelation( double dEta, double dPhi, double assocPt, double weight, int vzBin, int centBin = 0, double sumw2 = -1 );
     
     // For dijet-hadron
     bool FillLeadJetPt( double pt );								// For dijet-hadron: records lead jet pt
@@ -140,8 +161,10 @@ namespace jetHadron {
     bool FillLeadEtaPhi( double eta, double phi );	// Records lead jet eta-phi
     bool FillSubEtaPhi( double eta, double phi );		// Records sub jet eta-phi
     // Records trigger-associated correlations with trigger = leading/subleading
-    bool FillCorrelationLead( double dEta, double dPhi, double assocPt, double weight, double aj, int vzBin, int centBin = 0 );
-    bool FillCorrelationSub( double dEta, double dPhi, double assocPt, double weight, double aj, int vzBin, int centBin = 0 );
+    // The correlation fills are the inner loop - they do not check
+    // IsInitialized(), so Init() must have been called. sumw2 as above
+    bool FillCorrelationLead( double dEta, double dPhi, double assocPt, double weight, double aj, int vzBin, int centBin = 0, double sumw2 = -1 );
+    bool FillCorrelationSub( double dEta, double dPhi, double assocPt, double weight, double aj, int vzBin, int centBin = 0, double sumw2 = -1 );
     
     // Associated track info
     bool FillAssocPt( double pt );
@@ -14,6 +14,15 @@
 
 ClassImp(ktTrackEff)
 
+//Parameter sets shared by the compiled functions and the TF2 formulas
+//Run 4, by centrality bin: 0 is 0-5%, 1 is 5-10%, 2 is 10-20%
+static const Double_t parsetY04[3][14]={
+  { 0.631911, 0.117639, -0.29002, 0.522928, -0.569609, -1.3921, -6.73044, 0.0588101, -0.00686795, 0.110982, 0.2951, 0.14493, 0.295612, 0.00290843 },
+  { 0.652242, 0.0760859, -0.0784171, 0.0393619, -0.247293, -2.04786, -8.96039, 0.0603416, -0.006971, -0.0435101, 0.131005, 0.00053132, 0.74369, 0.00576589 },
+  { 0.698809, 0.0347652, -0.00819333, 0.112736, -0.356907, -1.62506, -7.26695, 0.0436162, -0.00453185, 0.249514, 0.308879, 0.133046, 0.295414, 0.0019349 } };
+//Run 6
+static const Double_t parsetY06[16]={0.869233,0.0223402,0.44061,0.558762,0.145162,0.508033,110.008,-4.63659,1.73765,0.0452674,-0.101279,0.0081551,0.945287,-2.00949,1.61746,1.39352};
+
 ktTrackEff::ktTrackEff(TString mfName)
 {
 
@@ -37,15 +46,6 @@ ktTrackEff::ktTrackEff(TString mfName)
   effY07eta[2] = (TH1D*)fEff->Get("etaScale_2");
   effY07eta[2]->SetName("effY07eta_2"); effY07eta[2]->SetDirectory(0);
   fEff->Close();
-  effY04[0] = GetEffY04(0);
-  effY04[0]->SetName("effY04_0");
-  effY04[1] = GetEffY04(1);
-  effY04[1]->SetName("effY04_1");
-  effY04[2] = GetEffY04(2);
-  effY04[2]->SetName("effY04_2");
-  
-  effY06 = GetEffY06();
-  effY06->SetName("effY06");
 
   sysUn=0;
 
@@ -56,12 +56,6 @@ ktTrackEff::ktTrackEff(TString mfName)
 
 ktTrackEff::~ktTrackEff()
 {
-  delete effY06;
- 
-  delete effY04[0];
-  delete effY04[1];
-  delete effY04[2];
-
   delete effY07pteta[0];
   delete effY07pteta[1];
   delete effY07pteta[2];
@@ -71,7 +65,6 @@ ktTrackEff::~ktTrackEff()
   delete effY07eta[2];
  
   // funny way way not working via delete[] !???
-  //delete[] effY04;
   //delete[] effY07pteta;
   //delete[] effY07eta;
 
@@ -98,14 +91,41 @@ void ktTrackEff::PrintInfo()
 }
 
 
+//Same as the GetEffY06 formula, x = pt, y = eta
+Double_t ktTrackEff::EffY06(Double_t mPt, Double_t eta)
+{
+  const Double_t* p = parsetY06;
+  Double_t g1 = (mPt-p[4])/p[5];
+  Double_t g2 = (mPt-p[7])/p[8];
+  Double_t y2 = (eta-p[11])*(eta-p[11]);
+  Double_t y4 = y2*y2;
+
+  return p[0]-0.06-p[1]*exp(p[2]/mPt)
+    +p[3]*exp(-0.5*g1*g1)/sqrt(2*TMath::Pi()*p[5]*p[5])
+    -p[6]*exp(-0.5*g2*g2)/sqrt(2*TMath::Pi()*p[8]*p[8])
+    +(p[9]-p[10]*y2-p[12]*y4-p[13]*y4*y2-p[14]*y4*y4)*exp(-p[15]*mPt);
+}
+
+//Same as the GetEffY04 formula, x = eta, y = pt
+Double_t ktTrackEff::EffY04(Double_t eta, Double_t mPt, Int_t cb)
+{
+  const Double_t* p = parsetY04[cb];
+  Double_t x2 = eta*eta;
+  Double_t x4 = x2*x2;
+  Double_t dx = TMath::Abs(eta)-p[10];
+  Double_t dy = TMath::Abs(mPt)-p[12];
+
+  return p[0]+p[1]*x2+p[2]*x4+p[3]*x4*x2+p[4]*x4*x4
+    +p[5]*exp(p[6]*mPt)+p[7]*mPt+p[8]*mPt*mPt
+    +p[9]*exp(-dx*dx/p[11]-dy*dy/p[13]);
+}
+
 TF2* ktTrackEff::GetEffY06()
 {
 
   TF2* funcpp = new TF2("ppEfficiency","[0]-0.06-[1]*exp([2]/x)+[3]*exp(-0.5*((x-[4])/[5])**2)/sqrt(2*pi*[5]*[5])-[6]*exp(-0.5*((x-[7])/[8])**2)/sqrt(2*pi*[8]*[8])+([9]-[10]*(y-[11])^2-[12]*(y-[11])^4-[13]*(y-[11])^6-[14]*(y-[11])^8)*exp(-[15]*x)",0.,10.,-1.,1.);
 
-  Double_t parset[] = {0.869233,0.0223402,0.44061,0.558762,0.145162,0.508033,110.008,-4.63659,1.73765,0.0452674,-0.101279,0.0081551,0.945287,-2.00949,1.61746,1.39352};
-
-  ((TF2*)funcpp)->SetParameters(parset);
+  ((TF2*)funcpp)->SetParameters(parsetY06);
 
   return funcpp;
 }
@@ -121,18 +141,9 @@ TF2* ktTrackEff::GetEffY04(Int_t cb)
 
   TF2* func = new TF2(name,"[0]+[1]*x^2+[2]*x^4+[3]*x^6+[4]*x^8+[5]*exp([6]*y)+[7]*y+[8]*y*y +  [9]*exp(-((abs(x)-[10])^2)  /[11] - ((  abs(y)-[12]  )^2) /[13]) ",-1.,1.,0.,fMaxPtPara);
 
-  Double_t parset4[]={ 0.698809, 0.0347652, -0.00819333, 0.112736, -0.356907, -1.62506, -7.26695, 0.0436162, -0.00453185, 0.249514, 0.308879, 0.133046, 0.295414, 0.0019349 };
-  Double_t parset5[]={ 0.652242, 0.0760859, -0.0784171, 0.0393619, -0.247293, -2.04786, -8.96039, 0.0603416, -0.006971, -0.0435101, 0.131005, 0.00053132, 0.74369, 0.00576589 };
-  Double_t parset6[]={ 0.631911, 0.117639, -0.29002, 0.522928, -0.569609, -1.3921, -6.73044, 0.0588101, -0.00686795, 0.110982, 0.2951, 0.14493, 0.295612, 0.00290843 };
-
-  if(cb == 0)
-    ((TF2*)func)->SetParameters(parset6);
-  else if(cb == 1)
-    ((TF2*)func)->SetParameters(parset5);
-  else if(cb == 2)
-    ((TF2*)func)->SetParameters(parset4);
-
-  if(cb < 0 || cb > 2)
+  if(cb >= 0 && cb <= 2)
+    ((TF2*)func)->SetParameters(parsetY04[cb]);
+  else
     std::cout << "Error: Nonsensical Centrality Class!" << std::endl;
 
   return func;
@@ -151,9 +162,9 @@ Double_t ktTrackEff::EffAAY07(Double_t eta, Double_t mPt, Int_t centBin)
 {
   Double_t effWeight=1.0;
   if(mPt < 5.)
-    effWeight = effY04[centBin]->Eval(eta,mPt);
+    effWeight = EffY04(eta,mPt,centBin);
   else
-    effWeight = effY04[centBin]->Eval(eta,5.0);
+    effWeight = EffY04(eta,5.0,centBin);
   if(mPt > 1.5)
     effWeight *= effY07eta[centBin]->GetBinContent(effY07eta[centBin]->GetXaxis()->FindBin(eta));
   else
@@ -166,7 +177,7 @@ Double_t ktTrackEff::EffPPY06(Double_t eta, Double_t mPt)
 {
   Double_t effWeight=1.0;
   
-  effWeight = effY06->Eval(mPt,eta);
+  effWeight = EffY06(mPt,eta);
   
   return effWeight;
 }
@@ -25,16 +25,20 @@ private:
   TString fName;
 
   //centrality bins: 0 is 0-5%, 1 is 5-10%, 2 is 10-20%
-  TF2* effY04[3]; // Run 4 parameterization
   TH2D* effY07pteta[3]; // Run 7 HT / Run 4 MB pt-eta map, used for pt <= 1.5 GeV/c
   TH1D* effY07eta[3]; // Run 7 HT / Run 4 MB eta map, used for pt > 1.5 GeV/c
-  TF2* effY06; // Run 6 parameterization
 
 
   Int_t sysUn;
 
   public:
 
+  // Run 4 and Run 6 parameterizations, compiled - used by the Eff* methods
+  static Double_t EffY04(Double_t eta, Double_t mPt, Int_t cb);
+  static Double_t EffY06(Double_t mPt, Double_t eta);
+
+  // the same parameterizations as TF2 formulas, for plotting only:
+  // building them JIT compiles the formulas
   TF2* GetEffY06();
   TF2* GetEffY04(Int_t cb);
    
@@ -53,7 +57,7 @@ private:
   Double_t EffRatio_20_Unc(Double_t eta, Double_t mPt);
   //Double_t EffRatio_20_Unc();
 
-  ClassDef(ktTrackEff,1)
+  ClassDef(ktTrackEff,2)
 };
 
 #endif
@@ -0,0 +1,276 @@
+// Logging used by the __OUT / __ERR macros
+// Nick Elsey
+
+#include "logging.hh"
+
+#include <iostream>
+#include <streambuf>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+namespace jetHadron {
+
+  namespace {
+
+#ifdef JH_LOG_DEBUG
+    std::atomic<int> minimumLevel( logDebug );
+#else
+    std::atomic<int> minimumLevel( logInfo );
+#endif
+    std::atomic<long long> burstMessages( 10 );
+    std::atomic<long long> intervalMicroseconds( 1000000 );
+
+    long long NowMicroseconds() {
+      return std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+    
+    void WaitForQueue();
+    
+    // Put in front of std::cout and std::cerr while the logger runs:
+    // a direct write first waits for every message queued before it,
+    // so prints that bypass the logger keep their order. Unbuffered,
+    // so every write comes through here; the check is two atomic loads
+    class orderedBuffer : public std::streambuf {
+    public:
+      orderedBuffer( std::streambuf* target ) : fTarget( target ) { }
+      std::streambuf* Target() const { return fTarget; }
+      
+    protected:
+      int overflow( int c ) {
+        WaitForQueue();
+        return ( c == traits_type::eof() ? traits_type::not_eof( c ) : fTarget->sputc( traits_type::to_char_type( c ) ) );
+      }
+      std::streamsize xsputn( const char* text, std::streamsize n ) {
+        WaitForQueue();
+        return fTarget->sputn( text, n );
+      }
+      int sync() {
+        return fTarget->pubsync();
+      }
+      
+    private:
+      std::streambuf* fTarget;
+    };
+
+    // the queue and the thread writing it. Messages are
+    // numbered, so a flush can wait for everything queued
+    // before it without stopping the other threads
+    class logger {
+
+    public:
+
+      // the writer has its own streams on the real buffers,
+      // so it never waits on the ordered ones
+      logger() : coutBuffer( std::cout.rdbuf() ), cerrBuffer( std::cerr.rdbuf() ), out( coutBuffer.Target() ), err( cerrBuffer.Target() ), nQueued( 0 ), nWritten( 0 ), stopping( false ), reported( false ) {
+        std::cout.flush();
+        std::cerr.flush();
+        std::cout.rdbuf( &coutBuffer );
+        std::cerr.rdbuf( &cerrBuffer );
+        writer = std::thread( &logger::Run, this );
+      }
+
+      ~logger() {
+        Report();
+        {
+          std::lock_guard<std::mutex> lock( queueMutex );
+          stopping = true;
+        }
+        wake.notify_one();
+        if ( writer.joinable() )
+          writer.join();
+        std::cout.rdbuf( coutBuffer.Target() );
+        std::cerr.rdbuf( cerrBuffer.Target() );
+      }
+
+      logSite* Register( const char* file, int line, const char* function, logLevel level ) {
+        std::lock_guard<std::mutex> lock( sitesMutex );
+        sites.push_back( new logSite( file, line, function, level ) );
+        return sites.back();
+      }
+
+      void Push( logLevel level, const std::string& text, bool wait ) {
+        long long number;
+        {
+          std::lock_guard<std::mutex> lock( queueMutex );
+          queue.push_back( std::make_pair( level, text ) );
+          number = ++nQueued;
+        }
+        wake.notify_one();
+        if ( wait )
+          WaitFor( number );
+      }
+
+      void Flush() {
+        long long number;
+        {
+          std::lock_guard<std::mutex> lock( queueMutex );
+          number = nQueued;
+        }
+        WaitFor( number );
+      }
+      
+      // Flush, but without the lock when nothing is queued. Not
+      // from the writer, which would wait for itself
+      void FlushIfQueued() {
+        if ( nWritten.load() >= nQueued.load() || std::this_thread::get_id() == writer.get_id() )
+          return;
+        Flush();
+      }
+
+      // the counters of every site that was reached, and the
+      // totals - dropped below the level counts as suppressed too
+      void Report() {
+        std::vector<std::string> lines;
+        {
+          std::lock_guard<std::mutex> lock( sitesMutex );
+          if ( reported )
+            return;
+          reported = true;
+          long long nMessages = 0, nSuppressed = 0;
+          unsigned nLimitedSites = 0;
+          for ( unsigned i = 0; i < sites.size(); ++i ) {
+            if ( sites[i]->count == 0 )
+              continue;
+            std::ostringstream line;
+            line << "[" << sites[i]->file << ":" << sites[i]->line << "::" << sites[i]->function << "()] -- LOG: ";
+            line << sites[i]->count << " messages, " << sites[i]->suppressed << " suppressed";
+            lines.push_back( line.str() );
+            nMessages += sites[i]->count;
+            nSuppressed += sites[i]->suppressed;
+            nLimitedSites += ( sites[i]->suppressed > 0 );
+          }
+          if ( lines.size() ) {
+            std::ostringstream line;
+            line << "[logging] -- LOG: " << nMessages << " messages from " << lines.size() << " sites, ";
+            line << nSuppressed << " suppressed at " << nLimitedSites << " sites";
+            lines.push_back( line.str() );
+          }
+        }
+        for ( unsigned i = 0; i < lines.size(); ++i )
+          Push( logInfo, lines[i], false );
+        Flush();
+      }
+
+    private:
+
+      void WaitFor( long long number ) {
+        std::unique_lock<std::mutex> lock( queueMutex );
+        drained.wait( lock, [this, number] { return nWritten >= number; } );
+      }
+
+      // writes whatever is queued in one go, and flushes once per batch
+      void Run() {
+        std::deque<std::pair<logLevel, std::string> > batch;
+        std::unique_lock<std::mutex> lock( queueMutex );
+        while ( true ) {
+          wake.wait( lock, [this] { return stopping || !queue.empty(); } );
+          if ( queue.empty() && stopping )
+            break;
+          batch.swap( queue );
+          lock.unlock();
+
+          bool anyErrors = false;
+          for ( unsigned i = 0; i < batch.size(); ++i ) {
+            if ( batch[i].first >= logError ) {
+              err << batch[i].second << '\n';
+              anyErrors = true;
+            }
+            else
+              out << batch[i].second << '\n';
+          }
+          out.flush();
+          if ( anyErrors )
+            err.flush();
+
+          lock.lock();
+          nWritten += batch.size();
+          batch.clear();
+          drained.notify_all();
+        }
+      }
+
+      orderedBuffer coutBuffer;
+      orderedBuffer cerrBuffer;
+      std::ostream out;
+      std::ostream err;
+      
+      std::mutex queueMutex;
+      std::condition_variable wake;       // the writer: something was queued
+      std::condition_variable drained;    // flushes: something was written
+      std::deque<std::pair<logLevel, std::string> > queue;
+      std::atomic<long long> nQueued;     // written under queueMutex, read
+      std::atomic<long long> nWritten;    // without it by FlushIfQueued
+      bool stopping;
+      std::thread writer;
+
+      std::mutex sitesMutex;
+      std::vector<logSite*> sites;
+      bool reported;
+    };
+
+    logger& Logger() {
+      static logger instance;
+      return instance;
+    }
+    
+    void WaitForQueue() {
+      Logger().FlushIfQueued();
+    }
+
+  }
+
+  logSite::logSite( const char* siteFile, int siteLine, const char* siteFunction, logLevel siteLevel ) : file( siteFile ), line( siteLine ), function( siteFunction ), level( siteLevel ), count( 0 ), suppressed( 0 ), nextAllowed( 0 ) { }
+
+  bool logSite::Accept() {
+    long long n = ++count;
+    if ( level < minimumLevel ) {
+      ++suppressed;
+      return false;
+    }
+    // errors are never rate limited
+    if ( level >= logError || n <= burstMessages )
+      return true;
+    // past the burst: one message per interval, and only
+    // the thread that moves nextAllowed forward writes it
+    long long now = NowMicroseconds();
+    long long allowed = nextAllowed;
+    if ( now >= allowed && nextAllowed.compare_exchange_strong( allowed, now + intervalMicroseconds ) )
+      return true;
+    ++suppressed;
+    return false;
+  }
+
+  logSite* LogRegisterSite( const char* file, int line, const char* function, logLevel level ) {
+    return Logger().Register( file, line, function, level );
+  }
+
+  void LogWrite( logSite* site, const std::string& message ) {
+    Logger().Push( site->level, message, site->level >= logError );
+  }
+
+  void LogFlush() {
+    Logger().Flush();
+  }
+
+  void SetLogLevel( logLevel level ) {
+    minimumLevel = level;
+  }
+
+  logLevel GetLogLevel() {
+    return (logLevel) minimumLevel.load();
+  }
+
+  void SetLogRate( long long burst, double intervalSeconds ) {
+    burstMessages = burst;
+    intervalMicroseconds = (long long) ( intervalSeconds * 1.0e6 );
+  }
+
+  void LogReport() {
+    Logger().Report();
+  }
+
+}
@@ -0,0 +1,84 @@
+// Logging used by the __OUT / __ERR macros
+// Messages are formatted at the call site, but written by a
+// background thread, so a message in the event loop costs a
+// string and a queue push instead of a flushed std::endl.
+// Every call site has a counter: after logBurst messages a
+// site is limited to one message per logIntervalSeconds ( errors
+// never are ), and the counters of every site that was reached
+// are listed at the end of the job.
+// While the logger runs, std::cout and std::cerr wait for the
+// queue before writing, so direct prints keep their order too.
+// Debug messages ( __DBG ) are only compiled in with -DJH_LOG_DEBUG
+// Nick Elsey
+
+#include <string>
+#include <sstream>
+#include <atomic>
+
+#ifndef LOGGING_HH
+#define LOGGING_HH
+
+namespace jetHadron {
+
+  enum logLevel { logDebug = 0, logInfo, logWarning, logError };
+
+  // One call site of a logging macro - created once per site,
+  // owned by the logger and kept until the end of the job
+  struct logSite {
+    const char* file;
+    int line;
+    const char* function;
+    logLevel level;
+    std::atomic<long long> count;           // every call
+    std::atomic<long long> suppressed;      // calls that were rate limited, or below the level
+    std::atomic<long long> nextAllowed;     // steady clock, in microseconds
+
+    logSite( const char* siteFile, int siteLine, const char* siteFunction, logLevel siteLevel );
+
+    // counts the call, false if the message should be dropped
+    bool Accept();
+  };
+
+  // Registers a call site with the logger
+  logSite* LogRegisterSite( const char* file, int line, const char* function, logLevel level );
+
+  // Queues a formatted message. Errors also wait until everything
+  // queued so far is written, so they are not lost if the job crashes
+  void LogWrite( logSite* site, const std::string& message );
+
+  // Blocks until every queued message has been written
+  void LogFlush();
+
+  // Messages below the level are dropped ( default logInfo )
+  void SetLogLevel( logLevel level );
+  logLevel GetLogLevel();
+
+  // Rate limit of every site: burst messages, then one per interval
+  void SetLogRate( long long burst, double intervalSeconds );
+
+  // Writes the counters of every site, and flushes -
+  // called when the job ends, can also be called by hand
+  void LogReport();
+
+}
+
+#define __LOG(level, tag, message) { \
+  static jetHadron::logSite* __logSite = jetHadron::LogRegisterSite( __FILE__, __LINE__, __func__, level ); \
+  if ( __logSite->Accept() ) { \
+    std::ostringstream __logStream; \
+    __logStream << "[" << __FILE__ << "::" << __func__ << "()] -- " << tag << ": " << message; \
+    jetHadron::LogWrite( __logSite, __logStream.str() ); \
+  } \
+}
+
+#define __ERR(message) __LOG( jetHadron::logError, "ERR", message )
+#define __WARN(message) __LOG( jetHadron::logWarning, "WARN", message )
+#define __OUT(message) __LOG( jetHadron::logInfo, "OUT", message )
+
+#ifdef JH_LOG_DEBUG
+#define __DBG(message) __LOG( jetHadron::logDebug, "DBG", message )
+#else
+#define __DBG(message) {}
+#endif
+
+#endif
@@ -0,0 +1,123 @@
+// Writes ( or refreshes ) the manifest next to each input .list:
+// one "path entries bytes modtime md5" line per file, so chains can be
+// built without opening every file. Files already in the manifest
+// with an unchanged size and modification time are not reopened, unless --verify is given,
+// in which case every checksum is recomputed and compared.
+// Nick Elsey
+
+// All reader and histogram settings
+// Are located in corrParameters.hh
+#include "corrParameters.hh"
+
+// The majority of the jetfinding
+// And correlation code is located in
+// corrFunctions.hh
+#include "corrFunctions.hh"
+
+// ROOT Headers
+#include "TFile.h"
+#include "TTree.h"
+#include "TMD5.h"
+#include "TSystem.h"
+
+// STL Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+
+// -------------------------
+// Command line arguments:
+// [0...]: input .list files, each gets a .list.manifest
+// optional: --verify recomputes the checksum of every file
+//           --tree=JetTree name of the tree whose entries are counted
+
+// DEF MAIN()
+int main ( int argc, const char** argv ) {
+
+  bool verify = jetHadron::PopFlag( argc, argv, "--verify" );
+  std::string chainName = "JetTree";
+  jetHadron::PopOption( argc, argv, "--tree", chainName );
+
+  if ( argc < 2 ) {
+    __ERR( "Usage: make_manifest [--verify] [--tree=JetTree] list1.list [list2.list...]" )
+    return -1;
+  }
+
+  bool failed = false;
+  std::vector<std::string> lists( argv+1, argv+argc );
+  for ( unsigned l = 0; l < lists.size(); ++l ) {
+    std::string manifestFile = jetHadron::ManifestPath( lists[l] );
+    std::vector<std::string> files = jetHadron::ReadFileList( lists[l] );
+    if ( files.size() == 0 ) {
+      __ERR( "no files in " << lists[l] )
+      failed = true;
+      continue;
+    }
+
+    std::vector<jetHadron::manifestEntry> previous;
+    jetHadron::ReadManifest( manifestFile, previous );
+    std::map<std::string, jetHadron::manifestEntry> known;
+    for ( unsigned i = 0; i < previous.size(); ++i )
+      known[previous[i].path] = previous[i];
+
+    std::vector<jetHadron::manifestEntry> manifest;
+    unsigned nReused = 0, nScanned = 0, nChanged = 0;
+    for ( unsigned i = 0; i < files.size(); ++i ) {
+      Long_t id, flags, modtime;
+      Long64_t size;
+      if ( gSystem->GetPathInfo( files[i].c_str(), &id, &size, &flags, &modtime ) != 0 ) {
+        __ERR( "Could not find " << files[i] )
+        failed = true;
+        continue;
+      }
+
+      bool inManifest = known.count( files[i] ) && known[files[i]].bytes == size && known[files[i]].modtime == modtime;
+      if ( inManifest && !verify ) {
+        manifest.push_back( known[files[i]] );
+        nReused++;
+        continue;
+      }
+
+      jetHadron::manifestEntry entry;
+      entry.path = files[i];
+      entry.bytes = size;
+      entry.modtime = modtime;
+      TFile* file = TFile::Open( files[i].c_str(), "READ" );
+      if ( !file || file->IsZombie() ) {
+        __ERR( "Could not open " << files[i] )
+        failed = true;
+        delete file;
+        continue;
+      }
+      TTree* tree = (TTree*) file->Get( chainName.c_str() );
+      entry.entries = ( tree ? tree->GetEntries() : 0 );
+      file->Close();
+      delete file;
+
+      TMD5* md5 = TMD5::FileChecksum( files[i].c_str() );
+      entry.checksum = ( md5 ? md5->AsString() : "none" );
+      delete md5;
+
+      if ( inManifest && ( entry.checksum != known[files[i]].checksum || entry.entries != known[files[i]].entries ) ) {
+        __WARN( files[i] << " has changed since the manifest was written" )
+        nChanged++;
+      }
+      manifest.push_back( entry );
+      nScanned++;
+    }
+
+    if ( !jetHadron::WriteManifest( manifestFile, lists[l], manifest ) ) {
+      failed = true;
+      continue;
+    }
+    std::cout<<manifestFile<<": "<< manifest.size() <<" files, "<< nReused <<" unchanged, "<< nScanned <<" scanned";
+    if ( verify )
+      std::cout<<", "<< nChanged <<" changed";
+    std::cout<<std::endl;
+  }
+
+  return ( failed ? -1 : 0 );
+}
@@ -0,0 +1,298 @@
+// Merges the correlation output of many grid jobs
+// ( corr_*.root or mix_*.root ) into a single file.
+// Replaces hadd: knows the histograms class layout, splits
+// the input files between threads, and reduces each
+// chunk of cells in a tree before writing it out once.
+// Nick Elsey
+
+// All reader and histogram settings
+// Are located in corrParameters.hh
+#include "corrParameters.hh"
+
+// The majority of the jetfinding
+// And correlation code is located in
+// corrFunctions.hh
+#include "corrFunctions.hh"
+
+// ROOT Headers
+#include "TROOT.h"
+#include "TH1.h"
+#include "TH2.h"
+#include "TH3.h"
+#include "TFile.h"
+#include "TKey.h"
+#include "TList.h"
+#include "TClass.h"
+#include "TStopwatch.h"
+
+// STL Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <set>
+#include <thread>
+
+// -------------------------
+// Command line arguments:
+// [0]: output file
+// [1]: number of threads ( each thread reads its own subset of the inputs )
+// [2]: number of histograms held in memory per thread at once
+// [3...]: input files, or a single .list/.txt of input files
+// optional: --compression=algorithm:level for the output ( zstd:5 by default )
+
+namespace {
+
+  // Each worker owns a subset of the input files, and
+  // keeps a partial sum of the current chunk of keys.
+  // The files are opened by the worker's thread on its first
+  // chunk, and closed as soon as the last chunk is read
+  struct mergeWorker {
+    std::vector<std::string> paths;
+    std::vector<TFile*> files;
+    std::vector<double> fileEvents;     // nevents integral per file, -1 if it has none
+    std::vector<bool>   fileFailed;     // could not be opened, or a key was missing
+    std::vector<TH1*> partial;
+  };
+
+  // Adds the histograms for keys [first, last) from all of the worker's files
+  // into its partial sums. Empty cells are only kept if nothing else is found,
+  // so the output keeps the full layout
+  void ReadChunk( mergeWorker& worker, const std::vector<std::string>& keys, unsigned first, unsigned last, bool lastChunk ) {
+    worker.partial.assign( last - first, 0 );
+    for ( unsigned f = 0; f < worker.paths.size(); ++f ) {
+      // a file that could not be opened is skipped from then on
+      if ( worker.fileFailed[f] && !worker.files[f] )
+        continue;
+      if ( !worker.files[f] ) {
+        worker.files[f] = TFile::Open( worker.paths[f].c_str(), "READ" );
+        if ( !worker.files[f] || worker.files[f]->IsZombie() ) {
+          __ERR( "could not open " << worker.paths[f] )
+          delete worker.files[f];
+          worker.files[f] = 0;
+          worker.fileFailed[f] = true;
+          continue;
+        }
+      }
+      
+      for ( unsigned k = first; k < last; ++k ) {
+        TH1* hist = (TH1*) worker.files[f]->Get( keys[k].c_str() );
+        if ( !hist ) {
+          __ERR( "missing " << keys[k] << " in " << worker.paths[f] )
+          worker.fileFailed[f] = true;
+          continue;
+        }
+
+        // the per file event counts, for the summary
+        if ( keys[k] == "nevents" )
+          worker.fileEvents[f] = hist->Integral();
+
+        TH1*& sum = worker.partial[k-first];
+        if ( !sum )
+          sum = hist;
+        else if ( hist->GetEntries() == 0 )
+          delete hist;
+        else if ( sum->GetEntries() == 0 ) {
+          delete sum;
+          sum = hist;
+        }
+        else {
+          sum->Add( hist );
+          delete hist;
+        }
+      }
+      
+      if ( lastChunk ) {
+        worker.files[f]->Close();
+        delete worker.files[f];
+        worker.files[f] = 0;
+      }
+    }
+  }
+
+  // Used in the tree reduction: adds source's partial sums into target
+  void ReduceChunk( mergeWorker& target, mergeWorker& source ) {
+    for ( unsigned k = 0; k < target.partial.size(); ++k ) {
+      TH1*& sum = target.partial[k];
+      TH1*& add = source.partial[k];
+      if ( !add )
+        continue;
+      if ( !sum || ( sum->GetEntries() == 0 && add->GetEntries() != 0 ) ) {
+        delete sum;
+        sum = add;
+      }
+      else {
+        if ( add->GetEntries() != 0 )
+          sum->Add( add );
+        delete add;
+      }
+      add = 0;
+    }
+  }
+
+}
+
+// DEF MAIN()
+int main ( int argc, const char** argv ) {
+
+  //Start a timer
+  TStopwatch TimeKeeper;
+  TimeKeeper.Start( );
+
+  // the merged file is the final product, so compress it harder
+  // than the per job files
+  std::string compressionSetting = "zstd:5";
+  jetHadron::PopOption( argc, argv, "--compression", compressionSetting );
+  int compression = jetHadron::ParseCompression( compressionSetting );
+  if ( compression < 0 )
+    return -1;
+  
+  if ( argc < 5 ) {
+    __ERR( "Usage: merge_correlations [--compression=zstd:5] outputFile nThreads chunkSize inputFiles... ( or a .list )" )
+    return -1;
+  }
+
+  std::vector<std::string> arguments( argv+1, argv+argc );
+  std::string outputFile = arguments[0];
+  unsigned nThreads = std::max( 1, atoi( arguments[1].c_str() ) );
+  unsigned chunkSize = std::max( 1, atoi( arguments[2].c_str() ) );
+
+  // the inputs: either given directly, or in a list
+  std::vector<std::string> inputFiles;
+  if ( arguments.size() == 4 && ( jetHadron::HasEnding( arguments[3], ".list" ) || jetHadron::HasEnding( arguments[3], ".txt" ) ) ) {
+    std::ifstream list( arguments[3].c_str() );
+    std::string line;
+    while ( std::getline( list, line ) )
+      if ( line.size() && line[0] != '#' )
+        inputFiles.push_back( line );
+  }
+  else
+    inputFiles.assign( arguments.begin()+3, arguments.end() );
+
+  if ( inputFiles.size() == 0 ) {
+    __ERR( "no input files" )
+    return -1;
+  }
+  nThreads = std::min( nThreads, (unsigned) inputFiles.size() );
+
+  // we read from several files at once, and dont want
+  // histograms attached to the input directories
+  ROOT::EnableThreadSafety();
+  TH1::AddDirectory( kFALSE );
+
+  // The key list from the first file defines the output layout
+  std::vector<std::string> keys;
+  {
+    TFile first( inputFiles[0].c_str(), "READ" );
+    if ( first.IsZombie() ) {
+      __ERR( "could not open " << inputFiles[0] )
+      return -1;
+    }
+    std::set<std::string> seen;
+    TIter nextKey( first.GetListOfKeys() );
+    TKey* key = 0;
+    while ( ( key = (TKey*) nextKey() ) ) {
+      if ( seen.count( key->GetName() ) )
+        continue;
+      seen.insert( key->GetName() );
+      TClass* keyClass = TClass::GetClass( key->GetClassName() );
+      if ( !keyClass || !keyClass->InheritsFrom( TH1::Class() ) ) {
+        __OUT( "skipping non-histogram key " << key->GetName() )
+        continue;
+      }
+      keys.push_back( key->GetName() );
+    }
+  }
+  std::cout<<"Merging "<< keys.size() <<" histograms from "<< inputFiles.size() <<" files using "<< nThreads <<" threads"<<std::endl;
+
+  // split the input files between the workers - each
+  // file is opened once, by the thread that reads it
+  std::vector<mergeWorker> workers( nThreads );
+  for ( unsigned i = 0; i < inputFiles.size(); ++i ) {
+    mergeWorker& worker = workers[i % nThreads];
+    worker.paths.push_back( inputFiles[i] );
+    worker.files.push_back( 0 );
+    worker.fileEvents.push_back( -1 );
+    worker.fileFailed.push_back( false );
+  }
+
+  TFile out( outputFile.c_str(), "RECREATE", "", compression );
+  if ( out.IsZombie() ) {
+    __ERR( "could not create " << outputFile )
+    return -1;
+  }
+
+  // Now stream over the keys a chunk at a time: read in parallel,
+  // reduce the partial sums pairwise, then write each histogram once
+  for ( unsigned first = 0; first < keys.size(); first += chunkSize ) {
+    unsigned last = std::min( first + chunkSize, (unsigned) keys.size() );
+
+    std::vector<std::thread> threads;
+    for ( unsigned i = 0; i < nThreads; ++i )
+      threads.push_back( std::thread( ReadChunk, std::ref( workers[i] ), std::cref( keys ), first, last, last == keys.size() ) );
+    for ( unsigned i = 0; i < threads.size(); ++i )
+      threads[i].join();
+
+    for ( unsigned stride = 1; stride < nThreads; stride *= 2 ) {
+      threads.clear();
+      for ( unsigned i = 0; i + stride < nThreads; i += 2*stride )
+        threads.push_back( std::thread( ReduceChunk, std::ref( workers[i] ), std::ref( workers[i+stride] ) ) );
+      for ( unsigned i = 0; i < threads.size(); ++i )
+        threads[i].join();
+    }
+
+    out.cd();
+    for ( unsigned k = 0; k < workers[0].partial.size(); ++k ) {
+      if ( !workers[0].partial[k] )
+        continue;
+      workers[0].partial[k]->Write( keys[first+k].c_str() );
+      delete workers[0].partial[k];
+      workers[0].partial[k] = 0;
+    }
+  }
+
+  // account for every input: files that could not be read are not in
+  // the output, files without events are in it but add nothing
+  unsigned nFailed = 0, nEmpty = 0, nCounted = 0;
+  double nEvents = 0;
+  for ( unsigned i = 0; i < nThreads; ++i )
+    for ( unsigned f = 0; f < workers[i].paths.size(); ++f ) {
+      if ( workers[i].fileFailed[f] ) {
+        __ERR( "skipped or incomplete: " << workers[i].paths[f] )
+        nFailed++;
+        continue;
+      }
+      if ( workers[i].fileEvents[f] < 0 )
+        continue;
+      nCounted++;
+      nEvents += workers[i].fileEvents[f];
+      if ( workers[i].fileEvents[f] == 0 ) {
+        __WARN( "no events in " << workers[i].paths[f] )
+        nEmpty++;
+      }
+    }
+  bool failed = ( nFailed > 0 );
+  
+  // the event total of the inputs, and the I/O round trip: the
+  // nevents written to the output reads back as that total
+  TH1* mergedEvents = (TH1*) out.Get( "nevents" );
+  if ( mergedEvents ) {
+    std::cout<<"nevents: "<< nEvents <<" events in "<< nCounted <<" of "<< inputFiles.size() <<" files ( "<< nEmpty <<" without events, "<< nFailed <<" skipped ), merged file reads back "<< mergedEvents->Integral() <<std::endl;
+    if ( fabs( mergedEvents->Integral() - nEvents ) > 1e-6 * std::max( 1.0, nEvents ) ) {
+      __ERR( "merged event count does not read back as the sum of the inputs" )
+      failed = true;
+    }
+  }
+  else
+    __WARN( "no nevents histogram found - event counts not verified" )
+
+  out.Close();
+
+  std::cout<<"Merged "<< inputFiles.size() <<" files in "<< TimeKeeper.RealTime() <<" seconds"<<std::endl;
+
+  return ( failed ? -1 : 0 );
+}
@@ -13,6 +13,13 @@
 // and some more root stuff
 #include "TPaveText.h"
 #include "TLatex.h"
+#include "TROOT.h"
+#include "TKey.h"
+
+// the parallel read/projection path
+#include <map>
+#include <thread>
+#include <atomic>
 
 // the grid does not have std::to_string() for some ungodly reason
 // replacing it here. Simply ostringstream
@@ -218,6 +225,500 @@ namespace jetHadron {
     return 1;
   }
 
+
+  // Projects a TH3F onto eta-phi for every pt bin in a single pass
+  // over its bin array - replaces SetRange + Project3D("YX") per pt bin
+  void ProjectPtSlices( TH3F* hist, std::vector<TH2F*>& slices, binSelector& selector, std::vector<std::string> names, std::vector<int> ptSlice, TH1F* spectrum, std::vector<double>* ptSumw, std::vector<double>* ptSumwx ) {
+    
+    // by default each pt bin gets its own slice
+    if ( ptSlice.empty() )
+      for ( int m = 0; m < selector.nPtBins; ++m )
+        ptSlice.push_back( m );
+    int nSlices = 0;
+    for ( unsigned m = 0; m < ptSlice.size(); ++m )
+      nSlices = std::max( nSlices, ptSlice[m] + 1 );
+    if ( slices.size() < nSlices )
+      slices.resize( nSlices, 0 );
+    
+    int nx = hist->GetNbinsX();
+    int ny = hist->GetNbinsY();
+    int nz = hist->GetNbinsZ();
+    int nCellsXY = ( nx + 2 ) * ( ny + 2 );
+    const Float_t* content = hist->GetArray();
+    const Double_t* error2 = ( hist->GetSumw2N() ? hist->GetSumw2()->GetArray() : 0 );
+    
+    // which pt bins and slices each z bin feeds -
+    // SetRange truncates the edges to bin numbers as well
+    std::vector<std::vector<int> > zPtBins( nz + 2 );
+    std::vector<std::vector<int> > zSlices( nz + 2 );
+    for ( unsigned m = 0; m < ptSlice.size(); ++m ) {
+      int zLow = std::max( 0, (int) selector.ptBinLowEdge(m) );
+      int zHigh = std::min( nz + 1, (int) selector.ptBinHighEdge(m) );
+      for ( int z = zLow; z <= zHigh; ++z ) {
+        zPtBins[z].push_back( m );
+        if ( ptSlice[m] >= 0 )
+          zSlices[z].push_back( ptSlice[m] );
+      }
+    }
+    
+    // the contribution of this histogram, summed in double
+    std::vector<std::vector<double> > sliceContent( nSlices );
+    std::vector<std::vector<double> > sliceError2( nSlices );
+    std::vector<double> sumw( nSlices, 0 );
+    std::vector<double> sumw2( nSlices, 0 );
+    for ( unsigned m = 0; m < ptSlice.size(); ++m ) {
+      if ( ptSlice[m] >= 0 && sliceContent[ptSlice[m]].empty() ) {
+        sliceContent[ptSlice[m]].assign( nCellsXY, 0 );
+        sliceError2[ptSlice[m]].assign( nCellsXY, 0 );
+      }
+    }
+    
+    if ( spectrum && spectrum->GetNbinsX() != nz ) {
+      __ERR( "pt spectrum binning does not match " << hist->GetName() )
+      spectrum = 0;
+    }
+    if ( spectrum && !spectrum->GetSumw2N() )
+      spectrum->Sumw2();
+    bool findCenters = ( ptSumw && ptSumwx );
+    if ( findCenters ) {
+      ptSumw->resize( std::max( ptSumw->size(), ptSlice.size() ), 0 );
+      ptSumwx->resize( std::max( ptSumwx->size(), ptSlice.size() ), 0 );
+    }
+    
+    for ( int z = 0; z <= nz + 1; ++z ) {
+      if ( zPtBins[z].empty() && !spectrum )
+        continue;
+      
+      double zAll = 0, zAllError2 = 0;
+      double zInner = 0, zInnerError2 = 0;
+      const int offset = z * nCellsXY;
+      for ( int y = 0; y <= ny + 1; ++y ) {
+        bool innerY = ( y >= 1 && y <= ny );
+        for ( int x = 0; x <= nx + 1; ++x ) {
+          int xy = x + ( nx + 2 ) * y;
+          double c = content[offset+xy];
+          double e2 = ( error2 ? error2[offset+xy] : c );
+          if ( c == 0 && e2 == 0 )
+            continue;
+          
+          zAll += c;
+          zAllError2 += e2;
+          if ( innerY && x >= 1 && x <= nx ) {
+            zInner += c;
+            zInnerError2 += e2;
+          }
+          for ( unsigned s = 0; s < zSlices[z].size(); ++s ) {
+            sliceContent[zSlices[z][s]][xy] += c;
+            sliceError2[zSlices[z][s]][xy] += e2;
+          }
+        }
+      }
+      
+      for ( unsigned s = 0; s < zSlices[z].size(); ++s ) {
+        sumw[zSlices[z][s]] += zInner;
+        sumw2[zSlices[z][s]] += zInnerError2;
+      }
+      if ( spectrum ) {
+        spectrum->AddBinContent( z, zAll );
+        spectrum->GetSumw2()->GetArray()[z] += zAllError2;
+      }
+      if ( findCenters ) {
+        double ptCenter = hist->GetZaxis()->GetBinCenter( z );
+        for ( unsigned p = 0; p < zPtBins[z].size(); ++p ) {
+          (*ptSumw)[zPtBins[z][p]] += zAll;
+          (*ptSumwx)[zPtBins[z][p]] += zAll * ptCenter;
+        }
+      }
+    }
+    
+    // now add into the output - entries are the effective
+    // entries of the projection, as Project3D sets them
+    for ( int s = 0; s < nSlices; ++s ) {
+      if ( sliceContent[s].empty() )
+        continue;
+      
+      if ( !slices[s] ) {
+        std::string name = ( s < names.size() ? names[s] : std::string( hist->GetName() ) + "_pt_" + patch::to_string(s) );
+        slices[s] = new TH2F( name.c_str(), ( std::string( hist->GetTitle() ) + " yx projection" ).c_str(), nx, hist->GetXaxis()->GetXmin(), hist->GetXaxis()->GetXmax(), ny, hist->GetYaxis()->GetXmin(), hist->GetYaxis()->GetXmax() );
+        slices[s]->SetDirectory( 0 );
+        slices[s]->GetXaxis()->SetTitle( hist->GetXaxis()->GetTitle() );
+        slices[s]->GetYaxis()->SetTitle( hist->GetYaxis()->GetTitle() );
+      }
+      TH2F* slice = slices[s];
+      if ( slice->GetNcells() != nCellsXY ) {
+        __ERR( "slice " << slice->GetName() << " binning does not match " << hist->GetName() )
+        continue;
+      }
+      if ( !slice->GetSumw2N() )
+        slice->Sumw2();
+      
+      double entries = slice->GetEntries();
+      if ( error2 )
+        entries += ( sumw2[s] > 0 ? sumw[s] * sumw[s] / sumw2[s] : 0 );
+      else
+        entries += TMath::Floor( sumw[s] + 0.5 );
+      
+      Float_t* outContent = slice->GetArray();
+      Double_t* outError2 = slice->GetSumw2()->GetArray();
+      for ( int xy = 0; xy < nCellsXY; ++xy ) {
+        outContent[xy] += sliceContent[s][xy];
+        outError2[xy] += sliceError2[s][xy];
+      }
+      slice->ResetStats();
+      slice->SetEntries( entries );
+    }
+    
+    if ( spectrum ) {
+      double entries = spectrum->GetEntries() + hist->GetEntries();
+      spectrum->ResetStats();
+      spectrum->SetEntries( entries );
+    }
+  }
+  
+  
+  // ---------------------------------------------------
+  // Streaming read-in. Each file and centrality bin is a
+  // task, and the tasks are run nThreads at a time
+  // ---------------------------------------------------
+  
+  namespace {
+  
+  // maps every key name in a file to its highest cycle, so the
+  // cells can be read without a directory lookup per name
+  void BuildKeyIndex( TFile* file, std::map<std::string, TKey*>& keyIndex ) {
+    TIter nextKey( file->GetListOfKeys() );
+    TKey* key = 0;
+    while ( ( key = (TKey*) nextKey() ) ) {
+      std::map<std::string, TKey*>::iterator found = keyIndex.find( key->GetName() );
+      if ( found == keyIndex.end() || found->second->GetCycle() < key->GetCycle() )
+        keyIndex[key->GetName()] = key;
+    }
+  }
+  
+  // reads a cell through the index - the caller owns ( and deletes ) it
+  TH3F* ReadCell( std::map<std::string, TKey*>& keyIndex, std::string name ) {
+    std::map<std::string, TKey*>::iterator found = keyIndex.find( name );
+    if ( found == keyIndex.end() )
+      return 0;
+    TH3F* cell = (TH3F*) found->second->ReadObj();
+    if ( cell )
+      cell->SetDirectory( 0 );
+    return cell;
+  }
+  
+  // the output of one file and one centrality bin
+  struct reductionTask {
+    unsigned file;
+    int cent;                                 // selector.centLow ... centHigh
+    // correlations: [vz][pt], leading, subleading and the aj split
+    std::vector<std::vector<TH2F*> > lead;
+    std::vector<std::vector<TH2F*> > sub;
+    std::vector<std::vector<TH2F*> > high;
+    std::vector<std::vector<TH2F*> > low;
+    // mixing: pt slices summed over vz and aj
+    std::vector<TH2F*> leadMix;
+    std::vector<TH2F*> subMix;
+    // pt spectrum, and the weighted pt sums per pt bin
+    TH1F* ptSpectrum = 0;
+    std::vector<double> ptSumw;
+    std::vector<double> ptSumwx;
+    bool failed = false;
+  };
+  
+  // Runs every task, nThreads at a time. TFiles cant be shared between
+  // threads, so with more than one thread each task opens its own copy
+  template <typename Run>
+  bool RunReductionTasks( std::vector<TFile*>& filesIn, std::vector<reductionTask>& tasks, unsigned nThreads, Run run ) {
+    if ( nThreads <= 1 ) {
+      for ( unsigned n = 0; n < tasks.size(); ++n )
+        run( tasks[n], filesIn[tasks[n].file] );
+    }
+    else {
+      ROOT::EnableThreadSafety();
+      std::atomic<unsigned> nextTask( 0 );
+      std::vector<std::thread> threads;
+      for ( unsigned t = 0; t < nThreads; ++t ) {
+        threads.push_back( std::thread( [&]() {
+          for ( unsigned n = nextTask++; n < tasks.size(); n = nextTask++ ) {
+            TFile* file = TFile::Open( filesIn[tasks[n].file]->GetName(), "READ" );
+            if ( !file || file->IsZombie() ) {
+              __ERR( "could not open " << filesIn[tasks[n].file]->GetName() )
+              tasks[n].failed = true;
+              delete file;
+              continue;
+            }
+            run( tasks[n], file );
+            file->Close();
+            delete file;
+          }
+        } ) );
+      }
+      for ( unsigned t = 0; t < threads.size(); ++t )
+        threads[t].join();
+    }
+    
+    bool failed = false;
+    for ( unsigned n = 0; n < tasks.size(); ++n )
+      failed = failed || tasks[n].failed;
+    return !failed;
+  }
+  
+  // one task per file and centrality bin, in [file][cent] order
+  std::vector<reductionTask> BuildReductionTasks( unsigned nFiles, binSelector& selector ) {
+    unsigned nCent = selector.centHigh - selector.centLow + 1;
+    std::vector<reductionTask> tasks( nFiles * nCent );
+    for ( unsigned i = 0; i < nFiles; ++i ) {
+      for ( unsigned j = 0; j < nCent; ++j ) {
+        tasks[i*nCent + j].file = i;
+        tasks[i*nCent + j].cent = selector.centLow + j;
+      }
+    }
+    return tasks;
+  }
+  
+  // reads the event counts, as ReadInFiles does
+  bool ReadEventCounts( std::vector<TFile*>& filesIn, std::vector<TH3F*>& nEvents, std::string prefix ) {
+    for ( int i = 0; i < filesIn.size(); ++i ) {
+      nEvents.push_back( (TH3F*) filesIn[i]->Get("nevents") );
+      if ( !nEvents.back() ) {
+        __ERR( "Can't find nevents in " << filesIn[i]->GetName() )
+        return false;
+      }
+      std::string tmpName = prefix + patch::to_string(i);
+      nEvents.back()->SetName( tmpName.c_str() );
+    }
+    return true;
+  }
+  
+  // Projects every vz and aj cell of one file and centrality into
+  // the leading and subleading [vz][pt] slices, the aj split if
+  // splitAj, and the pt spectrum and sums if findCenters
+  void ReduceCorrelationTask( reductionTask& task, TFile* file, binSelector selector, bool splitAj, int ajBinSplit, bool findCenters, std::string uniqueID, std::string subUniqueID, std::string ajSplitID ) {
+    
+    // index the keys once instead of a name lookup per Get
+    std::map<std::string, TKey*> keyIndex;
+    BuildKeyIndex( file, keyIndex );
+    
+    int cent_index = task.cent - selector.centLow;
+    unsigned nVz = selector.vzHigh - selector.vzLow + 1;
+    task.lead.resize( nVz );
+    task.sub.resize( nVz );
+    if ( splitAj ) {
+      task.high.resize( nVz );
+      task.low.resize( nVz );
+    }
+    if ( findCenters ) {
+      std::string tmp = "pt_file_" + patch::to_string( task.file ) + "_cent_" + patch::to_string( cent_index );
+      task.ptSpectrum = new TH1F( tmp.c_str(), tmp.c_str(), binsPt, ptLowEdge, ptHighEdge );
+      task.ptSpectrum->SetDirectory( 0 );
+    }
+    
+    for ( int k = selector.vzLow; k <= selector.vzHigh; ++k ) {
+      int vz_index = k - selector.vzLow;
+      
+      // output names, as the Build* functions set them
+      std::string cellID = "file_" + patch::to_string( task.file ) + "_cent_" + patch::to_string(cent_index) + "_vz_" + patch::to_string(vz_index);
+      std::vector<std::string> leadNames( selector.nPtBins, uniqueID + "_corr_" + cellID );
+      std::vector<std::string> subLeadNames( selector.nPtBins, subUniqueID + "_corr_" + cellID );
+      std::vector<std::string> namesHigh( selector.nPtBins, ajSplitID + "_corr_aj_low_" + cellID );
+      std::vector<std::string> namesLow( selector.nPtBins, ajSplitID + "_corr_aj_high_" + cellID );
+      
+      task.lead[vz_index].resize( selector.nPtBins );
+      task.sub[vz_index].resize( selector.nPtBins );
+      if ( splitAj ) {
+        task.high[vz_index].resize( selector.nPtBins );
+        task.low[vz_index].resize( selector.nPtBins );
+      }
+      
+      for ( int l = selector.ajLow; l <= selector.ajHigh; ++l ) {
+        
+        std::string leadName = "lead_aj_" + patch::to_string(l) + "_cent_" + patch::to_string( task.cent ) + "_vz_" + patch::to_string(k);
+        std::string subLeadName = "sub_aj_" + patch::to_string(l) + "_cent_" + patch::to_string( task.cent ) + "_vz_" + patch::to_string(k);
+        
+        TH3F* cell = ReadCell( keyIndex, leadName );
+        if ( !cell ) {
+          __ERR("Can't find histograms - maybe it has mixing correlations not signal?")
+          task.failed = true;
+          return;
+        }
+        if ( findCenters )
+          ProjectPtSlices( cell, task.lead[vz_index], selector, leadNames, std::vector<int>(), task.ptSpectrum, &task.ptSumw, &task.ptSumwx );
+        else
+          ProjectPtSlices( cell, task.lead[vz_index], selector, leadNames );
+        if ( splitAj ) {
+          int aj_index = l - selector.ajLow;
+          if ( aj_index >= ajBinSplit )
+            ProjectPtSlices( cell, task.high[vz_index], selector, namesHigh );
+          else
+            ProjectPtSlices( cell, task.low[vz_index], selector, namesLow );
+        }
+        delete cell;
+        
+        // subleading correlations are only there for dijets
+        cell = ReadCell( keyIndex, subLeadName );
+        if ( cell ) {
+          ProjectPtSlices( cell, task.sub[vz_index], selector, subLeadNames );
+          delete cell;
+        }
+      }
+    }
+  }
+  
+  // Projects every vz and aj cell of one file and centrality into
+  // the combined mixing pt slices of the task
+  void ReduceMixingTask( reductionTask& task, TFile* file, binSelector selector, std::vector<int> ptSlice, std::string uniqueID, std::string subUniqueID ) {
+    
+    std::map<std::string, TKey*> keyIndex;
+    BuildKeyIndex( file, keyIndex );
+    
+    // per task names, the slices are renamed when they are combined
+    std::string taskID = "_mix_file_" + patch::to_string( task.file ) + "_cent_" + patch::to_string( task.cent ) + "_pt_";
+    std::vector<std::string> leadNames( 3 );
+    std::vector<std::string> subLeadNames( 3 );
+    for ( int m = 0; m < 3; ++m ) {
+      leadNames[m] = uniqueID + taskID + patch::to_string(m);
+      subLeadNames[m] = subUniqueID + taskID + patch::to_string(m);
+    }
+    task.leadMix.assign( 3, 0 );
+    task.subMix.assign( 3, 0 );
+    
+    for ( int k = selector.vzLow; k <= selector.vzHigh; ++k ) {
+      for ( int l = selector.ajLow; l <= selector.ajHigh; ++l ) {
+        
+        std::string leadName = "mix_lead_aj_" + patch::to_string(l) + "_cent_" + patch::to_string( task.cent ) + "_vz_" + patch::to_string(k);
+        std::string subLeadName = "mix_sub_aj_" + patch::to_string(l) + "_cent_" + patch::to_string( task.cent ) + "_vz_" + patch::to_string(k);
+        
+        TH3F* cell = ReadCell( keyIndex, leadName );
+        if ( !cell ) {
+          __ERR("Can't find histograms - maybe it has signal correlations not event mixing?")
+          task.failed = true;
+          return;
+        }
+        ProjectPtSlices( cell, task.leadMix, selector, leadNames, ptSlice );
+        delete cell;
+        
+        cell = ReadCell( keyIndex, subLeadName );
+        if ( cell ) {
+          ProjectPtSlices( cell, task.subMix, selector, subLeadNames, ptSlice );
+          delete cell;
+        }
+      }
+    }
+  }
+  
+  // adds a task's slice into the combined one, which
+  // takes over the first slice it is given
+  void CombineSlice( TH2F*& combined, TH2F* slice, std::string name ) {
+    if ( !slice )
+      return;
+    if ( !combined ) {
+      combined = slice;
+      combined->SetName( name.c_str() );
+      return;
+    }
+    combined->Add( slice );
+    delete slice;
+  }
+  
+  } // namespace
+  
+  // Streaming version of ReadInFiles + FindPtBinCenter + BuildSingleCorrelation
+  // ( leading and subleading ) + BuildAjSplitCorrelation: each cell is
+  // projected into all of them and deleted before the next one is read
+  int ReduceCorrelations( std::vector<TFile*>& filesIn, std::vector<std::vector<std::vector<std::vector<TH2F*> > > >& leadingCorrelations, std::vector<std::vector<std::vector<std::vector<TH2F*> > > >& subLeadingCorrelations, std::vector<std::vector<std::vector<std::vector<TH2F*> > > >* reducedCorrelationsHigh, std::vector<std::vector<std::vector<std::vector<TH2F*> > > >* reducedCorrelationsLow, int ajBinSplit, std::vector<TH3F*>& nEvents, std::vector<TH1F*>* ptSpectra, std::vector<std::vector<double> >* ptBinCenters, binSelector selector, std::string uniqueID, std::string subUniqueID, std::string ajSplitID, unsigned nThreads ) {
+    
+    bool splitAj = ( reducedCorrelationsHigh && reducedCorrelationsLow );
+    bool findCenters = ( ptSpectra || ptBinCenters );
+    unsigned nCent = selector.centHigh - selector.centLow + 1;
+    
+    if ( !ReadEventCounts( filesIn, nEvents, "corr_nevents_" ) )
+      return -1;
+    
+    __OUT( "Reducing " << filesIn.size() << " files with " << std::max( 1u, nThreads ) << " threads" )
+    std::vector<reductionTask> tasks = BuildReductionTasks( filesIn.size(), selector );
+    bool succeeded = RunReductionTasks( filesIn, tasks, nThreads, [&]( reductionTask& task, TFile* file ) {
+      ReduceCorrelationTask( task, file, selector, splitAj, ajBinSplit, findCenters, uniqueID, subUniqueID, ajSplitID );
+    } );
+    
+    // hand the slices over in [file][cent][vz][pt] order
+    for ( unsigned i = 0; i < filesIn.size(); ++i ) {
+      leadingCorrelations.push_back( std::vector<std::vector<std::vector<TH2F*> > >( nCent ) );
+      subLeadingCorrelations.push_back( std::vector<std::vector<std::vector<TH2F*> > >( nCent ) );
+      if ( splitAj ) {
+        reducedCorrelationsHigh->push_back( std::vector<std::vector<std::vector<TH2F*> > >( nCent ) );
+        reducedCorrelationsLow->push_back( std::vector<std::vector<std::vector<TH2F*> > >( nCent ) );
+      }
+      
+      TH1F* spectrum = 0;
+      if ( ptSpectra ) {
+        std::string tmp = "pt_file_" + patch::to_string(i);
+        spectrum = new TH1F( tmp.c_str(), tmp.c_str(), binsPt, ptLowEdge, ptHighEdge );
+        ptSpectra->push_back( spectrum );
+      }
+      std::vector<double> ptSumw( selector.nPtBins, 0 );
+      std::vector<double> ptSumwx( selector.nPtBins, 0 );
+      
+      for ( unsigned j = 0; j < nCent; ++j ) {
+        reductionTask& task = tasks[i*nCent + j];
+        leadingCorrelations.back()[j].swap( task.lead );
+        subLeadingCorrelations.back()[j].swap( task.sub );
+        if ( splitAj ) {
+          reducedCorrelationsHigh->back()[j].swap( task.high );
+          reducedCorrelationsLow->back()[j].swap( task.low );
+        }
+        
+        if ( task.ptSpectrum ) {
+          if ( spectrum )
+            spectrum->Add( task.ptSpectrum );
+          delete task.ptSpectrum;
+        }
+        for ( unsigned m = 0; m < task.ptSumw.size() && m < ptSumw.size(); ++m ) {
+          ptSumw[m] += task.ptSumw[m];
+          ptSumwx[m] += task.ptSumwx[m];
+        }
+      }
+      
+      if ( ptBinCenters ) {
+        ptBinCenters->push_back( std::vector<double>( selector.nPtBins, 0 ) );
+        for ( int m = 0; m < selector.nPtBins; ++m )
+          ptBinCenters->back()[m] = ( ptSumw[m] != 0 ? ptSumwx[m] / ptSumw[m] : 0 );
+      }
+    }
+    return ( succeeded ? 1 : -1 );
+  }
+  
+  // Streaming version of ReadInFilesMix + RecombineMixedEvents
+  int ReduceMixedEvents( std::vector<TFile*>& filesIn, std::vector<std::vector<TH2F*> >& leadingMix, std::vector<std::vector<TH2F*> >& subLeadingMix, std::vector<TH3F*>& nEvents, binSelector selector, std::string uniqueID, std::string subUniqueID, unsigned nThreads ) {
+    
+    // all pt bins above 2 GeV are combined
+    std::vector<int> ptSlice( selector.nPtBins );
+    for ( int m = 0; m < selector.nPtBins; ++m )
+      ptSlice[m] = std::min( m, 2 );
+    unsigned nCent = selector.centHigh - selector.centLow + 1;
+    
+    if ( !ReadEventCounts( filesIn, nEvents, "mix_nevents_" ) )
+      return -1;
+    
+    __OUT( "Reducing " << filesIn.size() << " mixing files with " << std::max( 1u, nThreads ) << " threads" )
+    std::vector<reductionTask> tasks = BuildReductionTasks( filesIn.size(), selector );
+    bool succeeded = RunReductionTasks( filesIn, tasks, nThreads, [&]( reductionTask& task, TFile* file ) {
+      ReduceMixingTask( task, file, selector, ptSlice, uniqueID, subUniqueID );
+    } );
+    
+    // the centrality bins of a file are summed
+    for ( unsigned i = 0; i < filesIn.size(); ++i ) {
+      leadingMix.push_back( std::vector<TH2F*>( 3, 0 ) );
+      subLeadingMix.push_back( std::vector<TH2F*>( 3, 0 ) );
+      for ( unsigned j = 0; j < nCent; ++j ) {
+        reductionTask& task = tasks[i*nCent + j];
+        for ( unsigned m = 0; m < task.leadMix.size(); ++m ) {
+          CombineSlice( leadingMix.back()[m], task.leadMix[m], uniqueID + "_mix_file_" + patch::to_string(i) + "_pt_" + patch::to_string(m) );
+          CombineSlice( subLeadingMix.back()[m], task.subMix[m], subUniqueID + "_mix_file_" + patch::to_string(i) + "_pt_" + patch::to_string(m) );
+        }
+      }
+    }
+    return ( succeeded ? 1 : -1 );
+  }
   
   // Function used to find the weighted center
   // for each pt bin for each file - vector<vector<double> >
@@ -227,47 +728,28 @@ namespace jetHadron {
     // make the returned object 
     std::vector<std::vector<double> > ptBinCenters;
     ptBinCenters.resize( correlations.size() );
-
-    // first we loop over all histograms, project 
-    // down to 1D and add together
     ptSpectra.resize( correlations.size() );
-    std::vector<std::vector<TH1F*> > ptBinHolder;
-    ptBinHolder.resize( correlations.size() );
-
+    
+    // no eta-phi slices are needed, only the pt sums
+    std::vector<int> noSlices( selector.nPtBins, -1 );
+    std::vector<TH2F*> unused;
+    
     for ( int i = 0; i < correlations.size(); ++i ) {
-      for  ( int j = 0; j < correlations[i].size(); ++j ) {
-        for ( int k = 0; k < correlations[i][j].size(); ++k ) {
-          for ( int l = 0; l < correlations[i][j][k].size(); ++l ) {
-            for ( int m = 0; m < selector.nPtBins; ++m ) {
-              if ( j == 0 && k == 0 && l == 0 ) {
-                ptBinHolder[i].resize(selector.nPtBins);
-                std::string tmp = "pt_file_" + patch::to_string(i);
-                if ( m == 0 )
-                  ptSpectra[i] = new TH1F( tmp.c_str(), tmp.c_str(), binsPt, ptLowEdge, ptHighEdge );
-              }
-
-              correlations[i][j][k][l]->GetZaxis()->SetRange();
-              ptSpectra[i]->Add( (TH1F*) correlations[i][j][k][l]->ProjectionZ() );
-
-              correlations[i][j][k][l]->GetZaxis()->SetRange( selector.ptBinLowEdge(m), selector.ptBinHighEdge(m) );
-              if ( !ptBinHolder[i][m] ) {
-                ptBinHolder[i][m] = ((TH1F*) ((TH1F*) correlations[i][j][k][l]->ProjectionZ())->Clone());
-                std::string tmp = uniqueID + "_pt_file_" + patch::to_string(i) + "_pt_" + patch::to_string(m);
-                ptBinHolder[i][m]->SetName( tmp.c_str() );
-              }
-              else {
-                ptBinHolder[i][m]->Add( (TH1F*) correlations[i][j][k][l]->ProjectionZ() );
-              }
-            }
-          }
-        }
-      }
+      std::string tmp = "pt_file_" + patch::to_string(i);
+      ptSpectra[i] = new TH1F( tmp.c_str(), tmp.c_str(), binsPt, ptLowEdge, ptHighEdge );
+      std::vector<double> ptSumw( selector.nPtBins, 0 );
+      std::vector<double> ptSumwx( selector.nPtBins, 0 );
+      
+      for  ( int j = 0; j < correlations[i].size(); ++j )
+        for ( int k = 0; k < correlations[i][j].size(); ++k )
+          for ( int l = 0; l < correlations[i][j][k].size(); ++l )
+            if ( correlations[i][j][k][l] )
+              ProjectPtSlices( correlations[i][j][k][l], unused, selector, std::vector<std::string>(), noSlices, ptSpectra[i], &ptSumw, &ptSumwx );
       
       // now extract the mean values
       ptBinCenters[i].resize(selector.nPtBins);
       for ( int j = 0; j < selector.nPtBins; ++j ) {
-        ptBinCenters[i][j] = ptBinHolder[i][j]->GetMean();
-        
+        ptBinCenters[i][j] = ( ptSumw[j] != 0 ? ptSumwx[j] / ptSumw[j] : 0 );
       }
     }
     
@@ -289,22 +771,14 @@ namespace jetHadron {
         reducedCorrelations[i][j].resize(correlations[i][j].size() );
         for ( int k = 0; k < correlations[i][j].size(); ++k ) {
           reducedCorrelations[i][j][k].resize( selector.nPtBins );
-          for ( int l = 0; l < correlations[i][j][k].size(); ++l ) {
-            for ( int m = 0; m < selector.nPtBins; ++m ) {
-              
-              // select proper pt range
-              correlations[i][j][k][l]->GetZaxis()->SetRange( selector.ptBinLowEdge(m), selector.ptBinHighEdge(m) );
-              
-              if ( !reducedCorrelations[i][j][k][m] ) {
-                std::string tmp = uniqueID + "_corr_file_" + patch::to_string(i) + "_cent_" + patch::to_string(j) + "_vz_" + patch::to_string(k);
-                reducedCorrelations[i][j][k][m] = (TH2F*) ((TH2F*) correlations[i][j][k][l]->Project3D("YX"))->Clone();
-                reducedCorrelations[i][j][k][m]->SetName( tmp.c_str() );
-              }
-              else {
-                reducedCorrelations[i][j][k][m]->Add( (TH2F*) correlations[i][j][k][l]->Project3D("YX") );
-              }
-            }
-          }
+          
+          std::string tmp = uniqueID + "_corr_file_" + patch::to_string(i) + "_cent_" + patch::to_string(j) + "_vz_" + patch::to_string(k);
+          std::vector<std::string> names( selector.nPtBins, tmp );
+          
+          // all pt bins are projected in one pass
+          for ( int l = 0; l < correlations[i][j][k].size(); ++l )
+            if ( correlations[i][j][k][l] )
+              ProjectPtSlices( correlations[i][j][k][l], reducedCorrelations[i][j][k], selector, names );
         }
       }
     }
@@ -325,33 +799,18 @@ namespace jetHadron {
         for ( int k = 0; k < correlations[i][j].size(); ++k ) {
           reducedCorrelationsHigh[i][j][k].resize( selector.nPtBins );
           reducedCorrelationsLow[i][j][k].resize( selector.nPtBins );
+          
+          std::string cellID = "file_" + patch::to_string(i) + "_cent_" + patch::to_string(j) + "_vz_" + patch::to_string(k);
+          std::vector<std::string> namesHigh( selector.nPtBins, uniqueID + "_corr_aj_low_" + cellID );
+          std::vector<std::string> namesLow( selector.nPtBins, uniqueID + "_corr_aj_high_" + cellID );
+          
           for ( int l = 0; l < correlations[i][j][k].size(); ++l ) {
-            for ( int m = 0; m < selector.nPtBins; ++m ) {
-              
-              // select proper pt range
-              correlations[i][j][k][l]->GetZaxis()->SetRange( selector.ptBinLowEdge(m), selector.ptBinHighEdge(m) );
-              if ( l >= ajBinSplit ) {
-                if ( !reducedCorrelationsHigh[i][j][k][m] ) {
-                  std::string tmp = uniqueID +"_corr_aj_low_file_" + patch::to_string(i) + "_cent_" + patch::to_string(j) + "_vz_" + patch::to_string(k);
-                  reducedCorrelationsHigh[i][j][k][m] = (TH2F*) ((TH2F*) correlations[i][j][k][l]->Project3D("YX"))->Clone();
-                  reducedCorrelationsHigh[i][j][k][m]->SetName( tmp.c_str() );
-                }
-                else {
-                  reducedCorrelationsHigh[i][j][k][m]->Add( (TH2F*) correlations[i][j][k][l]->Project3D("YX") );
-                }
-              }
-              else {
-                if ( !reducedCorrelationsLow[i][j][k][m] ) {
-                  std::string tmp = uniqueID + "_corr_aj_high_file_" + patch::to_string(i) + "_cent_" + patch::to_string(j) + "_vz_" + patch::to_string(k);
-                  reducedCorrelationsLow[i][j][k][m] = (TH2F*) ((TH2F*) correlations[i][j][k][l]->Project3D("YX"))->Clone();
-                  reducedCorrelationsLow[i][j][k][m]->SetName( tmp.c_str() );
-                }
-                else {
-                  reducedCorrelationsLow[i][j][k][m]->Add( (TH2F*) correlations[i][j][k][l]->Project3D("YX") );
-                }
-              }
-              
-            }
+            if ( !correlations[i][j][k][l] )
+              continue;
+            if ( l >= ajBinSplit )
+              ProjectPtSlices( correlations[i][j][k][l], reducedCorrelationsHigh[i][j][k], selector, namesHigh );
+            else
+              ProjectPtSlices( correlations[i][j][k][l], reducedCorrelationsLow[i][j][k], selector, namesLow );
           }
         }
       }
@@ -412,22 +871,14 @@ namespace jetHadron {
         finalMixedEvents[i][j].resize( mixedEvents[i][j].size() );
         for ( int k = 0; k < mixedEvents[i][j].size(); ++k ) {
           finalMixedEvents[i][j][k].resize( selector.nPtBins );
-          for ( int l = 0; l < mixedEvents[i][j][k].size(); ++l ) {
-            for ( int m = 0; m < selector.nPtBins; ++m ){
-              
-              // select the proper pt range for each histogram
-              mixedEvents[i][j][k][l]->GetZaxis()->SetRange( selector.ptBinLowEdge(m), selector.ptBinHighEdge(m) );
-              
-              if ( !finalMixedEvents[i][j][k][m] ) {
-                finalMixedEvents[i][j][k][m] = (TH2F*) ((TH2F*) mixedEvents[i][j][k][l]->Project3D("YX"))->Clone();
-                std::string tmp = uniqueID + "_mix_file_" + patch::to_string(i) + "_cent_" + patch::to_string(j) + "_vz_" + patch::to_string(k) + "_pt_" + patch::to_string(m);
-                finalMixedEvents[i][j][k][m]->SetName( tmp.c_str() );
-              }
-              else {
-                finalMixedEvents[i][j][k][m]->Add( (TH2F*) mixedEvents[i][j][k][l]->Project3D("YX") );
-              }
-            }
-          }
+          
+          std::vector<std::string> names( selector.nPtBins );
+          for ( int m = 0; m < selector.nPtBins; ++m )
+            names[m] = uniqueID + "_mix_file_" + patch::to_string(i) + "_cent_" + patch::to_string(j) + "_vz_" + patch::to_string(k) + "_pt_" + patch::to_string(m);
+          
+          for ( int l = 0; l < mixedEvents[i][j][k].size(); ++l )
+            if ( mixedEvents[i][j][k][l] )
+              ProjectPtSlices( mixedEvents[i][j][k][l], finalMixedEvents[i][j][k], selector, names );
         }
       }
     }
@@ -444,40 +895,23 @@ namespace jetHadron {
     std::vector<std::vector<TH2F*> > combinedMixedEvents;
     combinedMixedEvents.resize( mixedEvents.size() );
     
+    // all pt bins above 2 GeV are combined
+    std::vector<int> ptSlice( selector.nPtBins );
+    for ( int m = 0; m < selector.nPtBins; ++m )
+      ptSlice[m] = std::min( m, 2 );
+    
     for ( int i = 0; i < mixedEvents.size(); ++i ) {
       combinedMixedEvents[i].resize( 3 );
       
-      for ( int j = 0; j < mixedEvents[i].size(); ++j ) {
-        for ( int k = 0; k < mixedEvents[i][j].size(); ++k ) {
-          for ( int l = 0; l < mixedEvents[i][j][k].size(); ++l ) {
-            for ( int m = 0; m < selector.nPtBins; ++m ) {
-              
-              mixedEvents[i][j][k][l]->GetZaxis()->SetRange( selector.ptBinLowEdge(m), selector.ptBinHighEdge(m) );
-              
-              if ( m <= 2 ) {
-                if ( !combinedMixedEvents[i][m] ) {
-                  combinedMixedEvents[i][m] = (TH2F*) ((TH2F*) mixedEvents[i][j][k][l]->Project3D("YX"))->Clone();
-                  std::string tmp = uniqueID + "_mix_file_" + patch::to_string(i) + "_pt_" + patch::to_string(m);
-                  combinedMixedEvents[i][m]->SetName( tmp.c_str() );
-                }
-                else {
-                  combinedMixedEvents[i][m]->Add( (TH2F*) mixedEvents[i][j][k][l]->Project3D("YX") );
-                }
-              }
-              else {
-                if ( !combinedMixedEvents[i][2] ) {
-                  combinedMixedEvents[i][2] = (TH2F*) ((TH2F*) mixedEvents[i][j][k][l]->Project3D("YX"))->Clone();
-                  std::string tmp = uniqueID + "_mix_file_" + patch::to_string(i) + "_pt_" + patch::to_string(m);
-                  combinedMixedEvents[i][2]->SetName( tmp.c_str() );
-                }
-                else {
-                  combinedMixedEvents[i][2]->Add( (TH2F*) mixedEvents[i][j][k][l]->Project3D("YX") );
-                }
-              }
-            }
-          }
-        }
-      }
+      std::vector<std::string> names( 3 );
+      for ( int m = 0; m < 3; ++m )
+        names[m] = uniqueID + "_mix_file_" + patch::to_string(i) + "_pt_" + patch::to_string(m);
+      
+      for ( int j = 0; j < mixedEvents[i].size(); ++j )
+        for ( int k = 0; k < mixedEvents[i][j].size(); ++k )
+          for ( int l = 0; l < mixedEvents[i][j][k].size(); ++l )
+            if ( mixedEvents[i][j][k][l] )
+              ProjectPtSlices( mixedEvents[i][j][k][l], combinedMixedEvents[i], selector, names, ptSlice );
     }
     
     return combinedMixedEvents;
@@ -491,41 +925,25 @@ namespace jetHadron {
     std::vector<std::vector<std::vector<TH2F*> > > combinedMixedEvents;
     combinedMixedEvents.resize( mixedEvents.size() );
     
+    // all pt bins above 2 GeV are combined
+    std::vector<int> ptSlice( selector.nPtBins );
+    for ( int m = 0; m < selector.nPtBins; ++m )
+      ptSlice[m] = std::min( m, 2 );
+    
     for ( int i = 0; i < mixedEvents.size(); ++i ) {
       combinedMixedEvents[i].resize( mixedEvents[i].size() );
       
       for ( int j = 0; j < mixedEvents[i].size(); ++j ) {
         combinedMixedEvents[i][j].resize( 3 );
         
-        for ( int k = 0; k < mixedEvents[i][j].size(); ++k ) {
-          for ( int l = 0; l < mixedEvents[i][j][k].size(); ++l ) {
-            for ( int m = 0; m < selector.nPtBins; ++m ) {
-              
-              mixedEvents[i][j][k][l]->GetZaxis()->SetRange( selector.ptBinLowEdge(m), selector.ptBinHighEdge(m) );
-              
-              if ( m <= 2 ) {
-                if ( !combinedMixedEvents[i][j][m] ) {
-                  combinedMixedEvents[i][j][m] = (TH2F*) ((TH2F*) mixedEvents[i][j][k][l]->Project3D("YX"))->Clone();
-                  std::string tmp = uniqueID + "_mix_file_" + patch::to_string(i) + "_cent_" + patch::to_string(j) + "_pt_" + patch::to_string(m);
-                  combinedMixedEvents[i][j][m]->SetName( tmp.c_str() );
-                }
-                else {
-                  combinedMixedEvents[i][j][m]->Add( (TH2F*) mixedEvents[i][j][k][l]->Project3D("YX") );
-                }
-              }
-              else {
-                if ( !combinedMixedEvents[i][j][2] ) {
-                  combinedMixedEvents[i][j][2] = (TH2F*) ((TH2F*) mixedEvents[i][j][k][l]->Project3D("YX"))->Clone();
-                  std::string tmp = uniqueID + "_mix_file_" + patch::to_string(i) + "_cent_" + patch::to_string(j) + "_pt_" + patch::to_string(m);
-                  combinedMixedEvents[i][j][2]->SetName( tmp.c_str() );
-                }
-                else {
-                  combinedMixedEvents[i][j][2]->Add( (TH2F*) mixedEvents[i][j][k][l]->Project3D("YX") );
-                }
-              }
-            }
-          }
-        }
+        std::vector<std::string> names( 3 );
+        for ( int m = 0; m < 3; ++m )
+          names[m] = uniqueID + "_mix_file_" + patch::to_string(i) + "_cent_" + patch::to_string(j) + "_pt_" + patch::to_string(m);
+        
+        for ( int k = 0; k < mixedEvents[i][j].size(); ++k )
+          for ( int l = 0; l < mixedEvents[i][j][k].size(); ++l )
+            if ( mixedEvents[i][j][k][l] )
+              ProjectPtSlices( mixedEvents[i][j][k][l], combinedMixedEvents[i][j], selector, names, ptSlice );
       }
     }
 
@@ -603,7 +1021,7 @@ namespace jetHadron {
               if ( correlations[i][j][k][l]->GetEntries() && mixedEvents[i][j][k][l]->GetEntries() ) {
                 TH2F* hTmp = ((TH2F*) correlations[i][j][k][l]->Clone());
                 hTmp->Divide( mixedEvents[i][j][k][l] );
-                correctedCorrelations[i][l] = (TH2F*) hTmp->Clone();
+                correctedCorrelations[i][l] = hTmp;
                 correctedCorrelations[i][l]->SetName( tmp.c_str() );
               }
             }
@@ -612,6 +1030,7 @@ namespace jetHadron {
                 TH2F* hTmp = ((TH2F*) correlations[i][j][k][l]->Clone());
                 hTmp->Divide( mixedEvents[i][j][k][l] );
                 correctedCorrelations[i][l]->Add( hTmp );
+                delete hTmp;
               }
             }
           }
@@ -654,9 +1073,10 @@ namespace jetHadron {
                 }
                 else {
                   __ERR("Did not have any mixed event data to correct with")
+                  delete hTmp;
                   continue;
                 }
-                correctedCorrelations[i][l] = (TH2F*) hTmp->Clone();
+                correctedCorrelations[i][l] = hTmp;
                 correctedCorrelations[i][l]->SetName( tmp.c_str() );
               }
             }
@@ -671,9 +1091,11 @@ namespace jetHadron {
                 }
                 else {
                   __ERR("Did not have any mixed event data to correct with")
+                  delete hTmp;
                   continue;
                 }
                 correctedCorrelations[i][l]->Add( hTmp );
+                delete hTmp;
               }
             }
           }
@@ -716,9 +1138,10 @@ namespace jetHadron {
                 }
                 else {
                   __ERR("Did not have any mixed event data to correct with")
+                  delete hTmp;
                   continue;
                 }
-                correctedCorrelations[i][l] = (TH2F*) hTmp->Clone();
+                correctedCorrelations[i][l] = hTmp;
                 correctedCorrelations[i][l]->SetName( tmp.c_str() );
               }
             }
@@ -733,9 +1156,11 @@ namespace jetHadron {
                 }
                 else {
                   __ERR("Did not have any mixed event data to correct with")
+                  delete hTmp;
                   continue;
                 }
                 correctedCorrelations[i][l]->Add( hTmp );
+                delete hTmp;
               }
             }
           }
@@ -841,15 +1266,18 @@ namespace jetHadron {
         
         // build the subtraction histogram
         correlation2d[i][j]->GetXaxis()->SetRange( region1Low, region1High );
-        TH1F* sub_tmp = (TH1F*) ((TH1F*)  correlation2d[i][j]->ProjectionY())->Clone();
+        TH1F* sub_tmp = (TH1F*) correlation2d[i][j]->ProjectionY( ( tmp + "_sub" ).c_str() );
         correlation2d[i][j]->GetXaxis()->SetRange( region3Low, region3High );
-        sub_tmp->Add( (TH1F*) correlation2d[i][j]->ProjectionY() );
+        TH1F* sub_tmp_far = (TH1F*) correlation2d[i][j]->ProjectionY( ( tmp + "_sub_far" ).c_str() );
+        sub_tmp->Add( sub_tmp_far );
+        delete sub_tmp_far;
         
         // scale the subtraction histogram by the relative number of bins
         sub_tmp->Scale( (region2High-region2Low + 1 )/( (region1High-region1Low + 1 ) + (region3High - region3Low + 1 ) ) );
         
         // subtract
         projections[i][j]->Add( sub_tmp, -1 );
+        delete sub_tmp;
         
       }
     }
@@ -1006,15 +1434,18 @@ namespace jetHadron {
         
         // build the subtraction histogram
         correlation2d[i][j]->GetXaxis()->SetRange( region1Low, region1High );
-        TH1F* sub_tmp = (TH1F*) ((TH1F*)  correlation2d[i][j]->ProjectionY())->Clone();
+        TH1F* sub_tmp = (TH1F*) correlation2d[i][j]->ProjectionY( ( tmp + "_sub" ).c_str() );
         correlation2d[i][j]->GetXaxis()->SetRange( region3Low, region3High );
-        sub_tmp->Add( (TH1F*) correlation2d[i][j]->ProjectionY() );
+        TH1F* sub_tmp_far = (TH1F*) correlation2d[i][j]->ProjectionY( ( tmp + "_sub_far" ).c_str() );
+        sub_tmp->Add( sub_tmp_far );
+        delete sub_tmp_far;
         
         // scale the subtraction histogram by the relative number of bins
         sub_tmp->Scale( (region2High-region2Low + 1 )/( (region1High-region1Low + 1 ) + (region3High - region3Low + 1 ) ) );
         
         // subtract
         projections[i][j]->Add( sub_tmp, -1 );
+        delete sub_tmp;
         
       }
     }
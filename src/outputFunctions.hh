@@ -222,8 +222,26 @@ namespace jetHadron {
   // vz bin range, and aj ranges passed in via binSelector
   int ReadInFiles(std::vector<TFile*>& filesIn, std::vector<std::vector<std::vector<std::vector<TH3F*> > > >& leadingCorrelations, std::vector<std::vector<std::vector<std::vector<TH3F*> > > >& subLeadingCorrelations, std::vector<TH3F*>& nEvents, binSelector selector, std::string uniqueID = "" );
   int ReadInFilesMix(std::vector<TFile*>& filesIn, std::vector<std::vector<std::vector<std::vector<TH3F*> > > >& leadingMix, std::vector<std::vector<std::vector<std::vector<TH3F*> > > >& subLeadingMix, std::vector<TH3F*>& nEvents, binSelector selector, std::string uniqueID = "" );
+
   
-  
+  // Projects a TH3F onto eta-phi for every pt bin in a single pass over its
+  // bin array, adding into slices[ptSlice[m]] ( slices[m] by default, a negative
+  // index skips that pt bin ). Errors are propagated and x, y under/overflow kept,
+  // as Project3D("YX") does. Missing slices are built with the binning of hist
+  // and named names[index]. If given, the full pt projection is added to spectrum,
+  // and the sums of weight and weight*pt per pt bin to ptSumw and ptSumwx
+  void ProjectPtSlices( TH3F* hist, std::vector<TH2F*>& slices, binSelector& selector, std::vector<std::string> names, std::vector<int> ptSlice = std::vector<int>(), TH1F* spectrum = 0, std::vector<double>* ptSumw = 0, std::vector<double>* ptSumwx = 0 );
+  
+  // Streaming versions of the read-in and reduction: each ( file, cent, vz )
+  // cell is read, projected into every pt binned output it feeds, and deleted
+  // before the next is read, so memory is bounded by the output rather than
+  // the input. ReduceCorrelations replaces ReadInFiles + FindPtBinCenter +
+  // BuildSingleCorrelation ( leading and subleading ) + BuildAjSplitCorrelation -
+  // pass null for the aj split or pt spectrum holders to skip them.
+  // ReduceMixedEvents replaces ReadInFilesMix + RecombineMixedEvents.
+  // The files are split by centrality bin, and nThreads bins are read at once
+  int ReduceCorrelations( std::vector<TFile*>& filesIn, std::vector<std::vector<std::vector<std::vector<TH2F*> > > >& leadingCorrelations, std::vector<std::vector<std::vector<std::vector<TH2F*> > > >& subLeadingCorrelations, std::vector<std::vector<std::vector<std::vector<TH2F*> > > >* reducedCorrelationsHigh, std::vector<std::vector<std::vector<std::vector<TH2F*> > > >* reducedCorrelationsLow, int ajBinSplit, std::vector<TH3F*>& nEvents, std::vector<TH1F*>* ptSpectra, std::vector<std::vector<double> >* ptBinCenters, binSelector selector, std::string uniqueID = "", std::string subUniqueID = "sub", std::string ajSplitID = "", unsigned nThreads = 1 );
+  int ReduceMixedEvents( std::vector<TFile*>& filesIn, std::vector<std::vector<TH2F*> >& leadingMix, std::vector<std::vector<TH2F*> >& subLeadingMix, std::vector<TH3F*>& nEvents, binSelector selector, std::string uniqueID = "", std::string subUniqueID = "sub", unsigned nThreads = 1 );
   // Function used to find the weighted center
   // for each pt bin for each file - vector<vector<double> >
   // and also creates pt spectra for each file
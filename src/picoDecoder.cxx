@@ -0,0 +1,380 @@
+// Reads TStarJetPico JetTrees into flat arrays
+// Nick Elsey
+
+#include "picoDecoder.hh"
+
+#include "TLeaf.h"
+#include "TArrayI.h"
+
+#include <fstream>
+#include <cmath>
+
+namespace jetHadron {
+
+  namespace {
+
+    // TStarJetPico layout: the event branch, and the leaves of its
+    // split track and tower TClonesArrays
+    const std::string eventBranchName   = "PicoJetTree";
+    const std::string trackCountName    = "fPrimaryTracks";
+    const std::string towerCountName    = "fTowers";
+    const std::string towerMatchedName  = "fTowers.fMatchedTracks";
+
+    // tracks are given the pion mass, as in the benchmark events
+    const double pionMass = 0.13957;
+    // highest BEMC tower id
+    const int maxTowerId = 4800;
+
+    template <typename In, typename Out>
+    void CopyAs( const char* data, Out* out, unsigned n ) {
+      const In* in = (const In*) data;
+      for ( unsigned i = 0; i < n; ++i )
+        out[i] = in[i];
+    }
+
+  }
+
+  void picoEventArrays::Clear() {
+    px.clear();
+    py.clear();
+    pz.clear();
+    e.clear();
+    charge.clear();
+    nTracks = 0;
+  }
+
+  // picoColumn
+  // ---------------------------------------------------------------------
+  picoColumn::picoColumn() : chain(0), branch(0), type(columnFloat), typeSize(sizeof(Float_t)) { }
+
+  bool picoColumn::Bind( TChain* chainIn, std::string leafName, unsigned capacity ) {
+    chain = chainIn;
+    name = leafName;
+    TLeaf* leaf = chain->GetLeaf( name.c_str() );
+    if ( !leaf ) {
+      __ERR( "no leaf " << name << " in the input" )
+      return false;
+    }
+
+    // MakeClass mode reads Double32_t into a Double_t, Float16_t into a Float_t
+    std::string typeName = leaf->GetTypeName();
+    if ( typeName == "Float_t" || typeName == "Float16_t" )   { type = columnFloat;  typeSize = sizeof(Float_t); }
+    else if ( typeName == "Double_t" || typeName == "Double32_t" ) { type = columnDouble; typeSize = sizeof(Double_t); }
+    else if ( typeName == "Int_t" )                           { type = columnInt;    typeSize = sizeof(Int_t); }
+    else if ( typeName == "UInt_t" )                          { type = columnUInt;   typeSize = sizeof(UInt_t); }
+    else if ( typeName == "Short_t" )                         { type = columnShort;  typeSize = sizeof(Short_t); }
+    else if ( typeName == "UShort_t" )                        { type = columnUShort; typeSize = sizeof(UShort_t); }
+    else if ( typeName == "Char_t" || typeName == "Bool_t" )  { type = columnChar;   typeSize = sizeof(Char_t); }
+    else if ( typeName == "UChar_t" )                         { type = columnUChar;  typeSize = sizeof(UChar_t); }
+    else {
+      __ERR( "leaf " << name << " has unsupported type " << typeName )
+      return false;
+    }
+
+    chain->SetBranchStatus( name.c_str(), 1 );
+    buffer.clear();
+    Reserve( capacity );
+    return branch != 0;
+  }
+
+  void picoColumn::Reserve( unsigned capacity ) {
+    if ( buffer.size() >= capacity * typeSize && branch )
+      return;
+    buffer.resize( capacity * typeSize );
+    chain->SetBranchAddress( name.c_str(), &buffer[0], &branch );
+  }
+
+  template <typename T>
+  void picoColumn::Convert( T* out, unsigned n ) const {
+    const char* data = &buffer[0];
+    switch ( type ) {
+      case columnFloat:   CopyAs<Float_t>( data, out, n );  break;
+      case columnDouble:  CopyAs<Double_t>( data, out, n ); break;
+      case columnInt:     CopyAs<Int_t>( data, out, n );    break;
+      case columnUInt:    CopyAs<UInt_t>( data, out, n );   break;
+      case columnShort:   CopyAs<Short_t>( data, out, n );  break;
+      case columnUShort:  CopyAs<UShort_t>( data, out, n ); break;
+      case columnChar:    CopyAs<Char_t>( data, out, n );   break;
+      case columnUChar:   CopyAs<UChar_t>( data, out, n );  break;
+    }
+  }
+
+  void picoColumn::ToFloat( std::vector<float>& out, unsigned n ) const {
+    out.resize( n );
+    if ( n )
+      Convert( &out[0], n );
+  }
+
+  void picoColumn::ToInt( std::vector<int>& out, unsigned n ) const {
+    out.resize( n );
+    if ( n )
+      Convert( &out[0], n );
+  }
+
+  // picoDecoder
+  // ---------------------------------------------------------------------
+  picoDecoder::picoDecoder() : headerChain(0), arrayChain(0), event(0), softwareTrigger(0), nEntries(0), currentEntry(-1), nTracksRead(0), nTowersRead(0), trackCountBranch(0), towerCountBranch(0), capacityTracks(2000), capacityTowers(maxTowerId), towerMatchedBranch(0) { }
+
+  picoDecoder::~picoDecoder() {
+    delete headerChain;
+    delete arrayChain;
+    delete event;
+  }
+
+  bool picoDecoder::Init( TChain* chain, std::string collisionType, std::string triggerString, double softwareTriggerIn ) {
+
+    std::transform(collisionType.begin(), collisionType.end(), collisionType.begin(), ::tolower);
+
+    // the header and trigger objects: read as objects, the
+    // event cuts need a TStarJetPicoEvent
+    headerChain = new TChain( chain->GetName() );
+    headerChain->Add( chain );
+    event = new TStarJetPicoEvent();
+    headerChain->SetBranchStatus( "*", 0 );
+    headerChain->SetBranchStatus( "fHeader*", 1 );
+    headerChain->SetBranchStatus( "fTrigObjs*", 1 );
+    headerChain->SetBranchAddress( eventBranchName.c_str(), &event );
+
+    // the software trigger needs the towers, so it is applied here
+    // along with the max pt and et cuts, not by eventCuts
+    InitEventCuts( &eventCuts, collisionType, triggerString, 0 );
+    softwareTrigger = softwareTriggerIn;
+
+    // tracks and towers: flat arrays
+    arrayChain = new TChain( chain->GetName() );
+    arrayChain->Add( chain );
+    arrayChain->SetMakeClass( 1 );
+    arrayChain->SetBranchStatus( "*", 0 );
+    arrayChain->SetBranchStatus( trackCountName.c_str(), 1 );
+    arrayChain->SetBranchStatus( towerCountName.c_str(), 1 );
+    arrayChain->SetBranchAddress( trackCountName.c_str(), &nTracksRead, &trackCountBranch );
+    arrayChain->SetBranchAddress( towerCountName.c_str(), &nTowersRead, &towerCountBranch );
+
+    bool bound = true;
+    bound = trackPx.Bind( arrayChain, trackCountName + ".fPx", capacityTracks ) && bound;
+    bound = trackPy.Bind( arrayChain, trackCountName + ".fPy", capacityTracks ) && bound;
+    bound = trackPz.Bind( arrayChain, trackCountName + ".fPz", capacityTracks ) && bound;
+    bound = trackDCA.Bind( arrayChain, trackCountName + ".fDCA", capacityTracks ) && bound;
+    bound = trackNFit.Bind( arrayChain, trackCountName + ".fNOfFittedHits", capacityTracks ) && bound;
+    bound = trackNPoss.Bind( arrayChain, trackCountName + ".fNOfPossHits", capacityTracks ) && bound;
+    bound = trackCharge.Bind( arrayChain, trackCountName + ".fCharge", capacityTracks ) && bound;
+    bound = towerId.Bind( arrayChain, towerCountName + ".fId", capacityTowers ) && bound;
+    bound = towerEnergy.Bind( arrayChain, towerCountName + ".fEnergy", capacityTowers ) && bound;
+    bound = towerEta.Bind( arrayChain, towerCountName + ".fEtaCorrected", capacityTowers ) && bound;
+    bound = towerPhi.Bind( arrayChain, towerCountName + ".fPhiCorrected", capacityTowers ) && bound;
+    if ( hadronicCorrection ) {
+      towerMatched.resize( capacityTowers );
+      arrayChain->SetBranchStatus( towerMatchedName.c_str(), 1 );
+      arrayChain->SetBranchAddress( towerMatchedName.c_str(), &towerMatched[0], &towerMatchedBranch );
+    }
+    if ( !bound || !trackCountBranch || !towerCountBranch || ( hadronicCorrection && !towerMatchedBranch ) ) {
+      __ERR( "input is not a TStarJetPico JetTree with split tracks and towers" )
+      return false;
+    }
+
+    // same bad tower lists as InitReader
+    badTower.assign( maxTowerId + 1, 0 );
+    if ( collisionType == "auau" || collisionType == "pp" ) {
+      LoadBadTowers( y7AuAuTowerList );
+      LoadBadTowers( y6PPTowerList );
+    }
+    else
+      __ERR("unknown collision system")
+
+    nEntries = headerChain->GetEntries();
+    currentEntry = -1;
+    return true;
+  }
+
+  // the lists are tower ids, separated by spaces or commas
+  bool picoDecoder::LoadBadTowers( std::string towerList ) {
+    std::ifstream list( towerList.c_str() );
+    if ( !list.is_open() ) {
+      __ERR( "Could not open bad tower list " << towerList )
+      return false;
+    }
+    std::string token;
+    while ( list >> token ) {
+      std::replace( token.begin(), token.end(), ',', ' ' );
+      std::istringstream ids( token );
+      int id;
+      while ( ids >> id )
+        if ( id >= 0 && id <= maxTowerId )
+          badTower[id] = 1;
+    }
+    return true;
+  }
+
+  bool picoDecoder::ReadEvent( Long64_t entry ) {
+    arrays.Clear();
+    currentEntry = entry;
+    if ( entry < 0 || entry >= nEntries )
+      return false;
+
+    // event level cuts first, so rejected events never read the arrays
+    if ( headerChain->GetEntry( entry ) <= 0 )
+      return false;
+    if ( !eventCuts.IsEventOK( event, headerChain ) )
+      return false;
+
+    Long64_t localEntry = arrayChain->LoadTree( entry );
+    if ( localEntry < 0 )
+      return false;
+
+    // grow the buffers before reading, if this event needs it
+    trackCountBranch->GetEntry( localEntry );
+    towerCountBranch->GetEntry( localEntry );
+    unsigned nTracks = std::max( nTracksRead, 0 );
+    unsigned nTowers = std::max( nTowersRead, 0 );
+    if ( nTracks > capacityTracks ) {
+      capacityTracks = 2 * nTracks;
+      trackPx.Reserve( capacityTracks );
+      trackPy.Reserve( capacityTracks );
+      trackPz.Reserve( capacityTracks );
+      trackDCA.Reserve( capacityTracks );
+      trackNFit.Reserve( capacityTracks );
+      trackNPoss.Reserve( capacityTracks );
+      trackCharge.Reserve( capacityTracks );
+    }
+    if ( nTowers > capacityTowers ) {
+      capacityTowers = 2 * nTowers;
+      towerId.Reserve( capacityTowers );
+      towerEnergy.Reserve( capacityTowers );
+      towerEta.Reserve( capacityTowers );
+      towerPhi.Reserve( capacityTowers );
+      if ( hadronicCorrection ) {
+        towerMatched.resize( capacityTowers );
+        arrayChain->SetBranchAddress( towerMatchedName.c_str(), &towerMatched[0], &towerMatchedBranch );
+      }
+    }
+
+    trackPx.Read( localEntry );
+    trackPy.Read( localEntry );
+    trackPz.Read( localEntry );
+    trackDCA.Read( localEntry );
+    trackNFit.Read( localEntry );
+    trackNPoss.Read( localEntry );
+    trackCharge.Read( localEntry );
+    towerId.Read( localEntry );
+    towerEnergy.Read( localEntry );
+    towerEta.Read( localEntry );
+    towerPhi.Read( localEntry );
+    if ( hadronicCorrection )
+      towerMatchedBranch->GetEntry( localEntry );
+
+    trackPx.ToFloat( px, nTracks );
+    trackPy.ToFloat( py, nTracks );
+    trackPz.ToFloat( pz, nTracks );
+    trackDCA.ToFloat( dca, nTracks );
+    trackNFit.ToFloat( nFit, nTracks );
+    trackNPoss.ToFloat( nPoss, nTracks );
+    trackCharge.ToInt( charge, nTracks );
+    towerId.ToInt( id, nTowers );
+    towerEnergy.ToFloat( energy, nTowers );
+    towerEta.ToFloat( eta, nTowers );
+    towerPhi.ToFloat( phi, nTowers );
+
+    // track cuts, as one mask over the arrays
+    const float dcaCut = DCACut;
+    const float fitPoints = minFitPoints;
+    const float fitFrac = minFitFrac;
+    const float trackPt2Cut = trackPtCut * trackPtCut;
+    pt2.resize( nTracks );
+    trackMask.resize( nTracks );
+    for ( unsigned i = 0; i < nTracks; ++i ) {
+      pt2[i] = px[i]*px[i] + py[i]*py[i];
+      trackMask[i] = ( dca[i] <= dcaCut ) & ( nFit[i] >= fitPoints ) & ( nFit[i] >= fitFrac * nPoss[i] ) & ( pt2[i] <= trackPt2Cut );
+    }
+
+    // max track pt cut on the event
+    float maxPt2 = 0;
+    for ( unsigned i = 0; i < nTracks; ++i )
+      maxPt2 = std::max( maxPt2, trackMask[i] ? pt2[i] : 0.0f );
+    if ( maxPt2 > eventPtCut * eventPtCut )
+      return false;
+
+    // tower cuts: bad towers and the tower Et cut, then the max Et
+    // cut and the software trigger on the good towers
+    towerMask.resize( nTowers );
+    float maxEt = 0;
+    for ( unsigned i = 0; i < nTowers; ++i ) {
+      float et = energy[i] / std::cosh( eta[i] );
+      bool known = id[i] >= 0 && id[i] <= maxTowerId;
+      towerMask[i] = known && !badTower[id[i]] && et <= towerEtCut;
+      if ( towerMask[i] )
+        maxEt = std::max( maxEt, et );
+    }
+    if ( maxEt > eventEtCut )
+      return false;
+    if ( softwareTrigger && maxEt < softwareTrigger )
+      return false;
+
+    // good tracks go straight to the output
+    for ( unsigned i = 0; i < nTracks; ++i ) {
+      if ( !trackMask[i] )
+        continue;
+      float p2 = pt2[i] + pz[i]*pz[i];
+      arrays.px.push_back( px[i] );
+      arrays.py.push_back( py[i] );
+      arrays.pz.push_back( pz[i] );
+      arrays.e.push_back( std::sqrt( p2 + pionMass*pionMass ) );
+      arrays.charge.push_back( charge[i] );
+    }
+    arrays.nTracks = arrays.Size();
+
+    // towers: subtract the matched good tracks' momentum, using
+    // the tower to track index
+    for ( unsigned i = 0; i < nTowers; ++i ) {
+      if ( !towerMask[i] )
+        continue;
+      float towerE = energy[i];
+      if ( hadronicCorrection ) {
+        const TArrayI& matched = towerMatched[i];
+        float matchedP = 0;
+        for ( int j = 0; j < matched.GetSize(); ++j ) {
+          int track = matched[j];
+          if ( track >= 0 && track < (int) nTracks && trackMask[track] )
+            matchedP += std::sqrt( pt2[track] + pz[track]*pz[track] );
+        }
+        towerE -= hadronicCorrectionFraction * matchedP;
+      }
+      if ( towerE <= 0 )
+        continue;
+      float towerPt = towerE / std::cosh( eta[i] );
+      arrays.px.push_back( towerPt * std::cos( phi[i] ) );
+      arrays.py.push_back( towerPt * std::sin( phi[i] ) );
+      arrays.pz.push_back( towerPt * std::sinh( eta[i] ) );
+      arrays.e.push_back( towerE );
+      arrays.charge.push_back( 0 );
+    }
+
+    return true;
+  }
+
+  bool picoDecoder::NextEvent( Long64_t lastEntry ) {
+    if ( lastEntry < 0 || lastEntry > nEntries )
+      lastEntry = nEntries;
+    for ( Long64_t entry = currentEntry + 1; entry < lastEntry; ++entry )
+      if ( ReadEvent( entry ) )
+        return true;
+    currentEntry = lastEntry;
+    return false;
+  }
+
+  void ConvertPicoEvent( const picoEventArrays& event, std::vector<fastjet::PseudoJet> & particles, bool ClearVector, double towerScale ) {
+    stageTimer timer( stageConvert );
+    CountStage( stageConvert, event.Size() );
+
+    if ( ClearVector )
+      particles.clear();
+
+    for ( unsigned i = 0; i < event.Size(); ++i ) {
+      fastjet::PseudoJet tmpPJ( event.px[i], event.py[i], event.pz[i], event.e[i] );
+      if ( event.charge[i] == 0 )
+        tmpPJ *= towerScale;
+      tmpPJ.set_user_index( event.charge[i] );
+      particles.push_back( tmpPJ );
+    }
+  }
+
+}
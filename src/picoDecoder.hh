@@ -0,0 +1,131 @@
+// Reads TStarJetPico JetTrees into flat arrays, without
+// TStarJetPicoReader building track, tower and TStarJetVector
+// objects for every event. The track and tower branches are
+// read in MakeClass mode, the corrParameters.hh cuts are applied
+// as masks over the arrays, and the hadronic correction walks
+// the tower to track index. The event header is still read as
+// an object, so the trigger, vz and refmult selection is the
+// same TStarJetPicoEventCuts the reader uses.
+// Nick Elsey
+
+#include "corrParameters.hh"
+#include "corrFunctions.hh"
+
+#include "TArrayI.h"
+
+#ifndef PICODECODER_HH
+#define PICODECODER_HH
+
+namespace jetHadron {
+
+  // One decoded event as a structure of arrays: charged
+  // tracks first, then the hadronically corrected towers
+  struct picoEventArrays {
+    std::vector<float> px;
+    std::vector<float> py;
+    std::vector<float> pz;
+    std::vector<float> e;
+    std::vector<int>   charge;
+    unsigned nTracks;
+
+    unsigned Size() const { return px.size(); }
+    void Clear();
+  };
+
+  // One leaf of a split TClonesArray, read in MakeClass mode into a
+  // buffer of the leaf's own type, and converted to float or int
+  // for the whole array at once
+  class picoColumn {
+
+  public:
+
+    picoColumn();
+
+    // false if the leaf does not exist or has a type we cant read
+    bool Bind( TChain* chain, std::string leafName, unsigned capacity );
+    // grows the buffer, and points the branch at the new one
+    void Reserve( unsigned capacity );
+
+    Int_t Read( Long64_t localEntry ) { return branch->GetEntry( localEntry ); }
+    void ToFloat( std::vector<float>& out, unsigned n ) const;
+    void ToInt( std::vector<int>& out, unsigned n ) const;
+
+  private:
+
+    enum columnType { columnFloat, columnDouble, columnInt, columnUInt, columnShort, columnUShort, columnChar, columnUChar };
+
+    TChain* chain;
+    std::string name;
+    TBranch* branch;
+    columnType type;
+    unsigned typeSize;
+    std::vector<char> buffer;
+
+    template <typename T> void Convert( T* out, unsigned n ) const;
+  };
+
+  class picoDecoder {
+
+  public:
+
+    picoDecoder();
+    ~picoDecoder();
+
+    // Same arguments as InitReader: the chain is copied, so the
+    // decoder and a reader can run over the same chain side by side
+    bool Init( TChain* chain, std::string collisionType, std::string triggerString, double softwareTrigger );
+
+    // Decodes one chain entry: false if the event fails the cuts
+    bool ReadEvent( Long64_t entry );
+    // Reads entries until one passes the cuts, or lastEntry is reached
+    bool NextEvent( Long64_t lastEntry = -1 );
+
+    Long64_t GetNOfCurrentEvent() const               { return currentEntry; }
+    Long64_t GetEntries() const                       { return nEntries; }
+    TStarJetPicoEvent* GetEvent()                     { return event; }
+    TStarJetPicoEventHeader* GetHeader()              { return event->GetHeader(); }
+    const picoEventArrays& GetArrays() const          { return arrays; }
+
+  private:
+
+    bool LoadBadTowers( std::string towerList );
+
+    TChain* headerChain;        // object mode, header branches only
+    TChain* arrayChain;         // MakeClass mode, track and tower leaves
+    TStarJetPicoEvent* event;
+    TStarJetPicoEventCuts eventCuts;
+    double softwareTrigger;
+
+    Long64_t nEntries;
+    Long64_t currentEntry;
+
+    // array sizes, read first so the buffers can grow before the leaves
+    Int_t nTracksRead;
+    Int_t nTowersRead;
+    TBranch* trackCountBranch;
+    TBranch* towerCountBranch;
+    unsigned capacityTracks;
+    unsigned capacityTowers;
+
+    picoColumn trackPx, trackPy, trackPz, trackDCA, trackNFit, trackNPoss, trackCharge;
+    picoColumn towerId, towerEnergy, towerEta, towerPhi;
+    std::vector<TArrayI> towerMatched;
+    TBranch* towerMatchedBranch;
+
+    // per event work arrays
+    std::vector<float> px, py, pz, dca, nFit, nPoss, pt2;
+    std::vector<int>   charge, id;
+    std::vector<float> energy, eta, phi;
+    std::vector<char>  trackMask, towerMask;
+
+    std::vector<char>  badTower;  // indexed by tower id
+
+    picoEventArrays arrays;
+  };
+
+  // Same as ConvertTStarJetVector, for a decoded event
+  void ConvertPicoEvent( const picoEventArrays& event, std::vector<fastjet::PseudoJet> & particles, bool ClearVector = true, double towerScale = 1.0 );
+
+}
+
+#endif
@@ -0,0 +1,193 @@
+// Splits a chain into balanced entry ranges
+// for job submission, instead of one job per file.
+// Output is read by the grid submit scripts:
+// one job per line, "inputFile first:n"
+// Nick Elsey
+
+// All reader and histogram settings
+// Are located in corrParameters.hh
+#include "corrParameters.hh"
+
+// The majority of the jetfinding
+// And correlation code is located in
+// corrFunctions.hh
+#include "corrFunctions.hh"
+
+// ROOT Headers
+#include "TFile.h"
+#include "TTree.h"
+#include "TChain.h"
+#include "TChainElement.h"
+#include "TObjArray.h"
+
+// STL Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <map>
+
+#include "TStarJetPicoUtils.h"
+
+// -------------------------
+// Command line arguments:
+// [0]: input file: can be a single .root or a .txt or .list of root files
+// [1]: balance mode: events || cost
+//      events: each shard holds ~target entries
+//      cost: each shard holds ~target MB of compressed data, which
+//            tracks the event multiplicity and so the clustering time
+// [2]: target events ( or MB ) per shard
+// [3]: output plan file
+
+// DEF MAIN()
+int main ( int argc, const char** argv ) {
+
+  std::string inputFile   = "auau_list/grid_AuAuy7HT.list";
+  std::string balanceMode = "events";
+  double      target      = 50000;
+  std::string planFile    = "shards.txt";
+  std::string chainName   = "JetTree";
+
+  switch ( argc ) {
+    case 1: // Default case
+      __OUT( "Using Default Settings" )
+      break;
+    case 5: { // Custom case
+      __OUT( "Using Custom Settings" )
+      std::vector<std::string> arguments( argv+1, argv+argc );
+
+      inputFile   = arguments[0];
+      balanceMode = arguments[1];
+      target      = atof( arguments[2].c_str() );
+      planFile    = arguments[3];
+      break;
+    }
+    default: { // Error: invalid custom settings
+      __ERR( "Invalid number of command line arguments" )
+      return -1;
+      break;
+    }
+  }
+
+  if ( balanceMode != "events" && balanceMode != "cost" ) {
+    __ERR( "Unknown balance mode: Either events or cost" )
+    return -1;
+  }
+  if ( target <= 0 ) {
+    __ERR( "Target per shard must be positive" )
+    return -1;
+  }
+
+  // Build the chain the same way the drivers do, so the
+  // global entry numbers match
+  TChain* chain = new TChain( chainName.c_str() );
+  if ( jetHadron::HasEnding( inputFile, ".root" ) )      { chain->Add( inputFile.c_str() ); }
+  else if ( jetHadron::HasEnding( inputFile, ".txt" ) )  { chain = jetHadron::BuildChainFromList( inputFile, chainName ); }
+  else if ( jetHadron::HasEnding( inputFile, ".list" ) ) { chain = jetHadron::BuildChainFromList( inputFile, chainName ); }
+  else { __ERR("data file is not recognized type: .root, .list or .txt only.") return -1; }
+
+  // a manifest already has the entries and sizes of the files that
+  // have not changed since it was written
+  std::vector<jetHadron::manifestEntry> manifest;
+  std::map<std::string, jetHadron::manifestEntry> manifestFiles;
+  if ( !jetHadron::HasEnding( inputFile, ".root" ) && jetHadron::ReadManifest( jetHadron::ManifestPath( inputFile ), manifest ) )
+    for ( unsigned i = 0; i < manifest.size(); ++i )
+      manifestFiles[manifest[i].path] = manifest[i];
+
+  // Get the entries and compressed size of every file in the chain
+  std::vector<Long64_t> fileEntries;
+  std::vector<double>   fileCost;
+  TIter nextElement( chain->GetListOfFiles() );
+  TChainElement* element = 0;
+  while ( ( element = (TChainElement*) nextElement() ) ) {
+    if ( manifestFiles.count( element->GetTitle() ) && jetHadron::ManifestEntryCurrent( manifestFiles[element->GetTitle()] ) ) {
+      const jetHadron::manifestEntry& entry = manifestFiles[element->GetTitle()];
+      fileEntries.push_back( entry.entries );
+      // the file size stands in for the tree's compressed size
+      if ( balanceMode == "events" || entry.entries == 0 )
+        fileCost.push_back( 1.0 );
+      else
+        fileCost.push_back( entry.bytes / 1.0e6 / (double) entry.entries );
+      continue;
+    }
+    TFile* file = TFile::Open( element->GetTitle(), "READ" );
+    if ( !file || file->IsZombie() ) {
+      __ERR( "Could not open " << element->GetTitle() )
+      return -1;
+    }
+    TTree* tree = (TTree*) file->Get( chainName.c_str() );
+    Long64_t entries = ( tree ? tree->GetEntries() : 0 );
+    double zipMB = ( tree ? tree->GetZipBytes() / 1.0e6 : 0 );
+
+    fileEntries.push_back( entries );
+    // cost per entry - events: one per entry, cost: compressed MB per entry
+    if ( balanceMode == "events" || entries == 0 )
+      fileCost.push_back( 1.0 );
+    else
+      fileCost.push_back( zipMB / (double) entries );
+
+    file->Close();
+    delete file;
+  }
+
+  // Now walk the chain, closing a shard every time it reaches the target
+  std::vector<Long64_t> shardFirst, shardSize;
+  std::vector<double>   shardCost;
+  Long64_t globalEntry = 0;
+  Long64_t currentFirst = 0;
+  double currentCost = 0;
+  for ( unsigned i = 0; i < fileEntries.size(); ++i ) {
+    Long64_t remaining = fileEntries[i];
+    while ( remaining > 0 ) {
+      Long64_t take = (Long64_t) ceil( ( target - currentCost ) / fileCost[i] );
+      take = std::max( (Long64_t) 1, std::min( take, remaining ) );
+
+      currentCost += take * fileCost[i];
+      globalEntry += take;
+      remaining -= take;
+
+      if ( currentCost >= target ) {
+        shardFirst.push_back( currentFirst );
+        shardSize.push_back( globalEntry - currentFirst );
+        shardCost.push_back( currentCost );
+        currentFirst = globalEntry;
+        currentCost = 0;
+      }
+    }
+  }
+  // the last, partial shard
+  if ( globalEntry > currentFirst ) {
+    shardFirst.push_back( currentFirst );
+    shardSize.push_back( globalEntry - currentFirst );
+    shardCost.push_back( currentCost );
+  }
+
+  // write the plan
+  std::ofstream plan( planFile.c_str() );
+  if ( !plan.is_open() ) {
+    __ERR( "Could not open plan file " << planFile )
+    return -1;
+  }
+  plan << "# input: " << inputFile << " entries: " << globalEntry << " mode: " << balanceMode << " target: " << target << std::endl;
+  for ( unsigned i = 0; i < shardFirst.size(); ++i )
+    plan << inputFile << " " << shardFirst[i] << ":" << shardSize[i] << std::endl;
+  plan.close();
+
+  // summary
+  double maxCost = 0;
+  double minCost = ( shardCost.size() ? shardCost[0] : 0 );
+  for ( unsigned i = 0; i < shardCost.size(); ++i ) {
+    maxCost = std::max( maxCost, shardCost[i] );
+    minCost = std::min( minCost, shardCost[i] );
+  }
+  std::cout<<"  ----------------- SUMMARY ----------------- "<<std::endl;
+  std::cout<<"  "<< fileEntries.size() <<" files, "<< globalEntry <<" entries"<<std::endl;
+  std::cout<<"  Split into "<< shardFirst.size() <<" shards ( "<< balanceMode <<" per shard: min "<< minCost <<", max "<< maxCost <<" )"<<std::endl;
+  std::cout<<"  Plan written to "<< planFile <<std::endl;
+
+  return 0;
+}
@@ -117,6 +117,17 @@
 // [17]: name for the dijet TTree file
 // [18]: input data: can be a single .root or a .txt or .list of root files
 // [19]: MB AuAu event file for embedding, can be .root, .txt, .list
+// [20]: ( optional ) entry range of the pp chain to process: all, first:n
+//       or shard/nShards - used to split large inputs between jobs
+// optional: --index=file.root --cut="vzBin>=0 && maxTowerEt>6"
+//       reads only the pp entries of a build_index index passing the cut
+//       ( maxTowerEt is the raw tower Et the software trigger cuts on, so
+//       maxTowerEt>6 matches the default trigger - maxCorrTowerEt is after
+//       the hadronic correction )
+// optional: --strategy-profile=file picks the fastjet strategy per event
+//       multiplicity, the profile is calibrated if it does not exist
+// optional: --roi or --roi=distance only clusters the hard constituents around
+//       the triggers ( distance: trigger to jet, jetRadius by default )
 
 // DEF MAIN()
 int main ( int argc, const char** argv) {
@@ -166,13 +177,44 @@ int main ( int argc, const char** argv) {
   std::string	 	inputFile			= "pp_list/grid/pp1.list";			// input file: can be .root, .txt, .list
   std::string		mbInputFile		= "auau_list/grid_AuAuy7MB.list";				// min bias background event - .root, .txt, .list
   std::string 	chainName     = "JetTree";								// Tree name in input file
+  std::string   entryRange    = "all";                    // entries of the pp chain to process
+  
+  // optional: time the stages of the event loop
+  bool profileStages = jetHadron::PopFlag( argc, argv, "--profile" );
+  jetHadron::EnableStageProfiling( profileStages );
+  // optional: only report the projected memory of the job
+  bool dryRun = jetHadron::PopFlag( argc, argv, "--dry-run" );
+  // optional: output compression ( lz4 by default, the files are merged
+  // later ) and the number of threads serializing the histograms
+  std::string compressionSetting = "lz4:4";
+  jetHadron::PopOption( argc, argv, "--compression", compressionSetting );
+  std::string writeThreadsSetting = "1";
+  jetHadron::PopOption( argc, argv, "--write-threads", writeThreadsSetting );
+  int compression = jetHadron::ParseCompression( compressionSetting );
+  unsigned writeThreads = std::max( 1, atoi( writeThreadsSetting.c_str() ) );
+  // optional: an event index from build_index, and a cut on its
+  // variables - only the chain entries passing the cut are read
+  std::string indexFile, indexCut;
+  bool useIndex = jetHadron::PopOption( argc, argv, "--index", indexFile );
+  jetHadron::PopOption( argc, argv, "--cut", indexCut );
+  // optional: a clustering strategy profile ( see strategyTuner ),
+  // calibrated and written if it does not exist yet
+  std::string strategyProfile;
+  bool tuneStrategies = jetHadron::PopOption( argc, argv, "--strategy-profile", strategyProfile );
+  // optional: hard clustering in a region of interest around the triggers
+  std::string roiSetting;
+  bool useROI = jetHadron::PopFlag( argc, argv, "--roi" );
+  useROI = jetHadron::PopOption( argc, argv, "--roi", roiSetting ) || useROI;
+  if ( compression < 0 )
+    return -1;
   
   // Now check to see if we were given modifying arguments
   switch ( argc ) {
     case 1: // Default case
       __OUT( "Using Default Settings" )
       break;
-    case 21: { // Custom case
+    case 21:
+    case 22: { // Custom case
       __OUT( "Using Custom Settings" )
       std::vector<std::string> arguments( argv+1, argv+argc );
       
@@ -251,6 +293,10 @@ int main ( int argc, const char** argv) {
       inputFile 		= arguments[18];
       mbInputFile		= arguments[19];
       
+      // optional entry range
+      if ( argc == 22 )
+        entryRange  = arguments[20];
+      
       break;
     }
     default: { // Error: invalid custom settings
@@ -267,10 +313,18 @@ int main ( int argc, const char** argv) {
   if ( requireDijets ) { jetHadron::BeginSummaryDijet ( jetRadius, leadJetPtMin, subJetPtMin, jetPtMax, hardPtCut, jetHadron::trackMinPt, jetHadron::binsVz, jetHadron::vzRange, treeOutFile, corrOutFile ); }
   else { jetHadron::BeginSummaryJet ( jetRadius, leadJetPtMin, jetPtMax, hardPtCut, jetHadron::binsVz, jetHadron::vzRange, treeOutFile, corrOutFile ); }
   
+  // Project the memory needed for these settings - for a dry run, that is all
+  jetHadron::ReportProjectedMemory( analysisType, binsEta, binsPhi, jetRadius, requireDijets );
+  if ( dryRun )
+    return 0;
+  
   // We know what analysis we are doing now, so build our output histograms
   jetHadron::histograms* histograms = new jetHadron::histograms( analysisType, binsEta, binsPhi );
   histograms->Init();
   
+  // the analysis type as a mode, for the correlation loops
+  jetHadron::analysisMode mode = histograms->GetMode();
+  
   // Build our input now
   // First for PP
   // --------------------
@@ -284,8 +338,8 @@ int main ( int argc, const char** argv) {
   // If its a recognized file type, build the chain
   // If its not recognized, exit
   if ( inputIsRoot )		 	{ chain->Add( inputFile.c_str() ); }
-  else if ( inputIsTxt )  { chain = TStarJetPicoUtils::BuildChainFromFileList( inputFile.c_str() ); }
-  else if ( inputIsList)  { chain = TStarJetPicoUtils::BuildChainFromFileList( inputFile.c_str() ); }
+  else if ( inputIsTxt )  { chain = jetHadron::BuildChainFromList( inputFile, chainName ); }
+  else if ( inputIsList)  { chain = jetHadron::BuildChainFromList( inputFile, chainName ); }
   else 										{ __ERR("data file is not recognized type: .root or .txt only.") return -1; }
   
   // Intialize the reader and set the chain
@@ -295,6 +349,18 @@ int main ( int argc, const char** argv) {
   TStarJetPicoReader reader;
   jetHadron::InitReader( reader, chain, "pp", jetHadron::triggerAll, softwareTrig, jetHadron::allEvents );
   
+  // Find the part of the chain this job runs over
+  Long64_t currentEntry, lastEntry;
+  if ( !jetHadron::GetEntryRange( entryRange, chain->GetEntries(), currentEntry, lastEntry ) ) {
+    __ERR("Could not parse entry range: exit")
+    return -1;
+  }
+  std::cout<<"Processing chain entries "<< currentEntry <<" to "<< lastEntry <<std::endl;
+  std::vector<Long64_t> indexedEntries;
+  unsigned indexPosition = 0;
+  if ( useIndex && !jetHadron::SelectIndexedEntries( indexFile, indexCut, chain->GetEntries(), currentEntry, lastEntry, indexedEntries ) )
+    return -1;
+  
   // Data classes
   TStarJetVectorContainer<TStarJetVector>* container;
   TStarJetVector* sv; // TLorentzVector* would be sufficient
@@ -315,8 +381,8 @@ int main ( int argc, const char** argv) {
   // If its a recognized file type, build the chain
   // If its not recognized, exit
   if ( mbInputIsRoot )		 	{ mbChain->Add( mbInputFile.c_str() ); }
-  else if ( mbInputIsTxt )  { mbChain = TStarJetPicoUtils::BuildChainFromFileList( mbInputFile.c_str() ); }
-  else if ( mbInputIsList)  { mbChain = TStarJetPicoUtils::BuildChainFromFileList( mbInputFile.c_str() ); }
+  else if ( mbInputIsTxt )  { mbChain = jetHadron::BuildChainFromList( mbInputFile, chainName ); }
+  else if ( mbInputIsList)  { mbChain = jetHadron::BuildChainFromList( mbInputFile, chainName ); }
   else 										{ __ERR("data file is not recognized type: .root or .txt only.") return -1; }
   
   // Intialize the reader and set the chain
@@ -342,6 +408,23 @@ int main ( int argc, const char** argv) {
   // Trigger container - used to match
   // leading jet with trigger particle
   std::vector<fastjet::PseudoJet> triggers;
+  // and the same triggers in a rapidity-phi grid for the matching
+  jetHadron::triggerIndex triggerGrid( jetRadius, jetHadron::maxTrackRap );
+  
+  // the region of interest has to cover the trigger matching
+  // in BuildMatchedJets, so it needs the triggers
+  double roiRadius = 0;
+  if ( useROI ) {
+    if ( !requireTrigger ) {
+      __ERR( "--roi clusters around the triggers, it needs requireTrigger" )
+      return -1;
+    }
+    double matchDistance = ( roiSetting.size() ? atof( roiSetting.c_str() ) : jetRadius );
+    if ( matchDistance < jetRadius )
+      __WARN( "ROI match distance " << matchDistance << " is below the jet radius: matched jets can be lost" )
+    roiRadius = jetHadron::RegionOfInterestRadius( matchDistance, jetRadius );
+  }
+  int nROIFallback = 0;
   
   // clustering definitions
   // First: used for the analysis - anti-kt with radius jetRadius
@@ -365,37 +448,30 @@ int main ( int argc, const char** argv) {
   // Create the Area definition used for background estimation
   fastjet::GhostedAreaSpec	areaSpec = jetHadron::GhostedArea( jetHadron::maxTrackRap, jetRadius );
   fastjet::AreaDefinition 	areaDef  = jetHadron::AreaDefinition( areaSpec );
+  unsigned nGhosts = jetHadron::GhostCount( areaDef );
+  
+  // pick the clustering strategy by multiplicity, from the profile
+  if ( tuneStrategies ) {
+    std::vector<fastjet::JetDefinition> tunedDefinitions;
+    tunedDefinitions.push_back( analysisDefinition );
+    tunedDefinitions.push_back( backgroundDefinition );
+    if ( !jetHadron::InitStrategyTuning( strategyProfile, tunedDefinitions ) )
+      return -1;
+  }
   
   // selector used to reject hard jets in background estimation
   fastjet::Selector	selectorBkgEstimator	= jetHadron::SelectBkgEstimator( jetHadron::maxTrackRap, jetRadius );
   
   // When we do event mixing we need the jets, so save them
-  // in trees
-  // Tree to hold the di-jets
+  // in trees - flat branches, see jetTreeEntry
   TTree* correlatedDiJets;
-  // To hold the TLorentzVectors for leading, subleading
-  TLorentzVector leadingJet, subleadingJet;
-  // Records centrality and vertex information for event mixing
-  Int_t centralityBin, vertexZBin;
-  Double_t dijetAj = 1.0;
-  // Branchs to be written to file
-  TBranch* CDJBranchHi, * CDJBranchLo;
-  TBranch* CDJBranchCentralityBin;
-  TBranch* CDJBranchVertexZBin;
-  TBranch* CDJBranchAj;
-  
-  if ( requireDijets ) {
+  jetHadron::jetTreeEntry treeEntry;
+  if ( requireDijets )
     correlatedDiJets = new TTree("pp_dijets","Correlated PP Dijets" );
-    CDJBranchHi = correlatedDiJets->Branch("leadJet", &leadingJet );
-    CDJBranchLo = correlatedDiJets->Branch("subLeadJet", &subleadingJet );
-    CDJBranchVertexZBin = correlatedDiJets->Branch("vertexZBin", &vertexZBin );
-    CDJBranchAj = correlatedDiJets->Branch("aj", &dijetAj );
-  }
-  else {
+  else
     correlatedDiJets = new TTree("pp_jets","Correlated PP Jets" );
-    CDJBranchHi = correlatedDiJets->Branch("triggerJet", &leadingJet );
-    CDJBranchVertexZBin = correlatedDiJets->Branch("vertexZBin", &vertexZBin );
-  }
+  jetHadron::BranchJetTree( correlatedDiJets, treeEntry, requireDijets );
+  Double_t dijetAj = 1.0;
   
   // Finally, make ktEfficiency obj for pt-eta
   // Efficiency corrections
@@ -412,7 +488,7 @@ int main ( int argc, const char** argv) {
   auto begin = std::chrono::high_resolution_clock::now();
   
   try{
-    while ( reader.NextEvent() ) {
+    while ( useIndex ? jetHadron::NextIndexedEvent( reader, indexedEntries, indexPosition ) : jetHadron::NextEventInRange( reader, currentEntry, lastEntry ) ) {
       
       // Count the event
       nEvents++;
@@ -466,6 +542,7 @@ int main ( int argc, const char** argv) {
       // Get HT triggers ( using the pp version since the HT data cant be gotten)
       //jetHadron::GetTriggers( requireTrigger, triggerObjs, triggers );
       jetHadron::GetTriggersPP( requireTrigger, ppParticles, triggers );
+      triggerGrid.Fill( triggers );
       
       // and if its being used, convert all or only hard auau embedding
       // to be used into the pp event as well
@@ -488,9 +565,25 @@ int main ( int argc, const char** argv) {
       // NO background subtraction
       // -----------------------------
       // First cluster
-      fastjet::ClusterSequence clusterSequenceHigh ( highPtCons, analysisDefinition );
+      jetHadron::stageTimer hardTimer( jetHadron::stageHardCluster );
+      // with --roi, only the constituents around the triggers - unless
+      // what is left out could change the jets, then the whole event
+      std::vector<fastjet::PseudoJet> roiCons;
+      bool clusterROI = false;
+      if ( useROI ) {
+        double outsidePt = 0;
+        double edgePt = 0;
+        roiCons = jetHadron::SelectRegionOfInterest( analysisType, highPtCons, triggerGrid, roiRadius, jetRadius, outsidePt, edgePt );
+        clusterROI = jetHadron::RegionOfInterestExact( analysisType, outsidePt, edgePt, subJetPtMin );
+        if ( !clusterROI )
+          nROIFallback++;
+      }
+      const std::vector<fastjet::PseudoJet>& hardInput = ( clusterROI ? roiCons : highPtCons );
+      fastjet::ClusterSequence clusterSequenceHigh ( hardInput, jetHadron::TunedDefinition( analysisDefinition, hardInput.size() ) );
       // Now first apply global jet selector to inclusive jets, then sort by pt
       std::vector<fastjet::PseudoJet> HiResult = fastjet::sorted_by_pt( selectorJetCandidate ( clusterSequenceHigh.inclusive_jets() ) );
+      hardTimer.Stop();
+      jetHadron::CountStage( jetHadron::stageHardCluster, hardInput.size() );
 
       // Check to see if there are enough jets,
       // and if they meet the momentum cuts - if dijet, checks if they are back to back
@@ -507,28 +600,37 @@ int main ( int argc, const char** argv) {
       // ----------------------------------------------
       std::vector<fastjet::PseudoJet> LoResult;
       if ( requireDijets && correlateAll ) {
-        fastjet::ClusterSequenceArea ClusterSequenceLow ( lowPtCons, analysisDefinition, areaDef ); // WITH background subtraction
+        jetHadron::stageTimer softTimer( jetHadron::stageSoftCluster );
+        fastjet::ClusterSequenceArea ClusterSequenceLow ( lowPtCons, jetHadron::TunedDefinition( analysisDefinition, lowPtCons.size() + nGhosts ), areaDef ); // WITH background subtraction
+        std::vector<fastjet::PseudoJet> lowJets = ClusterSequenceLow.inclusive_jets();
+        softTimer.Stop();
+        jetHadron::CountStage( jetHadron::stageSoftCluster, lowPtCons.size() );
         
         // Background initialization
         // -------------------------
         
         // Energy density estimate from median ( pt_i / area_i )
-        fastjet::JetMedianBackgroundEstimator bkgdEstimator ( selectorBkgEstimator, backgroundDefinition, areaDef );
+        jetHadron::stageTimer bkgTimer( jetHadron::stageBackground );
+        fastjet::JetMedianBackgroundEstimator bkgdEstimator ( selectorBkgEstimator, jetHadron::TunedDefinition( backgroundDefinition, lowPtCons.size() + nGhosts ), areaDef );
         bkgdEstimator.set_particles( lowPtCons );
         // Subtract A*rho from the original pT
         fastjet::Subtractor bkgdSubtractor ( &bkgdEstimator );
-        LoResult = fastjet::sorted_by_pt( bkgdSubtractor( ClusterSequenceLow.inclusive_jets() ) );
+        LoResult = fastjet::sorted_by_pt( bkgdSubtractor( lowJets ) );
+        bkgTimer.Stop();
       }
       else {
         lowPtCons = selectorLowPtCons ( ppParticles );
-        fastjet::ClusterSequence ClusterSequenceLow ( lowPtCons, analysisDefinition );
+        jetHadron::stageTimer softTimer( jetHadron::stageSoftCluster );
+        fastjet::ClusterSequence ClusterSequenceLow ( lowPtCons, jetHadron::TunedDefinition( analysisDefinition, lowPtCons.size() ) );
         LoResult = fastjet::sorted_by_pt( ClusterSequenceLow.inclusive_jets()  );
+        softTimer.Stop();
+        jetHadron::CountStage( jetHadron::stageSoftCluster, lowPtCons.size() );
       }
       
       // Get the jets used for correlations
       // Returns hardJets if doing jet analysis
       // it will match to triggers if necessary - if so, trigger jet is at index 0
-      std::vector<fastjet::PseudoJet> analysisJets = jetHadron::BuildMatchedJets( analysisType, hardJets, LoResult, requireTrigger, triggers, jetRadius );
+      std::vector<fastjet::PseudoJet> analysisJets = jetHadron::BuildMatchedJets( analysisType, hardJets, LoResult, requireTrigger, triggerGrid, jetRadius );
 
       // if zero jets were returned, exit out
       if ( analysisJets.size() == 0 )		{ continue; }
@@ -537,19 +639,24 @@ int main ( int argc, const char** argv) {
       
       // now we have analysis jets, write the trees
       // for future event mixing
-      vertexZBin = VzBin;
       if ( requireDijets ) {
         // leading jet
-        leadingJet.SetPtEtaPhiE( analysisJets.at(0).pt(), analysisJets.at(0).eta(), analysisJets.at(0).phi_std(), analysisJets.at(0).E() );
-        subleadingJet.SetPtEtaPhiE( analysisJets.at(1).pt(), analysisJets.at(1).eta(), analysisJets.at(1).phi_std(), analysisJets.at(1).E() );
+        jetHadron::SetTreeJet( treeEntry.lead, analysisJets.at(0) );
+        jetHadron::SetTreeJet( treeEntry.sub, analysisJets.at(1) );
         dijetAj = jetHadron::CalcAj( hardJets );
         
       }
       else {
-        leadingJet.SetPtEtaPhiE( analysisJets.at(0).pt(), analysisJets.at(0).eta(), analysisJets.at(0).phi_std(), analysisJets.at(0).E() );
+        jetHadron::SetTreeJet( treeEntry.lead, analysisJets.at(0) );
         // default value for counting events
         dijetAj = 0.05;
       }
+      treeEntry.vz = vertexZ;
+      treeEntry.vertexZBin = VzBin;
+      treeEntry.centralityBin = refCent;
+      treeEntry.aj = dijetAj;
+      treeEntry.runId = header->GetRunId();
+      treeEntry.eventId = header->GetEventId();
       
       // now write
       correlatedDiJets->Fill();
@@ -581,15 +688,19 @@ int main ( int argc, const char** argv) {
         // if we're using particle - by - particle efficiencies, get it,
         // else, set to one
         double assocEfficiency = 1.0;
-        if ( useEfficiency ) assocEfficiency = efficiencyCorrection.EffPPY06( assocParticle.eta(), assocParticle.pt() );
+        if ( useEfficiency ) {
+          jetHadron::stageTimer effTimer( jetHadron::stageEfficiency );
+          jetHadron::CountStage( jetHadron::stageEfficiency );
+          assocEfficiency = efficiencyCorrection.EffPPY06( assocParticle.eta(), assocParticle.pt() );
+        }
         
         // now correlate it with jets
         if ( requireDijets ) {
-          jetHadron::correlateLeading( analysisType, VzBin, refCent, histograms, analysisJets.at(0), assocParticle, assocEfficiency, dijetAj );
-          jetHadron::correlateSubleading( analysisType, VzBin, refCent, histograms, analysisJets.at(1), assocParticle, assocEfficiency, dijetAj );
+          jetHadron::correlateLeading( mode, VzBin, refCent, histograms, analysisJets.at(0), assocParticle, assocEfficiency, dijetAj );
+          jetHadron::correlateSubleading( mode, VzBin, refCent, histograms, analysisJets.at(1), assocParticle, assocEfficiency, dijetAj );
         }
         else {
-          jetHadron::correlateTrigger( analysisType, VzBin, refCent, histograms, analysisJets.at(0), assocParticle, assocEfficiency );
+          jetHadron::correlateTrigger( mode, VzBin, refCent, histograms, analysisJets.at(0), assocParticle, assocEfficiency );
         }
       }
       
@@ -605,19 +716,27 @@ int main ( int argc, const char** argv) {
   else
     jetHadron::EndSummaryJet ( nEvents, nHardDijets, TimeKeeper.RealTime() );
   
+  if ( useROI )
+    __OUT( "ROI hard clustering: " << nROIFallback << " events needed the whole event clustered" )
+  
+  // memory used, for sizing the grid requests
+  jetHadron::ReportMemory( "histograms", histograms->MemoryBytes() );
+  jetHadron::ReportMemory( "jet tree", correlatedDiJets->GetTotBytes() );
+  jetHadron::ReportMemory( "peak RSS", jetHadron::PeakRSSBytes() );
+  
   // write out the dijet/jet trees
-  TFile*  treeOut   = new TFile( (outputDir + treeOutFile).c_str(), "RECREATE" );
+  TFile*  treeOut   = new TFile( (outputDir + treeOutFile).c_str(), "RECREATE", "", compression );
   treeOut->cd();
   correlatedDiJets->Write();
   treeOut->Close();
   
   // write out the histograms
-  TFile* histOut = new TFile( (outputDir + corrOutFile).c_str(), "RECREATE");
-  histOut->cd();
-  histograms->Write();
-  histOut->Close();
-  
-  
+  std::vector<TObject*> outputObjects;
+  histograms->GetObjects( outputObjects );
+  if ( profileStages )
+    outputObjects.push_back( jetHadron::StageProfileHistogram() );
+  if ( jetHadron::WriteObjects( outputDir + corrOutFile, outputObjects, compression, writeThreads ) < 0 )
+    return -1;
   
   return 0;
 }
@@ -33,6 +33,7 @@
 #include "TLorentzVector.h"
 #include "TClonesArray.h"
 #include "TChain.h"
+#include "TTree.h"
 #include "TBranch.h"
 #include "TMath.h"
 #include "TRandom.h"
@@ -56,6 +57,10 @@
 #include <string>
 #include <limits.h>
 #include <unistd.h>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 // Data is read in by TStarJetPico
 // Library, we convert to FastJet::PseudoJet
@@ -88,6 +93,17 @@
 #include "fastjet/tools/Filter.hh"
 #include "fastjet/FunctionOfPseudoJet.hh"
 
+// the grid does not have std::to_string() for some ungodly reason
+// replacing it here. Simply ostringstream
+namespace patch {
+  template < typename T > std::string to_string( const T& n )
+  {
+    std::ostringstream stm ;
+    stm << n ;
+    return stm.str() ;
+  }
+}
+
 // Used for year 7 tracking efficiency corrections,
 // if they are being used
 #include "ktTrackEff.hh"
@@ -121,7 +137,473 @@ int convertToPseudoJet( Pythia8::Pythia& p, double max_rap, std::vector<fastjet:
   return 1;
 }
 
+// One accepted pythia event: the visible final state particles
+// in our rapidity range, with the event weight and pTHat
+struct pythiaEvent {
+  std::vector<fastjet::PseudoJet> particles;
+  double weight;
+  double pTHat;
+};
+
+// A pythia instance generating hard events in its own thread. Events are
+// converted to pseudojets and handed over through a bounded queue. The
+// embedding loop takes events from the generators in turn, so the output
+// only depends on the base seed and the number of generators, not on
+// the thread timing. Each generator fills its own pTHat histogram, and
+// covers pTHatMin < pTHat < pTHatMax ( no upper limit if pTHatMax <= 0 )
+class pythiaGenerator {
+  
+public:
+  pythiaGenerator( std::string xmlDir, int seed, unsigned queueSize, bool banner, double pTHatMin = 14.0, double pTHatMax = -1.0 )
+  : fPythia( xmlDir, banner ), fSeed( seed ), fQueueSize( queueSize ), fStop( false ), fFailed( false ),
+    fPTHatMin( pTHatMin ), fPTHatMax( pTHatMax ), fSeconds( 0 ), fSigmaGen( 0 ), fNGenerated( 0 ) {
+    std::string histName = "ptHat_" + patch::to_string( seed );
+    fPtHat = new TH1D( histName.c_str(), "pTHat;pTHat;events", 100, 0, 100 );
+    fPtHat->SetDirectory( 0 );
+  }
+  
+  ~pythiaGenerator() {
+    Stop();
+    delete fPtHat;
+  }
+  
+  // initializes pythia and starts generating, in the generator's thread
+  void Start() {
+    fThread = std::thread( &pythiaGenerator::Run, this );
+  }
+  
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock( fMutex );
+      fStop = true;
+    }
+    fNotFull.notify_all();
+    if ( fThread.joinable() ) {
+      fThread.join();
+      if ( !fFailed ) {
+        fSigmaGen = fPythia.info.sigmaGen();
+        fNGenerated = fPythia.info.nAccepted();
+      }
+    }
+  }
+  
+  // Waits for the next event of this generator - false
+  // if the generator failed to initialize
+  bool Next( pythiaEvent& hardEvent ) {
+    std::unique_lock<std::mutex> lock( fMutex );
+    fNotEmpty.wait( lock, [this] { return !fQueue.empty() || fFailed; } );
+    if ( fQueue.empty() )
+      return false;
+    hardEvent.particles.swap( fQueue.front().particles );
+    hardEvent.weight = fQueue.front().weight;
+    hardEvent.pTHat = fQueue.front().pTHat;
+    fQueue.pop_front();
+    lock.unlock();
+    fNotFull.notify_one();
+    return true;
+  }
+  
+  TH1D* GetPtHat() { return fPtHat; }
+  
+  // Only valid after Stop(): the generated cross section ( mb ), the
+  // number of events it is based on, and the time spent in pythia
+  double GetSigmaGen()   { return fSigmaGen; }
+  double GetNGenerated() { return fNGenerated; }
+  double GetSeconds()    { return fSeconds; }
+  
+private:
+  void Run() {
+    fPythia.readString("Beams:eCM = 200");
+    fPythia.readString("HardQCD:all = on");
+    fPythia.readString("Random:setSeed = on");
+    fPythia.readString("Random:seed = " + patch::to_string( fSeed ));
+    fPythia.readString("PhaseSpace:pTHatMin = " + patch::to_string( fPTHatMin ));
+    if ( fPTHatMax > 0 )
+      fPythia.readString("PhaseSpace:pTHatMax = " + patch::to_string( fPTHatMax ));
+    if ( !fPythia.init() ) {
+      __ERR( "pythia failed to initialize, seed " << fSeed )
+      std::lock_guard<std::mutex> lock( fMutex );
+      fFailed = true;
+      fNotEmpty.notify_all();
+      return;
+    }
+    
+    while ( true ) {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      bool generated = fPythia.next();
+      double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+      if ( !generated ) {
+        fSeconds += seconds;
+        continue;
+      }
+      fPtHat->Fill( fPythia.info.pTHat() );
+      
+      pythiaEvent hardEvent;
+      hardEvent.weight = fPythia.info.weight();
+      hardEvent.pTHat = fPythia.info.pTHat();
+      convertToPseudoJet( fPythia, 1, hardEvent.particles );
+      
+      std::unique_lock<std::mutex> lock( fMutex );
+      fNotFull.wait( lock, [this] { return fQueue.size() < fQueueSize || fStop; } );
+      fSeconds += seconds;
+      if ( fStop )
+        return;
+      fQueue.push_back( std::move( hardEvent ) );
+      lock.unlock();
+      fNotEmpty.notify_one();
+    }
+  }
+  
+  Pythia8::Pythia fPythia;
+  int fSeed;
+  unsigned fQueueSize;
+  bool fStop;
+  bool fFailed;
+  double fPTHatMin, fPTHatMax;
+  double fSeconds;
+  double fSigmaGen, fNGenerated;
+  TH1D* fPtHat;
+  std::deque<pythiaEvent> fQueue;
+  std::mutex fMutex;
+  std::condition_variable fNotEmpty, fNotFull;
+  std::thread fThread;
+};
+
+// A library of pregenerated pythia events, so the generator settings
+// ( fixed above ) only have to be run once for many embedding runs.
+// Columnar: one entry per event, the particles as flat float arrays
+class pythiaLibrary {
+  
+public:
+  pythiaLibrary() : fFile( 0 ), fTree( 0 ), fEntry( 0 ), fNParticles( 0 ), fWeight( 0 ), fPTHat( 0 ) { }
+  ~pythiaLibrary() { Close(); }
+  
+  // Creates a new library to write to
+  bool Create( std::string fileName, int compression ) {
+    fFile = new TFile( fileName.c_str(), "RECREATE", "", compression );
+    if ( fFile->IsZombie() ) {
+      __ERR( "Could not create " << fileName )
+      return false;
+    }
+    Resize( initialParticles );
+    fTree = new TTree( "pythia", "Pythia 200 GeV HardQCD, pTHatMin 14, |y| < 1 visible final state" );
+    fTree->Branch( "nParticles", &fNParticles, "nParticles/I" );
+    fTree->Branch( "px", &fPx[0], "px[nParticles]/F" );
+    fTree->Branch( "py", &fPy[0], "py[nParticles]/F" );
+    fTree->Branch( "pz", &fPz[0], "pz[nParticles]/F" );
+    fTree->Branch( "E", &fE[0], "E[nParticles]/F" );
+    fTree->Branch( "charge", &fCharge[0], "charge[nParticles]/B" );
+    fTree->Branch( "weight", &fWeight, "weight/F" );
+    fTree->Branch( "pTHat", &fPTHat, "pTHat/F" );
+    return true;
+  }
+  
+  // Opens an existing library to replay
+  bool Open( std::string fileName ) {
+    fFile = TFile::Open( fileName.c_str(), "READ" );
+    if ( !fFile || fFile->IsZombie() ) {
+      __ERR( "Could not open " << fileName )
+      return false;
+    }
+    fTree = (TTree*) fFile->Get( "pythia" );
+    if ( !fTree || fTree->GetEntries() == 0 ) {
+      __ERR( "No pythia events in " << fileName )
+      return false;
+    }
+    Resize( std::max( 1, (int) fTree->GetMaximum( "nParticles" ) ) );
+    SetAddresses();
+    fEntry = 0;
+    return true;
+  }
+  
+  void Fill( pythiaEvent& hardEvent ) {
+    fNParticles = hardEvent.particles.size();
+    // every particle is kept: a bigger event grows the
+    // arrays, and the branches follow them
+    if ( fNParticles > (int) fPx.size() ) {
+      Resize( fNParticles );
+      SetAddresses();
+    }
+    for ( int i = 0; i < fNParticles; ++i ) {
+      fPx[i] = hardEvent.particles[i].px();
+      fPy[i] = hardEvent.particles[i].py();
+      fPz[i] = hardEvent.particles[i].pz();
+      fE[i] = hardEvent.particles[i].E();
+      fCharge[i] = hardEvent.particles[i].user_index();
+    }
+    fWeight = hardEvent.weight;
+    fPTHat = hardEvent.pTHat;
+    fTree->Fill();
+  }
+  
+  // Reads the next event - when the library runs
+  // out, it starts again from the beginning
+  bool Next( pythiaEvent& hardEvent ) {
+    if ( fEntry >= fTree->GetEntries() ) {
+      fEntry = 0;
+      std::cout<<"RESET pythia library"<<std::endl;
+    }
+    if ( fTree->GetEntry( fEntry++ ) <= 0 )
+      return false;
+    hardEvent.particles.clear();
+    for ( int i = 0; i < fNParticles; ++i ) {
+      fastjet::PseudoJet tmp( fPx[i], fPy[i], fPz[i], fE[i] );
+      tmp.set_user_index( fCharge[i] );
+      hardEvent.particles.push_back( tmp );
+    }
+    hardEvent.weight = fWeight;
+    hardEvent.pTHat = fPTHat;
+    return true;
+  }
+  
+  Long64_t GetEntries() { return ( fTree ? fTree->GetEntries() : 0 ); }
+  
+  void Close() {
+    if ( !fFile )
+      return;
+    if ( fFile->IsWritable() ) {
+      fFile->cd();
+      fTree->Write();
+    }
+    fFile->Close();
+    delete fFile;
+    fFile = 0;
+    fTree = 0;
+  }
+  
+private:
+  // more than most 200 GeV events have in |y| < 1
+  enum { initialParticles = 1000 };
+  
+  void SetAddresses() {
+    fTree->SetBranchAddress( "nParticles", &fNParticles );
+    fTree->SetBranchAddress( "px", &fPx[0] );
+    fTree->SetBranchAddress( "py", &fPy[0] );
+    fTree->SetBranchAddress( "pz", &fPz[0] );
+    fTree->SetBranchAddress( "E", &fE[0] );
+    fTree->SetBranchAddress( "charge", &fCharge[0] );
+    fTree->SetBranchAddress( "weight", &fWeight );
+    fTree->SetBranchAddress( "pTHat", &fPTHat );
+  }
+  
+  void Resize( int n ) {
+    fPx.resize( n );
+    fPy.resize( n );
+    fPz.resize( n );
+    fE.resize( n );
+    fCharge.resize( n );
+  }
+  
+  TFile* fFile;
+  TTree* fTree;
+  Long64_t fEntry;
+  Int_t fNParticles;
+  std::vector<Float_t> fPx, fPy, fPz, fE;
+  std::vector<Char_t> fCharge;
+  Float_t fWeight;
+  Float_t fPTHat;
+};
+
+// Schedules generation over pTHat bins. A pilot of each bin measures the
+// fraction of its events that pass the jet cuts and the time per event,
+// then each bin gets the events it needs for the target relative precision
+// on its number of accepted events ( 1 / sqrt( nAccepted ) ), within the
+// total budget. Bins are interleaved, so they sample the AuAu events evenly
+class pTHatScheduler {
+  
+public:
+  // edges: pTHat bin edges, the last bin is open ( no upper limit ).
+  // With a single bin, all nEvents go to it and there is no pilot
+  pTHatScheduler( std::vector<double> edges, unsigned nEvents, double precision )
+  : fEdges( edges ), fBudget( nEvents ), fPrecision( precision ), fPilot( edges.size() > 1 ), fNext( 0 ) {
+    unsigned nBins = NBins();
+    fGenerated.assign( nBins, 0 );
+    fAccepted.assign( nBins, 0 );
+    fSeconds.assign( nBins, 0 );
+    fQuota.assign( nBins, 0 );
+    if ( !fPilot )
+      fQuota[0] = nEvents;
+    else {
+      // ten percent of the budget for the pilot, and at least 100 per
+      // bin - but never more than the budget, split evenly
+      unsigned pilotEvents = std::min( std::max( 100u, (unsigned) ( 0.1 * nEvents / nBins ) ), nEvents / nBins );
+      for ( unsigned i = 0; i < nBins; ++i )
+        fQuota[i] = pilotEvents;
+    }
+  }
+  
+  unsigned NBins() { return fEdges.size(); }
+  double Low( unsigned bin )  { return fEdges[bin]; }
+  double High( unsigned bin ) { return ( bin + 1 < fEdges.size() ? fEdges[bin+1] : -1.0 ); }
+  
+  // The bin the next event comes from, or -1 when we are done
+  int NextBin() {
+    for ( unsigned tried = 0; tried < NBins(); ++tried ) {
+      unsigned bin = fNext;
+      fNext = ( fNext + 1 ) % NBins();
+      if ( fQuota[bin] > 0 ) {
+        fQuota[bin]--;
+        fGenerated[bin]++;
+        return bin;
+      }
+    }
+    if ( !fPilot )
+      return -1;
+    fPilot = false;
+    Allocate();
+    return NextBin();
+  }
+  
+  void Accept( int bin )                    { fAccepted[bin]++; }
+  void AddSeconds( int bin, double seconds ) { fSeconds[bin] += seconds; }
+  unsigned GetGenerated( int bin )          { return fGenerated[bin]; }
+  unsigned GetAccepted( int bin )           { return fAccepted[bin]; }
+  double GetSeconds( int bin )              { return fSeconds[bin]; }
+  
+private:
+  void Allocate() {
+    unsigned nBins = NBins();
+    unsigned used = 0;
+    for ( unsigned i = 0; i < nBins; ++i )
+      used += fGenerated[i];
+    double remaining = ( fBudget > used ? fBudget - used : 0 );
+    
+    // events each bin still needs: nAccepted = 1 / precision^2
+    std::vector<double> needed( nBins, 0 );
+    double totalNeeded = 0;
+    for ( unsigned i = 0; i < nBins; ++i ) {
+      double acceptance = std::max( (double) fAccepted[i], 1.0 ) / std::max( (double) fGenerated[i], 1.0 );
+      double target = 1.0 / ( fPrecision * fPrecision ) / acceptance;
+      needed[i] = std::max( 0.0, target - fGenerated[i] );
+      totalNeeded += needed[i];
+    }
+    
+    // if the budget is short, every bin gets the same fraction of its need
+    double scale = ( totalNeeded > remaining ? remaining / totalNeeded : 1.0 );
+    std::cout<<"  -------------- PTHAT SCHEDULE -------------- "<<std::endl;
+    for ( unsigned i = 0; i < nBins; ++i ) {
+      fQuota[i] = (unsigned) ( needed[i] * scale );
+      std::cout<<"  pTHat "<< Low(i) <<" - "<< High(i) <<": pilot accepted "<< fAccepted[i] <<" / "<< fGenerated[i] <<", scheduling "<< fQuota[i] <<" more"<<std::endl;
+    }
+    if ( remaining == 0 )
+      std::cout<<"  the pilot used the whole budget of "<< fBudget <<" events"<<std::endl;
+    else if ( scale < 1.0 )
+      std::cout<<"  budget only covers "<< scale * 100.0 <<"% of the events needed for "<< fPrecision * 100.0 <<"% precision"<<std::endl;
+  }
+  
+  std::vector<double> fEdges;
+  unsigned fBudget;
+  double fPrecision;
+  bool fPilot;
+  unsigned fNext;
+  std::vector<unsigned> fGenerated, fAccepted, fQuota;
+  std::vector<double> fSeconds;
+};
+
+// One AuAu event of the background index: the leading hard jet
+// candidate pt ( 0 if there is none ), vz bin and reference centrality
+struct backgroundEvent {
+  Int_t   event;
+  Float_t leadPt;
+  Int_t   vzBin;
+  Int_t   refCent;
+};
+
+// One pass over the AuAu events, clustering the hard constituents of
+// each once, so the embedding loop only draws pre-approved events
+void BuildBackgroundIndex( TStarJetPicoReader& reader, fastjet::JetDefinition& jetDef, fastjet::Selector& selectorHighPtCons, fastjet::Selector& selectorJetCandidate, std::vector<backgroundEvent>& index ) {
+  index.clear();
+  std::vector<fastjet::PseudoJet> tmpParticles;
+  while ( reader.NextEvent() ) {
+    reader.PrintStatus(10);
+    TStarJetPicoEventHeader* header = reader.GetEvent()->GetHeader();
+    
+    backgroundEvent entry;
+    entry.event = reader.GetNOfCurrentEvent();
+    if ( header->GetCorrectedGReferenceMultiplicity() )
+      entry.refCent = header->GetGReferenceCentrality();
+    else
+      entry.refCent = jetHadron::GetReferenceCentrality( header->GetGReferenceMultiplicity() );
+    entry.vzBin = jetHadron::GetVzBin( header->GetPrimaryVertexZ() );
+    
+    jetHadron::ConvertTStarJetVector( reader.GetOutputContainer(), tmpParticles, true, 0 );
+    std::vector<fastjet::PseudoJet> highPtCons = selectorHighPtCons( tmpParticles );
+    fastjet::ClusterSequence clusterSequenceHigh ( highPtCons, jetDef );
+    std::vector<fastjet::PseudoJet> HiResult = fastjet::sorted_by_pt( selectorJetCandidate ( clusterSequenceHigh.inclusive_jets() ) );
+    entry.leadPt = ( HiResult.size() ? HiResult[0].pt() : 0 );
+    
+    index.push_back( entry );
+  }
+}
+
+// The index is cached in a file; its title records the input and the
+// jet settings, so an index built with other settings is not reused
+bool ReadBackgroundIndex( std::string fileName, std::string settings, std::vector<backgroundEvent>& index ) {
+  TFile indexFile( fileName.c_str(), "READ" );
+  if ( indexFile.IsZombie() )
+    return false;
+  TTree* tree = (TTree*) indexFile.Get( "bkgIndex" );
+  if ( !tree || settings != tree->GetTitle() ) {
+    __OUT( "background index settings differ - rebuilding" )
+    return false;
+  }
+  backgroundEvent entry;
+  tree->SetBranchAddress( "event", &entry.event );
+  tree->SetBranchAddress( "leadPt", &entry.leadPt );
+  tree->SetBranchAddress( "vzBin", &entry.vzBin );
+  tree->SetBranchAddress( "refCent", &entry.refCent );
+  index.clear();
+  for ( Long64_t i = 0; i < tree->GetEntries(); ++i ) {
+    tree->GetEntry( i );
+    index.push_back( entry );
+  }
+  return true;
+}
+
+bool WriteBackgroundIndex( std::string fileName, std::string settings, std::vector<backgroundEvent>& index ) {
+  TFile indexFile( fileName.c_str(), "RECREATE" );
+  if ( indexFile.IsZombie() ) {
+    __ERR( "Could not create " << fileName )
+    return false;
+  }
+  backgroundEvent entry;
+  TTree* tree = new TTree( "bkgIndex", settings.c_str() );
+  tree->Branch( "event", &entry.event, "event/I" );
+  tree->Branch( "leadPt", &entry.leadPt, "leadPt/F" );
+  tree->Branch( "vzBin", &entry.vzBin, "vzBin/I" );
+  tree->Branch( "refCent", &entry.refCent, "refCent/I" );
+  for ( unsigned i = 0; i < index.size(); ++i ) {
+    entry = index[i];
+    tree->Fill();
+  }
+  tree->Write();
+  indexFile.Close();
+  return true;
+}
 
+// -------------------------
+// Command line arguments:
+// [0]: number of events
+// [1]: output directory
+// [2]: correlation output file
+// [3]: tree output file ( not used )
+// [4]: AuAu input file: can be .root, .txt, .list
+// [5]: ( optional ) number of pythia generator threads
+// [6]: ( optional ) base seed: generator i is seeded with base + i
+// optional: --write-library=file.root: only generate nEvents pythia
+//           events into a library, no embedding ( AuAu input is not read )
+//           --read-library=file.root: replay the events of a library
+//           instead of running pythia
+//           --pthat-bins=14,20,30,45: generate in pTHat bins ( the last
+//           is open ), scheduled to reach --precision=0.05 relative
+//           precision on the accepted events of each bin, weighted by
+//           the bin cross section / events generated in the bin. The
+//           pilot takes 10% of nEvents ( at least 100, at most nEvents
+//           per bin ), so the total never exceeds nEvents
+//           --bkg-index=file.root: cache of the AuAu background index
+//           ( built on the first run, reused while the input and jet
+//           settings are unchanged - the input by name, entry count and,
+//           for a list with a current manifest, its file checksums )
 
 int main( int argc, const char** argv ) {
   
@@ -159,13 +641,50 @@ int main( int argc, const char** argv ) {
   std::string		treeOutFile		= "jet.root";								// jets will be saved in a TTree here
   std::string	 	inputFile			= "/nfs/rhi/STAR/Data/AuAuMB_0_20/picoMB_0_20.root";		// input file: can be .root, .txt, .list
   std::string 	chainName     = "JetTree";								// Tree name in input file
+  unsigned      nGenerators   = 1;                        // pythia instances, each in its own thread
+  int           baseSeed      = 1;                        // generator i uses seed baseSeed + i
+  
+  // optional: write a pythia event library, or replay one
+  std::string libraryFile;
+  bool writeLibrary = jetHadron::PopOption( argc, argv, "--write-library", libraryFile );
+  bool readLibrary = jetHadron::PopOption( argc, argv, "--read-library", libraryFile );
+  if ( writeLibrary && readLibrary ) {
+    __ERR( "Can either write or read a pythia library, not both" )
+    return -1;
+  }
+  // optional: pTHat binned generation
+  std::string pTHatBinString = "14";
+  bool binnedPTHat = jetHadron::PopOption( argc, argv, "--pthat-bins", pTHatBinString );
+  std::string precisionString = "0.05";
+  jetHadron::PopOption( argc, argv, "--precision", precisionString );
+  std::vector<double> pTHatEdges;
+  std::stringstream pTHatStream( pTHatBinString );
+  std::string pTHatEdge;
+  while ( std::getline( pTHatStream, pTHatEdge, ',' ) )
+    pTHatEdges.push_back( atof( pTHatEdge.c_str() ) );
+  if ( pTHatEdges.size() == 0 || !std::is_sorted( pTHatEdges.begin(), pTHatEdges.end() ) ) {
+    __ERR( "pTHat bin edges must be given in increasing order" )
+    return -1;
+  }
+  if ( binnedPTHat && ( writeLibrary || readLibrary ) ) {
+    __ERR( "pTHat binned generation does not use pythia libraries" )
+    return -1;
+  }
+  std::string backgroundIndexFile;
+  bool cacheBackgroundIndex = jetHadron::PopOption( argc, argv, "--bkg-index", backgroundIndexFile );
+  double precision = atof( precisionString.c_str() );
+  if ( precision <= 0 ) {
+    __ERR( "precision must be positive" )
+    return -1;
+  }
   
   // Now check to see if we were given modifying arguments
   switch ( argc ) {
     case 1: // Default case
       __OUT( "Using Default Settings" )
       break;
-    case 6: { // Custom case
+    case 6:
+    case 8: { // Custom case
       __OUT( "Using Custom Settings" )
       std::vector<std::string> arguments( argv+1, argv+argc );
       // Set non-default values
@@ -178,6 +697,12 @@ int main( int argc, const char** argv ) {
       treeOutFile		= arguments[3];
       inputFile 		= arguments[4];
       
+      // generator threads and seeds
+      if ( argc == 8 ) {
+        nGenerators = std::max( 1, atoi ( arguments[5].c_str() ) );
+        baseSeed    = atoi ( arguments[6].c_str() );
+      }
+      
       break;
     }
     default: { // Error: invalid custom settings
@@ -187,6 +712,61 @@ int main( int argc, const char** argv ) {
     }
   }
 
+  // every bin needs at least one pilot event
+  if ( pTHatEdges.size() > 1 && nEvents < pTHatEdges.size() ) {
+    __ERR( nEvents << " events can not cover " << pTHatEdges.size() << " pTHat bins" )
+    return -1;
+  }
+  
+  // make the pythia generators, unless we replay a library - pythia
+  // seeds must be in [ 1, 900000000 ] to be reproducible ( 0 uses the time )
+  pTHatScheduler scheduler( pTHatEdges, nEvents, precision );
+  std::vector<std::vector<pythiaGenerator*> > generators( scheduler.NBins() );
+  pythiaLibrary library;
+  if ( readLibrary ) {
+    if ( !library.Open( libraryFile ) )
+      return -1;
+    std::string libraryOut = "replaying " + patch::to_string( library.GetEntries() ) + " pythia events from " + libraryFile;
+    __OUT( libraryOut.c_str() )
+  }
+  else {
+    if ( baseSeed < 1 || baseSeed + (int) ( nGenerators * scheduler.NBins() ) > 900000000 ) {
+      __ERR( "base seed must be between 1 and 900000000 - number of generators" )
+      return -1;
+    }
+    // each pTHat bin has its own generators
+    for ( unsigned bin = 0; bin < scheduler.NBins(); ++bin )
+      for ( unsigned i = 0; i < nGenerators; ++i ) {
+        int seed = baseSeed + bin * nGenerators + i;
+        generators[bin].push_back( new pythiaGenerator( "/wsu/home/dx/dx54/dx5412/software/pythia8219/share/Pythia8/xmldoc", seed, 64, seed == baseSeed, scheduler.Low( bin ), scheduler.High( bin ) ) );
+        generators[bin][i]->Start();
+      }
+  }
+  pythiaEvent hardEvent;
+  TH1D* hPtHat = new TH1D( "ptHat", "pTHat;pTHat;events", 100, 0, 100 );
+  
+  // generate-once mode: fill the library with nEvents events and stop
+  if ( writeLibrary ) {
+    if ( !library.Create( libraryFile, jetHadron::ParseCompression( "zstd:5" ) ) )
+      return -1;
+    for ( unsigned i = 0; i < nEvents; ++i ) {
+      if ( !generators[0][i % nGenerators]->Next( hardEvent ) ) {
+        __ERR( "pythia generator failed" )
+        return -1;
+      }
+      library.Fill( hardEvent );
+    }
+    for ( unsigned i = 0; i < generators[0].size(); ++i ) {
+      generators[0][i]->Stop();
+      hPtHat->Add( generators[0][i]->GetPtHat() );
+      delete generators[0][i];
+    }
+    library.Close();
+    std::string libraryOut = "wrote " + patch::to_string( nEvents ) + " pythia events to " + libraryFile;
+    __OUT( libraryOut.c_str() )
+    return 0;
+  }
+  
   // build our two histograms
   TH3D* hCorrLead = new TH3D( "correlationsLead", "correlationsLead", binsEta, -2, 2, binsPhi, jetHadron::phiLowEdge, jetHadron::phiHighEdge, jetHadron::binsPt, jetHadron::ptLowEdge, jetHadron::ptHighEdge  );
   TH3D* hCorrSub = new TH3D( "correlationsSub", "correlationsSub", binsEta, -2, 2, binsPhi, jetHadron::phiLowEdge, jetHadron::phiHighEdge, jetHadron::binsPt, jetHadron::ptLowEdge, jetHadron::ptHighEdge  );
@@ -197,6 +777,22 @@ int main( int argc, const char** argv ) {
   TH1D* resultSub = new TH1D("ptcountSub", "ptcountSub", jetHadron::binsPt, jetHadron::ptLowEdge, jetHadron::ptHighEdge);
   TH1D* resultAll = new TH1D("ptcountAll", "ptcount", jetHadron::binsPt, jetHadron::ptLowEdge, jetHadron::ptHighEdge);
   
+  // with pTHat bins, each bin is filled separately and added
+  // with its cross section weight at the end
+  const unsigned nOutputHistograms = 8;
+  TH1* outputHistograms[nOutputHistograms] = { hCorrLead, hCorrSub, hCounter, hLead, hSub, result, resultSub, resultAll };
+  std::vector<std::vector<TH1*> > binHistograms( scheduler.NBins() );
+  for ( unsigned bin = 0; bin < scheduler.NBins(); ++bin )
+    for ( unsigned k = 0; k < nOutputHistograms; ++k ) {
+      if ( !binnedPTHat ) {
+        binHistograms[bin].push_back( outputHistograms[k] );
+        continue;
+      }
+      std::string binName = std::string( outputHistograms[k]->GetName() ) + "_pthat_" + patch::to_string( bin );
+      binHistograms[bin].push_back( (TH1*) outputHistograms[k]->Clone( binName.c_str() ) );
+      binHistograms[bin][k]->Reset();
+    }
+  
   // Build our input now
   TChain* chain = new TChain( chainName.c_str() );
   // Check to see if the input is a .root file or a .txt
@@ -207,8 +803,8 @@ int main( int argc, const char** argv ) {
   // If its a recognized file type, build the chain
   // If its not recognized, exit
   if ( inputIsRoot )		 	{ chain->Add( inputFile.c_str() ); }
-  else if ( inputIsTxt )  { chain = TStarJetPicoUtils::BuildChainFromFileList( inputFile.c_str() ); }
-  else if ( inputIsList )  { chain = TStarJetPicoUtils::BuildChainFromFileList( inputFile.c_str() ); }
+  else if ( inputIsTxt )  { chain = jetHadron::BuildChainFromList( inputFile, chainName ); }
+  else if ( inputIsList )  { chain = jetHadron::BuildChainFromList( inputFile, chainName ); }
   else 										{ __ERR("data file is not recognized type: .root, .list or .txt only.") return -1; }
   
   // Intialize the reader and set the chain
@@ -262,19 +858,38 @@ int main( int argc, const char** argv ) {
   // Efficiency corrections
   ktTrackEff efficiencyCorrection( jetHadron::y7EfficiencyFile );
   
-  // finally, make a pythia generator
-  Pythia8::Pythia pythia( "/wsu/home/dx/dx54/dx5412/software/pythia8219/share/Pythia8/xmldoc" );
-  
-  // settings for LHC pp at 13 TeV
-  pythia.readString("Beams:eCM = 200");
-  pythia.readString("HardQCD:all = on");
-  pythia.readString("Random:setSeed = on");
-  pythia.readString("Random:seed = 0");
-  pythia.readString("PhaseSpace:pTHatMin = 14.0");
-  
-  // initialize the pythia generator
-  pythia.init();
-  
+  // Index the AuAu events once: only events in the accepted centrality
+  // and vz range, without a hard jet candidate above 0.8 * leadJetPtMin,
+  // are drawn as background
+  std::vector<backgroundEvent> backgroundIndex;
+  // keyed on the input's contents too: a list keeps its name when its
+  // files change, so the entry count ( as build_index ) and, when the
+  // list has a current manifest, the digest of its file checksums
+  std::string inputDigest = ( inputIsRoot ? "" : jetHadron::ManifestDigest( inputFile ) );
+  std::string indexSettings = inputFile + " entries " + patch::to_string( chain->GetEntries() ) + ( inputDigest.size() ? " md5 " + inputDigest : "" ) + " hardPt " + patch::to_string( hardPtCut ) + " R " + patch::to_string( jetRadius ) + " jetPt " + patch::to_string( subJetPtMin ) + "-" + patch::to_string( jetPtMax );
+  if ( !cacheBackgroundIndex || !ReadBackgroundIndex( backgroundIndexFile, indexSettings, backgroundIndex ) ) {
+    __OUT( "Building the background event index" )
+    BuildBackgroundIndex( reader, analysisDefinition, selectorHighPtCons, selectorJetCandidate, backgroundIndex );
+    if ( cacheBackgroundIndex && !WriteBackgroundIndex( backgroundIndexFile, indexSettings, backgroundIndex ) )
+      return -1;
+  }
+  std::vector<int> approvedEvents;
+  for ( unsigned i = 0; i < backgroundIndex.size(); ++i ) {
+    const backgroundEvent& entry = backgroundIndex[i];
+    if ( entry.refCent < 0 )                                     { continue; }
+    if ( entry.refCent < jetHadron::y7EfficiencyRefCentLower )   { continue; }
+    if ( entry.refCent > jetHadron::y7EfficiencyRefCentUpper )   { continue; }
+    if ( entry.vzBin == -1 )                                     { continue; }
+    if ( entry.leadPt >= leadJetPtMin*0.8 )                      { continue; }
+    approvedEvents.push_back( entry.event );
+  }
+  std::string indexOut = patch::to_string( approvedEvents.size() ) + " of " + patch::to_string( backgroundIndex.size() ) + " AuAu events approved as background";
+  __OUT( indexOut.c_str() )
+  if ( approvedEvents.size() == 0 ) {
+    __ERR( "no usable background events" )
+    return -1;
+  }
+  unsigned nextBackground = 0;
   
   // Now everything is set up
   // We can start the event loop
@@ -284,21 +899,53 @@ int main( int argc, const char** argv ) {
   int nMatchedHard = 0;
 
   // Now we can do a loop over pythia events
-  while ( eventCount < nEvents ) {
-    eventCount++;
+  int bin = -1;
+  int lastBin = -1;
+  std::chrono::steady_clock::time_point lastTime = std::chrono::steady_clock::now();
+  while ( ( bin = scheduler.NextBin() ) >= 0 ) {
+    // time spent on the previous event, for the schedule
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if ( lastBin >= 0 )
+      scheduler.AddSeconds( lastBin, std::chrono::duration<double>( now - lastTime ).count() );
+    lastBin = bin;
+    lastTime = now;
     
-    pythia.next();
+    // this pTHat bin's histograms
+    TH3D* hCorrLeadBin = (TH3D*) binHistograms[bin][0];
+    TH3D* hCorrSubBin = (TH3D*) binHistograms[bin][1];
+    TH1* hCounterBin = binHistograms[bin][2];
+    TH1* hLeadBin = binHistograms[bin][3];
+    TH1* hSubBin = binHistograms[bin][4];
+    TH1* resultBin = binHistograms[bin][5];
+    TH1* resultSubBin = binHistograms[bin][6];
+    TH1* resultAllBin = binHistograms[bin][7];
     
-    // read in the next AuAu event
-    // Print out reader status every 10 seconds
-    reader.PrintStatus(10);
+    // take the generators' events in turn, or the library's
+    if ( readLibrary ) {
+      if ( !library.Next( hardEvent ) ) {
+        __ERR( "could not read the pythia library" )
+        return -1;
+      }
+      hPtHat->Fill( hardEvent.pTHat );
+    }
+    else {
+      // waiting on the generators is counted in their own time
+      std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+      if ( !generators[bin][( scheduler.GetGenerated( bin ) - 1 ) % nGenerators]->Next( hardEvent ) ) {
+        __ERR( "pythia generator failed" )
+        return -1;
+      }
+      scheduler.AddSeconds( bin, -std::chrono::duration<double>( std::chrono::steady_clock::now() - waitStart ).count() );
+    }
+    eventCount++;
     
-    // loop the HT events
-    // If the reader runs out, start again
-    if ( !reader.NextEvent() ) {
-      reader.ReadEvent(0);
+    // read in the next approved AuAu event
+    // If we run out, start again
+    if ( nextBackground == approvedEvents.size() ) {
+      nextBackground = 0;
       std::cout<<"RESET AuAu events"<<std::endl;
     }
+    reader.ReadEvent( approvedEvents[nextBackground++] );
     
     // Get the event header and event
     event = reader.GetEvent();
@@ -337,32 +984,10 @@ int main( int argc, const char** argv ) {
     if ( VzBin == -1 )																				{ continue; }
     
     
-    // we will make sure there is no high energy jet in the event
-    bool goodBkgEvent = false;
-    while ( goodBkgEvent != true ) {
-      std::vector<fastjet::PseudoJet> tmpParticles;
-      jetHadron::ConvertTStarJetVector( container, tmpParticles, true, 0 );
-      
-      std::vector<fastjet::PseudoJet> highPtCons = selectorHighPtCons( tmpParticles );
-      
-      // First cluster
-      fastjet::ClusterSequence clusterSequenceHigh ( highPtCons, analysisDefinition );
-      // Now first apply global jet selector to inclusive jets, then sort by pt
-      std::vector<fastjet::PseudoJet> HiResult = fastjet::sorted_by_pt( selectorJetCandidate ( clusterSequenceHigh.inclusive_jets() ) );
-      
-      if ( !HiResult.size() || HiResult[0].pt() < leadJetPtMin*0.8 ) {
-        goodBkgEvent = true;
-      }
-      else {
-        reader.NextEvent();
-      }
-    }
-
-    
     // Convert TStarJetVector to PseudoJet
     jetHadron::ConvertTStarJetVector( container, particles, true, 0 );
     jetHadron::ConvertTStarJetVector( container, auauParticles, true, 0 );
-    convertToPseudoJet( pythia, 1, particles );
+    particles.insert( particles.end(), hardEvent.particles.begin(), hardEvent.particles.end() );
     
     // now get the particles we will use
     // get our two sets of particles:
@@ -388,9 +1013,10 @@ int main( int argc, const char** argv ) {
     std::vector<fastjet::PseudoJet> hardJets = jetHadron::BuildHardJets( analysisType, HiResult );
     
     // ok, we're using it, so count it
-    hCounter->Fill(0);
-    hLead->Fill( hardJets[0].pt() );
-    hSub->Fill( hardJets[1].pt() );
+    scheduler.Accept( bin );
+    hCounterBin->Fill(0);
+    hLeadBin->Fill( hardJets[0].pt() );
+    hSubBin->Fill( hardJets[1].pt() );
     
     // now loop over all tracks in auau event
     for ( int j = 0; j < auauParticles.size(); ++j ) {
@@ -417,18 +1043,66 @@ int main( int argc, const char** argv ) {
       
       // aaaaaand plot if its about 2 GeV
       if ( assocPt > 2.0 ) {
-        hCorrLead->Fill( deltaEta, deltaPhi, assocPt, weight );
-        hCorrSub->Fill( deltaEtaSub, deltaPhiSub, assocPt, weight );
+        hCorrLeadBin->Fill( deltaEta, deltaPhi, assocPt, weight );
+        hCorrSubBin->Fill( deltaEtaSub, deltaPhiSub, assocPt, weight );
       }
       if ( hardJets[0].delta_R( assocTrack ) < 0.5 )
-        result->Fill( assocPt, weight );
+        resultBin->Fill( assocPt, weight );
       if ( hardJets[1].delta_R( assocTrack ) < 0.5 )
-        resultSub->Fill( assocPt, weight );
-      resultAll->Fill( assocPt, weight );
+        resultSubBin->Fill( assocPt, weight );
+      resultAllBin->Fill( assocPt, weight );
     }
     
   }
   
+  if ( lastBin >= 0 )
+    scheduler.AddSeconds( lastBin, std::chrono::duration<double>( std::chrono::steady_clock::now() - lastTime ).count() );
+  
+  // stop the generators, and merge their pTHat histograms
+  // the bin cross section is the generators' average
+  std::vector<double> binSigma( scheduler.NBins(), 0 );
+  std::vector<double> binGeneratorSeconds( scheduler.NBins(), 0 );
+  for ( unsigned bin = 0; bin < generators.size(); ++bin ) {
+    double nGenerated = 0;
+    for ( unsigned i = 0; i < generators[bin].size(); ++i ) {
+      generators[bin][i]->Stop();
+      hPtHat->Add( generators[bin][i]->GetPtHat() );
+      binSigma[bin] += generators[bin][i]->GetSigmaGen() * generators[bin][i]->GetNGenerated();
+      nGenerated += generators[bin][i]->GetNGenerated();
+      binGeneratorSeconds[bin] += generators[bin][i]->GetSeconds();
+      delete generators[bin][i];
+    }
+    if ( nGenerated > 0 )
+      binSigma[bin] /= nGenerated;
+  }
+  
+  // weight each bin by sigma / events used, and report the luminosity
+  // ( events / sigma ) per CPU second. The binned sample is only as
+  // good as its worst bin
+  TH1D* hPTHatSigma = 0;
+  if ( binnedPTHat ) {
+    hPTHatSigma = new TH1D( "pthat_sigma", "generated cross section;pTHat bin;#sigma [mb]", scheduler.NBins(), -0.5, scheduler.NBins() - 0.5 );
+    double minLuminosity = -1;
+    double totalSeconds = 0;
+    std::cout<<"  -------------- PTHAT BINS -------------- "<<std::endl;
+    for ( unsigned bin = 0; bin < scheduler.NBins(); ++bin ) {
+      double nUsed = scheduler.GetGenerated( bin );
+      double seconds = scheduler.GetSeconds( bin ) + binGeneratorSeconds[bin];
+      double luminosity = ( binSigma[bin] > 0 ? nUsed / binSigma[bin] : 0 );
+      double binWeight = ( nUsed > 0 ? binSigma[bin] / nUsed : 0 );
+      for ( unsigned k = 0; k < nOutputHistograms; ++k )
+        outputHistograms[k]->Add( binHistograms[bin][k], binWeight );
+      hPTHatSigma->SetBinContent( bin + 1, binSigma[bin] );
+      
+      totalSeconds += seconds;
+      if ( minLuminosity < 0 || luminosity < minLuminosity )
+        minLuminosity = luminosity;
+      std::cout<<"  pTHat "<< scheduler.Low( bin ) <<" - "<< scheduler.High( bin ) <<": sigma "<< binSigma[bin] <<" mb, "<< nUsed <<" events ( "<< scheduler.GetAccepted( bin ) <<" accepted ), ";
+      std::cout<<"luminosity "<< luminosity <<" / mb, "<< ( seconds > 0 ? luminosity / seconds : 0 ) <<" / mb per CPU second"<<std::endl;
+    }
+    std::cout<<"  effective luminosity "<< minLuminosity <<" / mb in "<< totalSeconds <<" CPU seconds: "<< ( totalSeconds > 0 ? minLuminosity / totalSeconds : 0 ) <<" / mb per CPU second"<<std::endl;
+  }
+  
   // write out the dijet/jet trees
   std::cout<<"making the stuff! in "<< (outputDir + corrOutFile).c_str() <<std::endl;
   TFile*  Out   = new TFile( (outputDir + corrOutFile).c_str(), "RECREATE" );
@@ -441,6 +1115,9 @@ int main( int argc, const char** argv ) {
   result->Write();
   resultSub->Write();
   resultAll->Write();
+  hPtHat->Write();
+  if ( hPTHatSigma )
+    hPTHatSigma->Write();
   Out->Close();
   
   return 0;
@@ -0,0 +1,224 @@
+// Checks the arithmetic binning ( UniformBinUpperClosed,
+// UniformBinLowerClosed, GetVzBin, FindAjBin and
+// GetReferenceCentrality ) against the linear scans they
+// replaced: at every edge, one ulp and a few epsilons around
+// each edge, out of range, at +/-inf and NaN, and on random
+// values. Any difference is listed, and the job returns -1
+// Nick Elsey
+
+// All reader and histogram settings
+// Are located in corrParameters.hh
+#include "corrParameters.hh"
+
+// The majority of the jetfinding
+// And correlation code is located in
+// corrFunctions.hh
+#include "corrFunctions.hh"
+
+// Histogram class that handles
+// all the histograms
+#include "histograms.hh"
+
+// STL Headers
+#include <iostream>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+#include <string>
+#include <climits>
+
+namespace {
+
+  // ------------------------------------------
+  // the linear scans, as they were
+  // ------------------------------------------
+
+  int ScanUpperClosed( double value, double lowEdge, double width, int nBins ) {
+    for ( int i = nBins-1; i > 0; --i )
+      if ( value > lowEdge + width*i )
+        return i;
+    return 0;
+  }
+
+  int ScanLowerClosed( double value, double lowEdge, double width, int nBins ) {
+    for ( int i = 0; i < nBins-1; ++i )
+      if ( value < lowEdge + width*(i+1) )
+        return i;
+    return nBins-1;
+  }
+
+  int ScanVzBin( double Vz ) {
+    if ( Vz > jetHadron::vzHighEdge || Vz <= jetHadron::vzLowEdge )
+      return -1;
+    for ( int i = jetHadron::binsVz-1; i >= 0; --i )
+      if ( Vz > ( jetHadron::vzLowEdge + jetHadron::dVz*i ) )
+        return i;
+    return -1;
+  }
+
+  int ScanAjBin( double aj ) {
+    double ajBinWidth = ( jetHadron::ajHighEdge - jetHadron::ajLowEdge ) / jetHadron::binsAj;
+    for ( int i = 0; i < jetHadron::binsAj; ++i )
+      if ( aj < ajBinWidth*( i + 1 ) )
+        return i;
+    return -1;
+  }
+
+  int ScanReferenceCentrality( int gRefMult ) {
+    for ( int i = 8; i >= 0; --i )
+      if ( gRefMult >= jetHadron::y7RefMultCent[i] )
+        return i;
+    return -1;
+  }
+
+  // ------------------------------------------
+  // test values
+  // ------------------------------------------
+
+  // every edge, one ulp to each side, and a few epsilons
+  // to each side, for the edges of nBins bins and one bin
+  // further out on both ends - then the out of range values
+  std::vector<double> EdgeValues( double lowEdge, double width, int nBins ) {
+    const double epsilons[] = { 1e-12, 1e-9, 1e-6, 1e-3 };
+    std::vector<double> values;
+    for ( int i = -1; i <= nBins+1; ++i ) {
+      double edge = lowEdge + width*i;
+      values.push_back( edge );
+      values.push_back( std::nextafter( edge, std::numeric_limits<double>::infinity() ) );
+      values.push_back( std::nextafter( edge, -std::numeric_limits<double>::infinity() ) );
+      for ( unsigned j = 0; j < sizeof( epsilons ) / sizeof( epsilons[0] ); ++j ) {
+        values.push_back( edge + epsilons[j] );
+        values.push_back( edge - epsilons[j] );
+      }
+    }
+    values.push_back( lowEdge - 1e6*width );
+    values.push_back( lowEdge + 1e6*width );
+    values.push_back( std::numeric_limits<double>::max() );
+    values.push_back( -std::numeric_limits<double>::max() );
+    values.push_back( std::numeric_limits<double>::infinity() );
+    values.push_back( -std::numeric_limits<double>::infinity() );
+    values.push_back( std::numeric_limits<double>::quiet_NaN() );
+    return values;
+  }
+
+  // plus uniform random values over the bins and one bin beyond
+  std::vector<double> TestValues( double lowEdge, double width, int nBins, unsigned nRandom, std::mt19937_64& generator ) {
+    std::vector<double> values = EdgeValues( lowEdge, width, nBins );
+    std::uniform_real_distribution<double> uniform( lowEdge - width, lowEdge + width*(nBins+1) );
+    for ( unsigned i = 0; i < nRandom; ++i )
+      values.push_back( uniform( generator ) );
+    return values;
+  }
+
+  // counts and lists the differences of one function
+  class comparison {
+  public:
+    comparison( std::string functionName ) : name( functionName ), nChecked( 0 ), nFailed( 0 ) { }
+
+    template <typename T>
+    void Check( T value, int expected, int found ) {
+      nChecked++;
+      if ( expected == found )
+        return;
+      nFailed++;
+      __ERR( name << "( " << value << " ): the scan gives " << expected << ", found " << found )
+    }
+
+    bool Report() const {
+      std::cout<<"  "<< name <<": "<< nChecked <<" values, "<< nFailed <<" differences"<<std::endl;
+      return nFailed == 0;
+    }
+
+  private:
+    std::string name;
+    unsigned long nChecked;
+    unsigned long nFailed;
+  };
+
+}
+
+// DEF MAIN()
+int main ( int argc, const char** argv) {
+
+  // the number of random values per binning
+  unsigned nRandom = 1000000;
+
+  switch ( argc ) {
+    case 1:
+      break;
+    case 2:
+      nRandom = atoi( argv[1] );
+      break;
+    default:
+      __ERR( "Invalid number of command line arguments" )
+      return -1;
+      break;
+  }
+
+  std::mt19937_64 generator( 12345 );
+  std::cout.precision( 17 );
+
+  // the helpers, on the analysis binnings and a few that
+  // do not divide evenly in floating point
+  struct binning { double lowEdge, width; int nBins; };
+  const binning binnings[] = {
+    { jetHadron::vzLowEdge, jetHadron::dVz, jetHadron::binsVz },
+    { jetHadron::ajLowEdge, ( jetHadron::ajHighEdge - jetHadron::ajLowEdge ) / jetHadron::binsAj, jetHadron::binsAj },
+    { -1.3, 0.1, 26 },
+    { 0.3, 0.7, 7 },
+    { -5.0, 1.0/3.0, 30 },
+    { 1e-3, 1e-5, 1000 },
+    { 2.0, 0.5, 1 }
+  };
+
+  comparison upperClosed( "UniformBinUpperClosed" );
+  comparison lowerClosed( "UniformBinLowerClosed" );
+  for ( unsigned i = 0; i < sizeof( binnings ) / sizeof( binnings[0] ); ++i ) {
+    const binning& b = binnings[i];
+    std::vector<double> values = TestValues( b.lowEdge, b.width, b.nBins, nRandom, generator );
+    for ( unsigned j = 0; j < values.size(); ++j ) {
+      upperClosed.Check( values[j], ScanUpperClosed( values[j], b.lowEdge, b.width, b.nBins ), jetHadron::UniformBinUpperClosed( values[j], b.lowEdge, b.width, b.nBins ) );
+      lowerClosed.Check( values[j], ScanLowerClosed( values[j], b.lowEdge, b.width, b.nBins ), jetHadron::UniformBinLowerClosed( values[j], b.lowEdge, b.width, b.nBins ) );
+    }
+  }
+
+  comparison vzBin( "GetVzBin" );
+  std::vector<double> vzValues = TestValues( jetHadron::vzLowEdge, jetHadron::dVz, jetHadron::binsVz, nRandom, generator );
+  for ( unsigned i = 0; i < vzValues.size(); ++i )
+    vzBin.Check( vzValues[i], ScanVzBin( vzValues[i] ), jetHadron::GetVzBin( vzValues[i] ) );
+
+  comparison ajBin( "FindAjBin" );
+  double ajBinWidth = ( jetHadron::ajHighEdge - jetHadron::ajLowEdge ) / jetHadron::binsAj;
+  std::vector<double> ajValues = TestValues( jetHadron::ajLowEdge, ajBinWidth, jetHadron::binsAj, nRandom, generator );
+  for ( unsigned i = 0; i < ajValues.size(); ++i )
+    ajBin.Check( ajValues[i], ScanAjBin( ajValues[i] ), jetHadron::histograms::FindAjBin( ajValues[i] ) );
+
+  // every gRefMult up to past the last edge, each edge
+  // and its neighbours, and the ends of the int range.
+  // Values below the first edge are logged as errors by
+  // GetReferenceCentrality
+  comparison refCent( "GetReferenceCentrality" );
+  std::vector<int> refMultValues;
+  for ( int i = -10; i <= 2*jetHadron::y7RefMultCent[8]; ++i )
+    refMultValues.push_back( i );
+  for ( int i = 0; i < 9; ++i ) {
+    refMultValues.push_back( jetHadron::y7RefMultCent[i] - 1 );
+    refMultValues.push_back( jetHadron::y7RefMultCent[i] );
+    refMultValues.push_back( jetHadron::y7RefMultCent[i] + 1 );
+  }
+  refMultValues.push_back( INT_MIN );
+  refMultValues.push_back( INT_MAX );
+  for ( unsigned i = 0; i < refMultValues.size(); ++i )
+    refCent.Check( refMultValues[i], ScanReferenceCentrality( refMultValues[i] ), jetHadron::GetReferenceCentrality( refMultValues[i] ) );
+
+  std::cout<<"  ----------------- BINNING ----------------- "<<std::endl;
+  bool passed = upperClosed.Report();
+  passed = lowerClosed.Report() && passed;
+  passed = vzBin.Report() && passed;
+  passed = ajBin.Report() && passed;
+  passed = refCent.Report() && passed;
+  std::cout<<"  "<< ( passed ? "PASSED" : "FAILED" ) <<std::endl;
+
+  return ( passed ? 0 : -1 );
+}
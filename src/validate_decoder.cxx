@@ -0,0 +1,188 @@
+// Compares the picoDecoder with TStarJetPicoReader, event by event:
+// both have to accept the same chain entries, and give the same
+// particles above trackMinPt. Also reports the time each spends
+// reading and decoding, so the two can be compared on real files.
+// Nick Elsey
+
+// All reader and histogram settings
+// Are located in corrParameters.hh
+#include "corrParameters.hh"
+
+// The majority of the jetfinding
+// And correlation code is located in
+// corrFunctions.hh
+#include "corrFunctions.hh"
+
+// Flat array reader
+#include "picoDecoder.hh"
+
+// ROOT Headers
+#include "TChain.h"
+
+// STL Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include "TStarJetPicoUtils.h"
+
+// -------------------------
+// Command line arguments:
+// [0]: input file: can be a single .root or a .txt or .list of root files
+// [1]: collision type: auau || pp
+// [2]: number of reader events to compare ( -1 for the full chain )
+// [3]: relative tolerance on the particle pt, eta and phi
+
+namespace {
+
+  // the particles the analysis would use, in a fixed order
+  void AnalysisParticles( std::vector<fastjet::PseudoJet>& particles ) {
+    std::vector<fastjet::PseudoJet> selected;
+    for ( unsigned i = 0; i < particles.size(); ++i )
+      if ( particles[i].pt() > jetHadron::trackMinPt && fabs( particles[i].eta() ) < jetHadron::maxTrackRap )
+        selected.push_back( particles[i] );
+    std::sort( selected.begin(), selected.end(), []( const fastjet::PseudoJet& a, const fastjet::PseudoJet& b ) {
+      if ( a.user_index() != b.user_index() )
+        return a.user_index() < b.user_index();
+      return a.pt() > b.pt();
+    } );
+    particles.swap( selected );
+  }
+
+  // returns the number of particles that differ, and the largest difference
+  unsigned CompareParticles( const std::vector<fastjet::PseudoJet>& reader, const std::vector<fastjet::PseudoJet>& decoder, double tolerance, double& maxDifference ) {
+    maxDifference = 0;
+    if ( reader.size() != decoder.size() )
+      return std::max( reader.size(), decoder.size() );
+    unsigned nDiffer = 0;
+    for ( unsigned i = 0; i < reader.size(); ++i ) {
+      double difference = std::max( fabs( reader[i].pt() - decoder[i].pt() ) / reader[i].pt(), std::max( fabs( reader[i].eta() - decoder[i].eta() ), fabs( reader[i].delta_phi_to( decoder[i] ) ) ) );
+      maxDifference = std::max( maxDifference, difference );
+      if ( difference > tolerance || reader[i].user_index() != decoder[i].user_index() )
+        nDiffer++;
+    }
+    return nDiffer;
+  }
+
+  double Elapsed( std::chrono::steady_clock::time_point start ) {
+    return std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+  }
+
+}
+
+// DEF MAIN()
+int main ( int argc, const char** argv ) {
+
+  std::string inputFile     = "/nfs/rhi/STAR/Data/CleanAuAuY7/Clean809.root";
+  std::string collisionType = "auau";
+  int         nEvents       = 1000;
+  double      tolerance     = 1e-4;
+  std::string chainName     = "JetTree";
+
+  switch ( argc ) {
+    case 1: // Default case
+      __OUT( "Using Default Settings" )
+      break;
+    case 5: { // Custom case
+      __OUT( "Using Custom Settings" )
+      std::vector<std::string> arguments( argv+1, argv+argc );
+
+      inputFile     = arguments[0];
+      collisionType = arguments[1];
+      nEvents       = atoi( arguments[2].c_str() );
+      tolerance     = atof( arguments[3].c_str() );
+      break;
+    }
+    default: { // Error: invalid custom settings
+      __ERR( "Invalid number of command line arguments" )
+      return -1;
+      break;
+    }
+  }
+
+  // Build the chain the same way the drivers do
+  TChain* chain = new TChain( chainName.c_str() );
+  if ( jetHadron::HasEnding( inputFile, ".root" ) )      { chain->Add( inputFile.c_str() ); }
+  else if ( jetHadron::HasEnding( inputFile, ".txt" ) )  { chain = jetHadron::BuildChainFromList( inputFile, chainName ); }
+  else if ( jetHadron::HasEnding( inputFile, ".list" ) ) { chain = jetHadron::BuildChainFromList( inputFile, chainName ); }
+  else { __ERR("data file is not recognized type: .root, .list or .txt only.") return -1; }
+
+  // the same settings the drivers use
+  TStarJetPicoReader reader;
+  jetHadron::InitReader( reader, chain, collisionType, jetHadron::triggerAll, 0, jetHadron::allEvents );
+
+  jetHadron::picoDecoder decoder;
+  if ( !decoder.Init( chain, collisionType, jetHadron::triggerAll, 0 ) )
+    return -1;
+
+  std::vector<fastjet::PseudoJet> readerParticles;
+  std::vector<fastjet::PseudoJet> decoderParticles;
+
+  Long64_t nCompared = 0;
+  Long64_t nEntryMismatch = 0;
+  Long64_t nParticleMismatch = 0;
+  double maxDifference = 0;
+  double readerSeconds = 0;
+  double decoderSeconds = 0;
+  Long64_t lastEntry = -1;
+
+  while ( nEvents < 0 || nCompared < nEvents ) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool readerOK = reader.NextEvent();
+    readerSeconds += Elapsed( start );
+    if ( !readerOK )
+      break;
+    Long64_t entry = reader.GetNOfCurrentEvent();
+
+    // every entry the reader skipped has to be rejected by the decoder
+    for ( Long64_t skipped = lastEntry + 1; skipped < entry; ++skipped ) {
+      start = std::chrono::steady_clock::now();
+      bool decoderOK = decoder.ReadEvent( skipped );
+      decoderSeconds += Elapsed( start );
+      if ( decoderOK ) {
+        if ( nEntryMismatch < 10 )
+          __OUT( "entry " << skipped << ": rejected by the reader, accepted by the decoder" )
+        nEntryMismatch++;
+      }
+    }
+    lastEntry = entry;
+
+    start = std::chrono::steady_clock::now();
+    bool decoderOK = decoder.ReadEvent( entry );
+    decoderSeconds += Elapsed( start );
+    nCompared++;
+    if ( !decoderOK ) {
+      if ( nEntryMismatch < 10 )
+        __OUT( "entry " << entry << ": accepted by the reader, rejected by the decoder" )
+      nEntryMismatch++;
+      continue;
+    }
+
+    jetHadron::ConvertTStarJetVector( reader.GetOutputContainer(), readerParticles );
+    jetHadron::ConvertPicoEvent( decoder.GetArrays(), decoderParticles );
+    AnalysisParticles( readerParticles );
+    AnalysisParticles( decoderParticles );
+
+    double eventDifference = 0;
+    unsigned nDiffer = CompareParticles( readerParticles, decoderParticles, tolerance, eventDifference );
+    maxDifference = std::max( maxDifference, eventDifference );
+    if ( nDiffer ) {
+      if ( nParticleMismatch < 10 )
+        __OUT( "entry " << entry << ": " << nDiffer << " particles differ ( reader " << readerParticles.size() << ", decoder " << decoderParticles.size() << " )" )
+      nParticleMismatch++;
+    }
+  }
+
+  std::cout<<"  ----------------- SUMMARY ----------------- "<<std::endl;
+  std::cout<<"  "<< nCompared <<" reader events compared"<<std::endl;
+  std::cout<<"  accept/reject mismatches: "<< nEntryMismatch <<std::endl;
+  std::cout<<"  events with different particles: "<< nParticleMismatch <<" ( largest difference "<< maxDifference <<" )"<<std::endl;
+  std::cout<<"  reader: "<< readerSeconds <<" s, decoder: "<< decoderSeconds <<" s"<<std::endl;
+
+  return ( nEntryMismatch || nParticleMismatch ? -1 : 0 );
+}